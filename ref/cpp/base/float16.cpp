@@ -0,0 +1,100 @@
+#include "yang/base/float16.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YANG_X86_DISPATCH 1
+#endif
+
+namespace yang {
+
+#ifdef YANG_X86_DISPATCH
+namespace {
+
+// F16C is not part of the baseline target, so these are compiled for it separately and only
+// called when the CPU has it
+
+__attribute__((target("avx,f16c"))) SizeType WidenF16C(const float16 *src, float *dest,
+                                                        SizeType n) {
+  SizeType i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c"))) SizeType NarrowF16C(const float *src, float16 *dest,
+                                                         SizeType n) {
+  SizeType i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), h);
+  }
+  return i;
+}
+
+bool HasF16C() {
+  static const bool has_f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has_f16c;
+}
+
+}  // namespace
+#endif
+
+void WidenToFloat(const float16 *src, float *dest, SizeType n) {
+  SizeType i = 0;
+#ifdef YANG_X86_DISPATCH
+  if (HasF16C()) i = WidenF16C(src, dest, n);
+#endif
+  for (; i < n; ++i) dest[i] = src[i];
+}
+
+void WidenToFloat(const bfloat16 *src, float *dest, SizeType n) {
+  SizeType i = 0;
+#ifdef __SSE2__
+  auto zero = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    auto h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    // interleaving with zeros moves each value into the upper half of a 32-bit lane
+    _mm_storeu_ps(dest + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, h)));
+    _mm_storeu_ps(dest + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, h)));
+  }
+#endif
+  for (; i < n; ++i) dest[i] = src[i];
+}
+
+void WidenToFloat(const int16_t *src, float *dest, SizeType n, float scale) {
+  constexpr int16_t null = std::numeric_limits<int16_t>::min();
+  // branch free so that it can be auto-vectorized
+  for (SizeType i = 0; i < n; ++i) {
+    float v = src[i] * scale;
+    dest[i] = src[i] == null ? NAN : v;
+  }
+}
+
+void NarrowFromFloat(const float *src, float16 *dest, SizeType n) {
+  SizeType i = 0;
+#ifdef YANG_X86_DISPATCH
+  if (HasF16C()) i = NarrowF16C(src, dest, n);
+#endif
+  for (; i < n; ++i) dest[i] = src[i];
+}
+
+void NarrowFromFloat(const float *src, bfloat16 *dest, SizeType n) {
+  for (SizeType i = 0; i < n; ++i) dest[i] = src[i];
+}
+
+void NarrowFromFloat(const float *src, int16_t *dest, SizeType n, float scale) {
+  constexpr int16_t null = std::numeric_limits<int16_t>::min();
+  constexpr float lo = std::numeric_limits<int16_t>::min() + 1;
+  constexpr float hi = std::numeric_limits<int16_t>::max();
+  for (SizeType i = 0; i < n; ++i) {
+    float v = src[i] / scale;
+    dest[i] = std::isnan(v) ? null : static_cast<int16_t>(std::nearbyint(std::clamp(v, lo, hi)));
+  }
+}
+
+}  // namespace yang
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "yang/base/size.h"
+
+namespace yang {
+
+// Reduced precision floating point types. They are storage types only, arithmetic is done after
+// widening to float.
+
+// IEEE 754 half precision
+struct float16 {
+  uint16_t bits;
+
+  float16() = default;
+  float16(float v) : bits(FromFloat(v)) {}
+
+  operator float() const {
+    return ToFloat(bits);
+  }
+
+  static constexpr float16 FromBits(uint16_t b) {
+    float16 v;
+    v.bits = b;
+    return v;
+  }
+
+  static uint16_t FromFloat(float v) {
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs_x = x & 0x7fffffff;
+    if (abs_x >= 0x7f800000) return sign | (abs_x > 0x7f800000 ? 0x7e00 : 0x7c00);
+    if (abs_x >= 0x477ff000) return sign | 0x7c00;  // overflow
+    if (abs_x < 0x38800000) {
+      // subnormal
+      if (abs_x < 0x33000000) return sign;
+      uint32_t exp = abs_x >> 23;
+      uint32_t mant = (abs_x & 0x7fffff) | 0x800000;
+      uint32_t shift = 126 - exp;
+      uint32_t h = mant >> shift;
+      uint32_t rem = mant & ((1u << shift) - 1);
+      uint32_t half = 1u << (shift - 1);
+      if (rem > half || (rem == half && (h & 1))) h++;
+      return sign | h;
+    }
+    // rebias exponent and round to nearest even
+    uint32_t h = (abs_x - 0x38000000) >> 13;
+    uint32_t rem = abs_x & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | h;
+  }
+
+  static float ToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0x1f) {
+      x = sign | 0x7f800000 | (mant << 13);
+    } else if (exp == 0) {
+      if (mant == 0) {
+        x = sign;
+      } else {
+        // subnormal
+        exp = 113;
+        while (!(mant & 0x400)) {
+          mant <<= 1;
+          exp--;
+        }
+        x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+      }
+    } else {
+      x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float v;
+    std::memcpy(&v, &x, sizeof(v));
+    return v;
+  }
+};
+
+// Brain floating point, i.e. the upper half of a float
+struct bfloat16 {
+  uint16_t bits;
+
+  bfloat16() = default;
+  bfloat16(float v) : bits(FromFloat(v)) {}
+
+  operator float() const {
+    return ToFloat(bits);
+  }
+
+  static constexpr bfloat16 FromBits(uint16_t b) {
+    bfloat16 v;
+    v.bits = b;
+    return v;
+  }
+
+  static uint16_t FromFloat(float v) {
+    uint32_t x;
+    std::memcpy(&x, &v, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) return (x >> 16) | 0x40;  // keep NaN quiet
+    return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+  }
+
+  static float ToFloat(uint16_t h) {
+    uint32_t x = static_cast<uint32_t>(h) << 16;
+    float v;
+    std::memcpy(&v, &x, sizeof(v));
+    return v;
+  }
+};
+
+static_assert(sizeof(float16) == 2 && std::is_trivially_copyable_v<float16>);
+static_assert(sizeof(bfloat16) == 2 && std::is_trivially_copyable_v<bfloat16>);
+
+template <class T>
+constexpr bool is_reduced_float_v = std::is_same_v<T, float16> || std::is_same_v<T, bfloat16>;
+
+inline bool IsValid(float16 v) {
+  return (v.bits & 0x7c00) != 0x7c00;
+}
+
+inline bool IsValid(bfloat16 v) {
+  return (v.bits & 0x7f80) != 0x7f80;
+}
+
+// Bulk conversions, vectorized with F16C or SSE2 when the CPU supports them
+
+void WidenToFloat(const float16 *src, float *dest, SizeType n);
+
+void WidenToFloat(const bfloat16 *src, float *dest, SizeType n);
+
+// Widen fixed point values, i.e. dest = src * scale, the null value INT16_MIN becomes NaN
+void WidenToFloat(const int16_t *src, float *dest, SizeType n, float scale);
+
+void NarrowFromFloat(const float *src, float16 *dest, SizeType n);
+
+void NarrowFromFloat(const float *src, bfloat16 *dest, SizeType n);
+
+// Narrow to fixed point values, i.e. dest = round(src / scale), NaN becomes INT16_MIN
+void NarrowFromFloat(const float *src, int16_t *dest, SizeType n, float scale);
+
+}  // namespace yang
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include "yang/data/null.h"
@@ -27,6 +29,21 @@ class CnBaseStd : public Module {
       {"SSE Main", 0}, {"SZSE Main", 1}, {"SZSE ChiNext", 2}, {"SZSE SME", 3},
       {"SSE STAR", 4}, {"SSE CDR", 5},   {"BSE Main", 6}};
 
+  // Stocks of a date whose groups are inserted into the shared indices in date order
+  struct StockGroups {
+    int ii;
+    std::string sector;
+    std::string industry;
+    std::string subindustry;
+    float pclose;
+  };
+
+  struct DateRows {
+    std::vector<StockGroups> stocks;
+    int updated_stock = 0;
+    int updated_idx = 0;
+  };
+
   void RunImpl() final {
     auto &env = this->env();
 
@@ -76,7 +93,9 @@ class CnBaseStd : public Module {
 
     auto raw_prc_file = env.config<std::string>("raw_prc_file");
     auto index_file = env.config<std::string>("index_file");
-    for (int di = start_di(); di < end_di(); ++di) {
+    // Dates are parsed in parallel into their own rows, the shared group indices and the checks
+    // against the previous date are done in date order by the merge
+    auto parse = [&](int di) {
       int date = env.dates()[di];
 
       auto raw_prc_path = FormatDate(raw_prc_file, date);
@@ -84,8 +103,7 @@ class CnBaseStd : public Module {
       LOG_INFO("Loading {}", raw_prc_path);
       LOG_INFO("Loading {}", index_path);
 
-      int updated_stock = 0;
-      int updated_idx = 0;
+      DateRows rows;
 
       univ_all.row_vec(di).copy_from(listing.row_vec(di));
 
@@ -95,50 +113,64 @@ class CnBaseStd : public Module {
         std::string line;
         file->ReadLine(line);
         SimpleCsvReader reader(line, '|');
+        int sid_col = reader.Column("sid");
+        int open_col = reader.Column("open");
+        int close_col = reader.Column("close");
+        int high_col = reader.Column("high");
+        int low_col = reader.Column("low");
+        int vol_col = reader.Column("vol");
+        int dvol_col = reader.Column("dvol");
+        int sector_col = reader.Column("sector");
+        int industry_col = reader.Column("ind");
+        int subindustry_col = reader.Column("subind");
+        int sho_col = reader.Column("sho");
+        int flo_col = reader.Column("flo");
+        int pclose_col = reader.Column("pclose");
+        int adj_col = reader.Column("adj");
+        int name_col = reader.Column("name");
+        int halt_col = reader.FindColumn("halt");
+        int active_col = halt_col < 0 ? reader.Column("active") : -1;
+        int up_col = reader.Column("up");
+        int down_col = reader.Column("down");
+        int exch_col = reader.Column("exch");
 
         while (file->ReadLine(line)) {
           reader.ReadNext(line);
-          auto sid = reader["sid"];
+          auto sid = reader[sid_col];
           if (sid.size() != 9) LOG_FATAL("sid {} error", sid);
 
           int ii = env.univ().Find(di, sid);
 
           if (ii < 0) continue;
-          open_arr(di, ii) = reader.Get<float>("open");
-          close_arr(di, ii) = reader.Get<float>("close");
+          open_arr(di, ii) = reader.Get<float>(open_col);
+          close_arr(di, ii) = reader.Get<float>(close_col);
 
-          high_arr(di, ii) = reader.Get<float>("high");
-          low_arr(di, ii) = reader.Get<float>("low");
-          vol_arr(di, ii) = reader.Get<float>("vol");
-          dvol_arr(di, ii) = reader.Get<float>("dvol");
+          high_arr(di, ii) = reader.Get<float>(high_col);
+          low_arr(di, ii) = reader.Get<float>(low_col);
+          vol_arr(di, ii) = reader.Get<float>(vol_col);
+          dvol_arr(di, ii) = reader.Get<float>(dvol_col);
           vwap_arr(di, ii) = vol_arr(di, ii) == 0 ? 0 : dvol_arr(di, ii) / vol_arr(di, ii);
 
-          auto sector = reader["sector"];
-          auto industry = reader["ind"];
-          auto subindustry = reader["subind"];
+          auto sector = reader[sector_col];
+          auto industry = reader[industry_col];
+          auto subindustry = reader[subindustry_col];
+
+          auto pclose = reader.Get<float>(pclose_col);
 
           cty_arr(di, ii) = 1;
-          sector_arr(di, ii) = sector_idx.Insert(std::string(sector));
-          industry_arr(di, ii) = industry_idx.Insert(std::string(industry));
-          subindustry_arr(di, ii) = subindustry_idx.Insert(std::string(subindustry));
+          rows.stocks.push_back({ii, std::string(sector), std::string(industry),
+                                 std::string(subindustry), pclose});
 
-          sharesout_arr(di, ii) = reader.Get<float>("sho");
-          sharesfloat_arr(di, ii) = reader.Get<float>("flo");
-          cap_arr(di, ii) = sharesout_arr(di, ii) * reader.Get<float>("pclose");
+          sharesout_arr(di, ii) = reader.Get<float>(sho_col);
+          sharesfloat_arr(di, ii) = reader.Get<float>(flo_col);
+          cap_arr(di, ii) = sharesout_arr(di, ii) * pclose;
 
-          adj_arr(di, ii) = reader.Get<float>("adj");
+          adj_arr(di, ii) = reader.Get<float>(adj_col);
           if (!IsValid(adj_arr(di, ii))) {
             adj_arr(di, ii) = 1.;
           }
 
-          if (di > 0) {
-            float adj_ = close_arr(di - 1, ii) / reader.Get<float>("pclose");
-            if (std::abs(adj_arr(di, ii) - adj_) > 1e-5) {
-              LOG_ERROR("Invalid adj: {} - {}, {} - {}: {}, {}", di, dates()[di], ii, univ()[ii],
-                        adj_arr(di, ii), adj_);
-            }
-          }
-          auto sid_name = reader["name"];
+          auto sid_name = reader[name_col];
           auto st_pos = sid_name.find("ST");
 
           if (st_pos == std::string::npos) {
@@ -148,16 +180,16 @@ class CnBaseStd : public Module {
             st_arr(di, ii) = 1;
           }
 
-          if (reader.header().count("halt")) {
-            halt_arr(di, ii) = reader.Get<int>("halt", 0) != 0;
+          if (halt_col >= 0) {
+            halt_arr(di, ii) = reader.Get<int>(halt_col, 0) != 0;
           } else {
-            halt_arr(di, ii) = 1 - reader.Get<int>("active", 1);
+            halt_arr(di, ii) = 1 - reader.Get<int>(active_col, 1);
           }
           if (halt_arr(di, ii)) univ_all(di, ii) = false;
 
-          limit_up_arr(di, ii) = reader.Get<float>("up");
-          limit_down_arr(di, ii) = reader.Get<float>("down");
-          auto exch = reader["exch"];
+          limit_up_arr(di, ii) = reader.Get<float>(up_col);
+          limit_down_arr(di, ii) = reader.Get<float>(down_col);
+          auto exch = reader[exch_col];
           if (exchanges.count(exch)) {
             exch_arr(di, ii) = exchanges.at(exch);
           } else {
@@ -165,9 +197,9 @@ class CnBaseStd : public Module {
           }
 
           if (indices.contains(std::string_view(sid))) {
-            updated_idx++;
+            rows.updated_idx++;
           } else {
-            updated_stock++;
+            rows.updated_stock++;
           }
         }
       } catch (const std::exception &ex) {
@@ -179,21 +211,28 @@ class CnBaseStd : public Module {
         std::string line;
         index_file->ReadLine(line);
         SimpleCsvReader reader(line, '|');
+        int sid_col = reader.Column("sid");
+        int open_col = reader.Column("open");
+        int close_col = reader.Column("close");
+        int high_col = reader.Column("high");
+        int low_col = reader.Column("low");
+        int vol_col = reader.Column("vol");
+        int dvol_col = reader.Column("dvol");
 
         while (index_file->ReadLine(line)) {
           reader.ReadNext(line);
-          auto iid = std::string(reader["sid"]);
+          auto iid = std::string(reader[sid_col]);
           if (iid.size() != 9) LOG_FATAL("sid {} error", iid);
           int ii = env.univ().Find(di, iid);
 
           if (ii < 0) continue;
 
-          open_arr(di, ii) = reader.Get<float>("open");
-          close_arr(di, ii) = reader.Get<float>("close");
-          high_arr(di, ii) = reader.Get<float>("high");
-          low_arr(di, ii) = reader.Get<float>("low");
-          vol_arr(di, ii) = reader.Get<float>("vol");
-          dvol_arr(di, ii) = reader.Get<float>("dvol");
+          open_arr(di, ii) = reader.Get<float>(open_col);
+          close_arr(di, ii) = reader.Get<float>(close_col);
+          high_arr(di, ii) = reader.Get<float>(high_col);
+          low_arr(di, ii) = reader.Get<float>(low_col);
+          vol_arr(di, ii) = reader.Get<float>(vol_col);
+          dvol_arr(di, ii) = reader.Get<float>(dvol_col);
           vwap_arr(di, ii) = vol_arr(di, ii) == 0 ? 0 : dvol_arr(di, ii) / vol_arr(di, ii);
 
           cumadj_arr(di, ii) = 1;
@@ -204,14 +243,32 @@ class CnBaseStd : public Module {
           limit_down_arr(di, ii) = 0.;
 
           if (indices.contains(iid)) {
-            updated_idx++;
+            rows.updated_idx++;
           }
         }
       } catch (const std::exception &ex) {
         LOG_FATAL("Failed to load {}: {}", index_path, ex.what());
       }
-      LOG_INFO("[{}] [{}] Loaded {} stocks, {} indices", name(), date, updated_stock, updated_idx);
-    }
+      return rows;
+    };
+    auto merge = [&](int di, DateRows rows) {
+      for (auto &stock : rows.stocks) {
+        int ii = stock.ii;
+        sector_arr(di, ii) = sector_idx.Insert(std::move(stock.sector));
+        industry_arr(di, ii) = industry_idx.Insert(std::move(stock.industry));
+        subindustry_arr(di, ii) = subindustry_idx.Insert(std::move(stock.subindustry));
+        if (di > 0) {
+          float adj_ = close_arr(di - 1, ii) / stock.pclose;
+          if (std::abs(adj_arr(di, ii) - adj_) > 1e-5) {
+            LOG_ERROR("Invalid adj: {} - {}, {} - {}: {}, {}", di, dates()[di], ii, univ()[ii],
+                      adj_arr(di, ii), adj_);
+          }
+        }
+      }
+      LOG_INFO("[{}] [{}] Loaded {} stocks, {} indices", name(), env.dates()[di],
+               rows.updated_stock, rows.updated_idx);
+    };
+    parallel_ingest<DateRows>(start_di(), end_di(), parse, merge);
     sector_idx.Save();
     industry_idx.Save();
     subindustry_idx.Save();
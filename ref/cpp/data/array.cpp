@@ -1,15 +1,23 @@
 #include "yang/data/array.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <optional>
 #include <vector>
 
 #include "yang/base/exception.h"
+#include "yang/data/compressed_array.h"
+#include "yang/data/row_versions.h"
 #include "yang/util/config.h"
+#include "yang/util/dir_lock.h"
+#include "yang/util/task_pool.h"
 
 namespace yang {
 namespace detail {
 
+static constexpr SizeType PARALLEL_COPY_BLOCK_SIZE = 16 << 20;
+
 static void CopyArrayImpl(uint8_t *dest, const ArrayShape &dest_shape,
                           const ArrayShape &dest_stride, uint8_t *src, const ArrayShape &src_shape,
                           const ArrayShape &src_stride, SizeType item_size,
@@ -63,8 +71,30 @@ void ArrayBackend::CopyArray(void *dest, const ArrayShape &dest_shape, void *src
     src_stride[i] = stride;
     stride *= src_shape[i];
   }
-  CopyArrayImpl(reinterpret_cast<uint8_t *>(dest), dest_shape, dest_stride,
-                reinterpret_cast<uint8_t *>(src), src_shape, src_stride, item_size, filler, 0);
+  auto dest_ptr = reinterpret_cast<uint8_t *>(dest);
+  auto src_ptr = reinterpret_cast<uint8_t *>(src);
+  SizeType n = std::min(src_shape[0], dest_shape[0]);
+  SizeType row_bytes = dest_stride[0] * item_size;
+  // only parallel within a pool, threads of its own would oversubscribe the pool's workers
+  auto pool = TaskPool::Current();
+  if (stride_end == 0 || pool == nullptr || n * row_bytes < 2 * PARALLEL_COPY_BLOCK_SIZE) {
+    CopyArrayImpl(dest_ptr, dest_shape, dest_stride, src_ptr, src_shape, src_stride, item_size,
+                  filler, 0);
+    return;
+  }
+
+  // copy the common rows of the outermost dimension in parallel, each row is independent
+  SizeType grain = std::max<SizeType>(1, PARALLEL_COPY_BLOCK_SIZE / row_bytes);
+  pool->ParallelFor(0, n, grain, [&](int64_t start, int64_t end) {
+    for (SizeType i = start; i < end; ++i) {
+      CopyArrayImpl(dest_ptr + i * dest_stride[0] * item_size, dest_shape, dest_stride,
+                    src_ptr + i * src_stride[0] * item_size, src_shape, src_stride, item_size,
+                    filler, 1);
+    }
+  });
+  if (n < dest_shape[0]) {
+    filler(dest_ptr + n * dest_stride[0] * item_size, (dest_shape[0] - n) * dest_stride[0]);
+  }
 }
 
 void DefaultArrayBackend::Resize(const ArrayShape &old_shape, const ArrayShape &new_shape,
@@ -105,13 +135,22 @@ void DefaultArrayBackend::Free() {
 
 MMapArrayBackend::MMapArrayBackend(const std::string &path, bool writable,
                                    const std::string &item_type, SizeType item_size,
-                                   const ArrayShape &shape, const Filler &filler)
-    : path_(path), writable_(writable) {
+                                   const ArrayShape &shape, const Filler &filler,
+                                   const MMapHints &hints)
+    : path_(path), writable_(writable), hints_(hints) {
+  std::optional<DirLock> lock;
+  if (writable) lock.emplace(fs::path(path_).parent_path());
   if (fs::exists(path_)) {
     // existing file
     if (meta_.Load(GetMetaPath())) {
+      scale_ = meta_.scale;
       if (!meta_.shape.empty()) {
         meta_.Check(item_type, item_size);
+        if (!meta_.compression.empty()) {
+          ENSURE(!writable, "Compressed array is read-only: {}", path_);
+          LoadCompressedFile();
+          return;
+        }
         if (writable && !shape.empty() && shape != meta_.shape) {
           // skip loading file to avoid unnecessary munmap
           Resize(ArrayShape(meta_.shape), shape, item_size, filler);
@@ -136,13 +175,46 @@ MMapArrayBackend::MMapArrayBackend(const std::string &path, bool writable,
   }
 }
 
-void MMapArrayBackend::LoadFile() {
+MMapArrayBackend::~MMapArrayBackend() {}
+
+void MMapArrayBackend::LoadCompressedFile() {
+  // blocks are decompressed on first access and only the most recent ones stay in memory, unless
+  // the array is to be populated anyway
+  if (!hints_.populate && CompressedArrayView::Supported()) {
+    view_ = std::make_unique<CompressedArrayView>(path_);
+    view_data_ = view_->data();
+    LOG_DEBUG("Mapped {} ({}, compressed)", path_, shape());
+    return;
+  }
+  CompressedArrayReader reader(path_);
   MMapFile::Options options;
-  options.filename = path_;
+  options.size = reader.rows() * reader.row_bytes();
+  options.hints = hints_;
+  file_.Initialize(options);
+  reader.ReadAll(file_.addr(), TaskPool::Current());
+  LOG_DEBUG("Loaded {} ({}, compressed)", path_, shape());
+}
+
+MMapFile::Options MMapArrayBackend::MakeOptions(const std::string &filename, bool create,
+                                                SizeType size) const {
+  MMapFile::Options options;
+  options.filename = filename;
   options.writable = writable_;
   options.lock = false;
-  options.create = false;
-  file_.Initialize(options);
+  options.create = create;
+  options.size = size;
+  options.hints = hints_;
+  if (writable_) {
+    // leave room for the date dimension to grow without remapping
+    SizeType file_size = size;
+    if (file_size == 0 && fs::exists(filename)) file_size = fs::file_size(filename);
+    options.reserve_size = std::max<SizeType>(file_size * 2, MIN_RESERVE_SIZE);
+  }
+  return options;
+}
+
+void MMapArrayBackend::LoadFile() {
+  file_.Initialize(MakeOptions(path_, false, 0));
   LOG_DEBUG("Loaded {} ({})", path_, shape());
 }
 
@@ -170,17 +242,16 @@ void MMapArrayBackend::Resize(const ArrayShape &old_shape, const ArrayShape &new
   }
 
   fs::create_directories(fs::path(path_).parent_path());
-  MMapFile::Options options;
-  options.filename = path_;
-  options.writable = writable_;
-  options.lock = false;
-  options.create = true;
   SizeType new_size = 1;
   for (auto &d : new_shape) new_size *= d;
-  options.size = new_size * item_size;
+  auto options = MakeOptions(path_, true, new_size * item_size);
   if (extend_only) {
-    file_.Reset();
-    file_.Initialize(options);
+    if (file_.addr()) {
+      // grow in place, existing rows are neither copied nor remapped
+      file_.Resize(options.size);
+    } else {
+      file_.Initialize(options);
+    }
     ENSURE(file_.size() == options.size, "file size mismatch");
     SizeType old_len = old_shape.empty() ? 0 : old_shape[0];
     if (new_shape[0] > old_len) {
@@ -206,6 +277,30 @@ void MMapArrayBackend::Resize(const ArrayShape &old_shape, const ArrayShape &new
   }
 }
 
+void MMapArrayBackend::set_scale(double scale) {
+  ENSURE(writable_, "not writable");
+  scale_ = meta_.scale = scale;
+  if (!meta_.shape.empty()) meta_.Save(GetMetaPath());
+}
+
+void MMapArrayBackend::UpdateRowVersions(SizeType start_row, SizeType end_row, uint64_t version) {
+  ENSURE(writable_, "not writable");
+  if (meta_.shape.empty()) return;
+  end_row = std::min(end_row, meta_.shape[0]);
+  if (start_row >= end_row) return;
+
+  SizeType row_bytes = meta_.item_size;
+  for (int i = 1; i < static_cast<int>(meta_.shape.size()); ++i) row_bytes *= meta_.shape[i];
+  auto checksums = RowVersions::ChecksumRows(file_.addr(), row_bytes, start_row, end_row);
+  // shards of the module in other processes update other rows of the same sidecar, so the read,
+  // merge and rename happen under the lock also taken to create or resize the array
+  DirLock lock(fs::path(path_).parent_path());
+  RowVersions versions(path_);
+  auto changed = versions.Update(start_row, checksums, version);
+  versions.Save();
+  LOG_DEBUG("Updated row versions of {}: {}/{} rows changed", path_, changed, end_row - start_row);
+}
+
 void MMapArrayBackend::ResizeRaw(const ArrayShape &new_shape, SizeType item_size) {
   ENSURE(writable_, "not writable");
   if (meta_.shape == new_shape) return;
@@ -215,14 +310,11 @@ void MMapArrayBackend::ResizeRaw(const ArrayShape &new_shape, SizeType item_size
 
   if (new_size != static_cast<SizeType>(file_.size())) {
     fs::create_directories(fs::path(path_).parent_path());
-    MMapFile::Options options;
-    options.filename = path_;
-    options.writable = writable_;
-    options.lock = false;
-    options.create = true;
-    options.size = new_size;
-    file_.Reset();
-    file_.Initialize(options);
+    if (file_.addr()) {
+      file_.Resize(new_size);
+    } else {
+      file_.Initialize(MakeOptions(path_, true, new_size));
+    }
   }
   meta_.shape = new_shape;
   meta_.Save(GetMetaPath());
@@ -234,6 +326,9 @@ bool ArrayMeta::Load(const std::string &path) {
       auto meta_config = Config::LoadFile(path);
       item_type = meta_config.Get<std::string>("item_type");
       item_size = meta_config.Get<SizeType>("item_size");
+      scale = meta_config.Get<double>("scale", 0);
+      compression = meta_config.Get<std::string>("compression", "");
+      block_rows = meta_config.Get<SizeType>("block_rows", 0);
       shape.clear();
       for (auto d : meta_config.Get<std::vector<SizeType>>("shape")) {
         shape.push_back(d);
@@ -251,6 +346,11 @@ void ArrayMeta::Save(const std::string &path) const {
   meta_config.Set("item_type", item_type);
   meta_config.Set("item_size", item_size);
   meta_config.Set("shape", std::vector<SizeType>(shape.begin(), shape.end()));
+  if (scale != 0) meta_config.Set("scale", scale);
+  if (!compression.empty()) {
+    meta_config.Set("compression", compression);
+    meta_config.Set("block_rows", block_rows);
+  }
 
   std::ofstream ofs(path);
   ofs << meta_config.ToYamlString();
@@ -270,6 +370,14 @@ void ArrayBase::Copy(const std::string &from, const std::string &to) {
   fs::create_directories(fs::path(to).parent_path());
   fs::copy_file(from, to, fs::copy_options::overwrite_existing);
   fs::copy_file(from + ".meta", to + ".meta", fs::copy_options::overwrite_existing);
+  if (fs::exists(RowVersions::GetPath(from))) {
+    fs::copy_file(RowVersions::GetPath(from), RowVersions::GetPath(to),
+                  fs::copy_options::overwrite_existing);
+  }
+}
+
+void ArrayBase::Compress(const std::string &path, int block_rows, TaskPool *pool) {
+  CompressedArrayReader::Compress(path, block_rows, 3, pool);
 }
 
 std::string ArrayBase::GetItemType(std::string_view array_path) {
@@ -279,4 +387,16 @@ std::string ArrayBase::GetItemType(std::string_view array_path) {
   return meta.item_type;
 }
 
+bool IsReducedPrecisionArray(const std::string &path) {
+  detail::ArrayMeta meta;
+  if (!meta.Load(path + ".meta")) return false;
+  return meta.item_type == GetTypeName<float16>() || meta.item_type == GetTypeName<bfloat16>() ||
+         (meta.item_type == GetTypeName<int16_t>() && meta.scale != 0);
+}
+
+bool IsCompressedArray(const std::string &path) {
+  detail::ArrayMeta meta;
+  return meta.Load(path + ".meta") && !meta.compression.empty();
+}
+
 }  // namespace yang
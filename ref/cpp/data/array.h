@@ -5,7 +5,9 @@
 #include <memory>
 #include <string>
 #include <type_traits>
+#include <vector>
 
+#include "yang/base/float16.h"
 #include "yang/base/likely.h"
 #include "yang/base/size.h"
 #include "yang/data/null.h"
@@ -19,6 +21,9 @@
 
 namespace yang {
 
+class CompressedArrayView;
+class TaskPool;
+
 using ArrayShape = small_vector<SizeType, 4>;
 
 namespace detail {
@@ -27,6 +32,9 @@ struct ArrayMeta {
   std::string item_type;
   SizeType item_size;
   ArrayShape shape;
+  double scale = 0;  // fixed point scale of integer items, 0 means unscaled
+  std::string compression;  // empty means uncompressed
+  SizeType block_rows = 0;  // rows per compressed block
 
   bool Load(const std::string &path);
   void Save(const std::string &path) const;
@@ -43,8 +51,22 @@ struct ArrayBackend {
 
   virtual void *data() const = 0;
 
+  double scale() const {
+    return scale_;
+  }
+
+  virtual void set_scale(double scale) {
+    scale_ = scale;
+  }
+
+  // Only arrays backed by files keep row versions, see RowVersions
+  virtual void UpdateRowVersions(SizeType start_row, SizeType end_row, uint64_t version) {}
+
   static void CopyArray(void *dest, const ArrayShape &dest_shape, void *src,
                         const ArrayShape &src_shape, SizeType item_size, const Filler &filler);
+
+ protected:
+  double scale_ = 0;
 };
 
 class DefaultArrayBackend : public ArrayBackend {
@@ -72,10 +94,13 @@ class DefaultArrayBackend : public ArrayBackend {
 class MMapArrayBackend : public ArrayBackend {
  public:
   MMapArrayBackend(const std::string &path, bool writable, const std::string &item_type,
-                   SizeType item_size, const ArrayShape &shape, const Filler &filler);
+                   SizeType item_size, const ArrayShape &shape, const Filler &filler,
+                   const MMapHints &hints = {});
+
+  ~MMapArrayBackend();
 
   void *data() const final {
-    return file_.addr();
+    return view_data_ ? view_data_ : file_.addr();
   }
 
   const ArrayShape &shape() const {
@@ -87,14 +112,27 @@ class MMapArrayBackend : public ArrayBackend {
 
   void ResizeRaw(const ArrayShape &new_shape, SizeType item_size) final;
 
+  void set_scale(double scale) final;
+
+  void UpdateRowVersions(SizeType start_row, SizeType end_row, uint64_t version) final;
+
  private:
   MMapFile file_;
+  std::unique_ptr<CompressedArrayView> view_;  // see LoadCompressedFile
+  void *view_data_ = nullptr;
   std::string path_;
   bool writable_;
+  MMapHints hints_;
   ArrayMeta meta_;
 
+  static constexpr SizeType MIN_RESERVE_SIZE = 64 << 20;
+
   void LoadFile();
 
+  void LoadCompressedFile();
+
+  MMapFile::Options MakeOptions(const std::string &filename, bool create, SizeType size) const;
+
   std::string GetMetaPath() const {
     return path_ + ".meta";
   }
@@ -113,6 +151,9 @@ class ArrayBase {
 
   static void Copy(const std::string &from, const std::string &to);
 
+  // Convert the array at path into the read-only compressed format, see CompressedArrayReader
+  static void Compress(const std::string &path, int block_rows = 64, TaskPool *pool = nullptr);
+
   static std::string GetItemType(std::string_view array_path);
 };
 
@@ -121,6 +162,8 @@ class Array : public ArrayBase {
   static_assert(std::is_trivially_copyable_v<T>);
 
  public:
+  using value_type = T;
+
   Array(const T &null = GetNullValue<T>()) : ptr_(nullptr), null_value_(null) {}
 
   Array(const ArrayShape &shape, const T &null = GetNullValue<T>()) : Array(null) {
@@ -167,13 +210,14 @@ class Array : public ArrayBase {
     return true;
   }
 
-  static Array MMap(const std::string &path, bool writable = false) {
-    return MMapInternal(path, writable, ArrayShape({}));
+  static Array MMap(const std::string &path, bool writable = false,
+                    const MMapHints &hints = {}) {
+    return MMapInternal(path, writable, ArrayShape({}), GetNullValue<T>(), hints);
   }
 
   static Array MMap(const std::string &path, const ArrayShape &shape,
-                    const T &null = GetNullValue<T>()) {
-    return MMapInternal(path, true, shape, null);
+                    const T &null = GetNullValue<T>(), const MMapHints &hints = {}) {
+    return MMapInternal(path, true, shape, null, hints);
   }
 
   std::string_view item_type() const final {
@@ -200,6 +244,23 @@ class Array : public ArrayBase {
     null_value_ = v;
   }
 
+  // Fixed point scale of integer arrays, i.e. value = item * scale. 0 means unscaled.
+  double scale() const {
+    return backend_ ? backend_->scale() : 0;
+  }
+
+  void set_scale(double scale) {
+    static_assert(std::is_integral_v<T>, "scale is only supported by integer arrays");
+    EnsureDefaultBackend();
+    backend_->set_scale(scale);
+  }
+
+  // Bump the version of the rows in [row_begin, row_end) whose content changed since the last
+  // update. Only mmap backed arrays keep row versions.
+  void UpdateRowVersions(SizeType row_begin, SizeType row_end, uint64_t version) {
+    if (backend_) backend_->UpdateRowVersions(row_begin, row_end, version);
+  }
+
   template <class... Args>
   const T &operator()(Args... indexes) const {
     return ptr_[GetOffset(indexes...)];
@@ -311,6 +372,7 @@ class Array : public ArrayBase {
     std::ifstream ifs(path, std::ios::binary);
     if (!ifs.good()) throw MakeExcept<IoError>("Failed to read {}", path);
     ifs.read(reinterpret_cast<char *>(array.ptr_), array.GetNumItems() * sizeof(T));
+    if (meta.scale != 0) array.backend_->set_scale(meta.scale);
     LOG_DEBUG("Loaded {} ({})", path, array.shape_);
     return array;
   }
@@ -326,6 +388,7 @@ class Array : public ArrayBase {
     meta.item_type = GetTypeName<T>();
     meta.item_size = sizeof(T);
     meta.shape = shape_;
+    meta.scale = scale();
     meta.Save(path + ".meta");
     LOG_DEBUG("Saved {}", path);
   }
@@ -429,11 +492,11 @@ class Array : public ArrayBase {
   }
 
   static Array MMapInternal(const std::string &path, bool writable, const ArrayShape &shape,
-                            const T &null = GetNullValue<T>()) {
+                            const T &null = GetNullValue<T>(), const MMapHints &hints = {}) {
     Array array(null);
     auto mmap = std::make_shared<detail::MMapArrayBackend>(
         path, writable, std::string(GetTypeName<T>()), sizeof(T), shape,
-        [&array](void *dest, SizeType n) { array.FillItems(dest, n); });
+        [&array](void *dest, SizeType n) { array.FillItems(dest, n); }, hints);
     array.shape_ = mmap->shape();
     array.ptr_ = reinterpret_cast<T *>(mmap->data());
     array.backend_ = std::move(mmap);
@@ -441,4 +504,17 @@ class Array : public ArrayBase {
   }
 };
 
+// Whether the array at path stores floating point values with reduced precision, i.e. float16,
+// bfloat16 or scaled int16
+bool IsReducedPrecisionArray(const std::string &path);
+
+// Whether the array at path is stored compressed, i.e. read into memory instead of mapped
+bool IsCompressedArray(const std::string &path);
+
+template <class T>
+constexpr bool is_array_v = false;
+
+template <class T>
+constexpr bool is_array_v<Array<T>> = true;
+
 }  // namespace yang
@@ -0,0 +1,495 @@
+#include "yang/data/compressed_array.h"
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+#ifdef __aarch64__
+#include <asm/sigcontext.h>
+#endif
+
+#include "yang/base/exception.h"
+#include "yang/util/dir_lock.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+
+static constexpr uint64_t COMPRESSED_ARRAY_MAGIC = 0x3130305241524359;  // "YCARR001"
+
+static std::string GetTmpPath(const std::string &path) {
+  return path + ".zst.tmp";
+}
+
+static bool HasMagic(const std::string &path) {
+  std::ifstream ifs(path, std::ios::binary);
+  uint64_t magic = 0;
+  if (!ifs.seekg(-static_cast<int>(sizeof(magic)), std::ios::end)) return false;
+  ifs.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  return ifs.good() && magic == COMPRESSED_ARRAY_MAGIC;
+}
+
+CompressedArrayReader::CompressedArrayReader(const std::string &path, MMapAdvice advice)
+    : path_(path) {
+  if (!meta_.Load(path_ + ".meta")) throw MakeExcept<IoError>("Array meta missing: {}", path_);
+  ENSURE(meta_.compression == COMPRESSION, "Unsupported compression for {}: {}", path_,
+         meta_.compression);
+  ENSURE(!meta_.shape.empty() && meta_.block_rows > 0, "Invalid compressed array meta: {}", path_);
+
+  row_bytes_ = meta_.item_size;
+  for (int i = 1; i < static_cast<int>(meta_.shape.size()); ++i) row_bytes_ *= meta_.shape[i];
+
+  MMapFile::Options options;
+  options.filename = path_;
+  options.writable = false;
+  options.create = false;
+  options.hints.advice = advice;
+  file_.Initialize(options);
+
+  // parse the trailer
+  ENSURE(file_.size() >= 3 * sizeof(uint64_t), "Compressed array truncated: {}", path_);
+  auto trailer = reinterpret_cast<const uint64_t *>(file_.addr() + file_.size()) - 2;
+  if (trailer[1] != COMPRESSED_ARRAY_MAGIC) {
+    if (fs::exists(GetTmpPath(path_))) {
+      throw MakeExcept<IoError>("Interrupted compression of {}, compress it again to finish",
+                                path_);
+    }
+    throw MakeExcept<IoError>("Compressed array corrupted: {}", path_);
+  }
+  num_blocks_ = trailer[0];
+  ENSURE(num_blocks_ == static_cast<int>((rows() + meta_.block_rows - 1) / meta_.block_rows),
+         "Compressed array block count mismatch: {}", path_);
+  offsets_ = trailer - (num_blocks_ + 1);
+  ENSURE(reinterpret_cast<const uint8_t *>(offsets_) >= file_.addr(),
+         "Compressed array corrupted: {}", path_);
+}
+
+SizeType CompressedArrayReader::GetBlockRows(int block) const {
+  return std::min<SizeType>(meta_.block_rows, rows() - block * meta_.block_rows);
+}
+
+size_t CompressedArrayReader::DecompressBlock(int block, void *dest, ZSTD_DCtx *dctx) const {
+  return ZSTD_decompressDCtx(dctx, dest, GetBlockRows(block) * row_bytes_,
+                             file_.addr() + offsets_[block], offsets_[block + 1] - offsets_[block]);
+}
+
+void CompressedArrayReader::DecompressBlock(int block, void *dest) const {
+  SizeType size = GetBlockRows(block) * row_bytes_;
+  auto ret = ZSTD_decompress(dest, size, file_.addr() + offsets_[block],
+                             offsets_[block + 1] - offsets_[block]);
+  if (ZSTD_isError(ret)) {
+    throw MakeExcept<IoError>("Failed to decompress block {} of {}: {}", block, path_,
+                              ZSTD_getErrorName(ret));
+  }
+  ENSURE(static_cast<SizeType>(ret) == size, "Block size mismatch in {}: expected {}, got {}", path_,
+         size, ret);
+}
+
+void CompressedArrayReader::ReadAll(void *dest, TaskPool *pool) const {
+  auto out = reinterpret_cast<uint8_t *>(dest);
+  TaskPool::ParallelFor(pool, 0, num_blocks_, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t block = begin; block < end; ++block) {
+      DecompressBlock(block, out + block * meta_.block_rows * row_bytes_);
+    }
+  });
+}
+
+void CompressedArrayReader::Compress(const std::string &path, int block_rows, int level,
+                                     TaskPool *pool) {
+  ENSURE(block_rows > 0, "Invalid block_rows: {}", block_rows);
+  // the meta is committed before the data, so a compressed meta next to data without the trailer
+  // magic means the data of tmp_path is still to be renamed
+  DirLock lock(fs::path(path).parent_path());
+  auto tmp_path = GetTmpPath(path);
+  auto tmp_meta_path = tmp_path + ".meta";
+  detail::ArrayMeta meta;
+  if (!meta.Load(path + ".meta")) throw MakeExcept<IoError>("Array meta missing: {}", path);
+  if (!meta.compression.empty()) {
+    ENSURE(fs::exists(tmp_path) && !HasMagic(path), "Array already compressed: {}", path);
+    fs::rename(tmp_path, path);
+    LOG_INFO("Finished the interrupted compression of {}", path);
+    return;
+  }
+  ENSURE(!meta.shape.empty(), "Empty array: {}", path);
+
+  MMapFile src;
+  MMapFile::Options options;
+  options.filename = path;
+  options.writable = false;
+  options.create = false;
+  options.hints.advice = MMapAdvice::SEQUENTIAL;
+  src.Initialize(options);
+
+  SizeType row_bytes = meta.item_size;
+  for (int i = 1; i < static_cast<int>(meta.shape.size()); ++i) row_bytes *= meta.shape[i];
+  SizeType rows = meta.shape[0];
+  ENSURE(static_cast<SizeType>(src.size()) == rows * row_bytes, "Array size mismatch: {}", path);
+  int num_blocks = (rows + block_rows - 1) / block_rows;
+
+  std::vector<std::vector<uint8_t>> blocks(num_blocks);
+  TaskPool::ParallelFor(pool, 0, num_blocks, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t block = begin; block < end; ++block) {
+      SizeType start = block * block_rows;
+      SizeType size = (std::min<SizeType>(rows, start + block_rows) - start) * row_bytes;
+      auto &out = blocks[block];
+      out.resize(ZSTD_compressBound(size));
+      auto ret = ZSTD_compress(out.data(), out.size(), src.addr() + start * row_bytes, size, level);
+      if (ZSTD_isError(ret)) {
+        throw MakeExcept<IoError>("Failed to compress block {} of {}: {}", block, path,
+                                  ZSTD_getErrorName(ret));
+      }
+      out.resize(ret);
+    }
+  });
+
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary);
+    if (!ofs.good()) throw MakeExcept<IoError>("Failed to write {}", tmp_path);
+    std::vector<uint64_t> trailer;
+    trailer.reserve(num_blocks + 3);
+    uint64_t offset = 0;
+    for (auto &block : blocks) {
+      trailer.push_back(offset);
+      ofs.write(reinterpret_cast<const char *>(block.data()), block.size());
+      offset += block.size();
+    }
+    // blocks are byte aligned, pad so that the trailer can be read in place
+    uint64_t padding = (sizeof(uint64_t) - offset % sizeof(uint64_t)) % sizeof(uint64_t);
+    ofs.write("\0\0\0\0\0\0\0", padding);
+    trailer.push_back(offset);
+    trailer.push_back(num_blocks);
+    trailer.push_back(COMPRESSED_ARRAY_MAGIC);
+    ofs.write(reinterpret_cast<const char *>(trailer.data()), trailer.size() * sizeof(uint64_t));
+    if (!ofs.good()) throw MakeExcept<IoError>("Failed to write {}", tmp_path);
+    LOG_INFO("Compressed {}: {} -> {} bytes", path, src.size(), offset);
+  }
+  src.Reset();
+
+  meta.compression = COMPRESSION;
+  meta.block_rows = block_rows;
+  meta.Save(tmp_meta_path);
+  fs::rename(tmp_meta_path, path + ".meta");
+  fs::rename(tmp_path, path);
+}
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+
+// Views are registered in a fixed table, which the SIGSEGV handler scans without locks
+static constexpr int MAX_VIEWS = 4096;
+static std::atomic<CompressedArrayView::Region *> g_views[MAX_VIEWS];
+static std::atomic<int> g_num_view_slots{0};
+static std::atomic<int> g_active_handlers{0};
+static struct sigaction g_old_action;
+
+struct CompressedArrayView::Region {
+  CompressedArrayReader reader;
+  int max_blocks;
+  SizeType size = 0;
+  SizeType block_bytes = 0;
+  SizeType page_size = 0;
+  SizeType mapped_size = 0;
+  int fd = -1;
+  uint8_t *view = nullptr;
+  uint8_t *alias = nullptr;  // writable mapping of the same pages
+  ZSTD_DCtx *dctx = nullptr;
+  std::vector<uint8_t> scratch;
+  std::vector<uint8_t> page_resident;
+  std::vector<uint8_t> block_resident;
+  std::vector<int> queue;  // ring of resident blocks, oldest first
+  int queue_head = 0;
+  int queue_count = 0;
+  std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  std::atomic<int64_t> faults{0};
+  int slot = -1;
+
+  Region(const std::string &path, int max_blocks)
+      : reader(path, MMapAdvice::RANDOM), max_blocks(max_blocks) {}
+
+  // Pages [first, last) spanned by a block
+  std::pair<SizeType, SizeType> GetPages(int block) const {
+    SizeType begin = block * block_bytes;
+    SizeType end = std::min(size, begin + block_bytes);
+    return {begin / page_size, (end + page_size - 1) / page_size};
+  }
+
+  bool IsPageUsed(SizeType page) const {
+    SizeType begin = page * page_size;
+    SizeType end = std::min(size, begin + page_size);
+    for (SizeType block = begin / block_bytes; block * block_bytes < end; ++block) {
+      if (block_resident[block]) return true;
+    }
+    return false;
+  }
+
+  bool IsRangeResident(SizeType begin, SizeType end) const {
+    for (SizeType page = begin / page_size; page * page_size < end; ++page) {
+      if (!page_resident[page]) return false;
+    }
+    return true;
+  }
+
+  static void Fail(const char *msg) {
+    auto ret = write(STDERR_FILENO, msg, strlen(msg));
+    (void)ret;
+    abort();
+  }
+
+  void Decompress(int block, uint8_t *dest) {
+    auto ret = reader.DecompressBlock(block, dest, dctx);
+    if (ZSTD_isError(ret) ||
+        static_cast<SizeType>(ret) != reader.GetBlockRows(block) * reader.row_bytes()) {
+      Fail("Failed to decompress a block of a compressed array view\n");
+    }
+  }
+
+  void Evict(int block) {
+    block_resident[block] = 0;
+    auto [first, last] = GetPages(block);
+    for (SizeType page = first; page < last;) {
+      if (!page_resident[page] || IsPageUsed(page)) {
+        ++page;
+        continue;
+      }
+      SizeType end = page;
+      while (end < last && page_resident[end] && !IsPageUsed(end)) page_resident[end++] = 0;
+      // revoke access before the pages are freed, so that readers fault instead of seeing zeros
+      SizeType offset = page * page_size;
+      SizeType len = (end - page) * page_size;
+      if (mprotect(view + offset, len, PROT_NONE) != 0 ||
+          fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) != 0) {
+        Fail("Failed to drop a block of a compressed array view\n");
+      }
+      page = end;
+    }
+  }
+
+  void Fill(int block) {
+    if (queue_count == max_blocks) {
+      Evict(queue[queue_head]);
+      queue_head = (queue_head + 1) % max_blocks;
+      --queue_count;
+    }
+    // pages on the boundary also hold rows of the neighbouring blocks
+    auto [first, last] = GetPages(block);
+    SizeType begin = first * page_size;
+    SizeType end = std::min(size, last * page_size);
+    for (SizeType other = begin / block_bytes; other * block_bytes < end; ++other) {
+      SizeType other_begin = other * block_bytes;
+      if (static_cast<int>(other) == block) {
+        Decompress(other, alias + other_begin);
+        continue;
+      }
+      SizeType lo = std::max(begin, other_begin);
+      SizeType hi = std::min(end, other_begin + block_bytes);
+      if (IsRangeResident(lo, hi)) continue;
+      Decompress(other, scratch.data());
+      memcpy(alias + lo, scratch.data() + (lo - other_begin), hi - lo);
+    }
+    if (mprotect(view + begin, (last - first) * page_size, PROT_READ) != 0) {
+      Fail("Failed to map a block of a compressed array view\n");
+    }
+    for (SizeType page = first; page < last; ++page) page_resident[page] = 1;
+    block_resident[block] = 1;
+    queue[(queue_head + queue_count++) % max_blocks] = block;
+    faults.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Returns false if the fault is not caused by a block that is not resident
+  bool Fault(uint8_t *addr, bool write) {
+    if (write) return false;
+    while (lock.test_and_set(std::memory_order_acquire)) {
+    }
+    SizeType offset = addr - view;
+    // another thread may have faulted the page in since
+    if (!page_resident[offset / page_size]) {
+      Fill(std::min(offset, size - 1) / block_bytes);
+    }
+    lock.clear(std::memory_order_release);
+    return true;
+  }
+};
+
+static bool IsWriteFault(void *context) {
+  auto uc = reinterpret_cast<ucontext_t *>(context);
+#ifdef __x86_64__
+  return uc->uc_mcontext.gregs[REG_ERR] & 2;
+#else
+  // the WnR bit of the syndrome of a data abort
+  auto ctx = reinterpret_cast<_aarch64_ctx *>(uc->uc_mcontext.__reserved);
+  while (ctx->magic != 0) {
+    if (ctx->magic == ESR_MAGIC) return reinterpret_cast<esr_context *>(ctx)->esr & (1 << 6);
+    ctx = reinterpret_cast<_aarch64_ctx *>(reinterpret_cast<uint8_t *>(ctx) + ctx->size);
+  }
+  return false;
+#endif
+}
+
+static void OnSegv(int sig, siginfo_t *info, void *context) {
+  int saved_errno = errno;
+  auto addr = reinterpret_cast<uint8_t *>(info->si_addr);
+  bool handled = false;
+  g_active_handlers.fetch_add(1);
+  int num_slots = g_num_view_slots.load();
+  for (int slot = 0; slot < num_slots && !handled; ++slot) {
+    auto region = g_views[slot].load();
+    if (region && addr >= region->view && addr < region->view + region->mapped_size) {
+      handled = region->Fault(addr, IsWriteFault(context));
+      if (!handled) break;
+    }
+  }
+  g_active_handlers.fetch_sub(1);
+  errno = saved_errno;
+  if (handled) return;
+
+  // not ours, pass it on to the previous handler
+  if (g_old_action.sa_flags & SA_SIGINFO) {
+    g_old_action.sa_sigaction(sig, info, context);
+  } else if (g_old_action.sa_handler == SIG_DFL || g_old_action.sa_handler == SIG_IGN) {
+    // the faulting access is retried with the default action
+    signal(sig, SIG_DFL);
+  } else {
+    g_old_action.sa_handler(sig);
+  }
+}
+
+static void InstallHandler() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = OnSegv;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    ENSURE(sigaction(SIGSEGV, &action, &g_old_action) == 0, "Failed to install SIGSEGV handler");
+  });
+}
+
+bool CompressedArrayView::Supported() {
+  return true;
+}
+
+CompressedArrayView::CompressedArrayView(const std::string &path, int max_blocks)
+    : region_(std::make_unique<Region>(path, max_blocks)) {
+  ENSURE(max_blocks >= 2, "Too few blocks for a compressed array view: {}", max_blocks);
+  auto &r = *region_;
+  r.size = r.reader.rows() * r.reader.row_bytes();
+  r.block_bytes = r.reader.meta().block_rows * r.reader.row_bytes();
+  r.page_size = sysconf(_SC_PAGESIZE);
+  r.mapped_size = std::max<SizeType>(1, (r.size + r.page_size - 1) / r.page_size) * r.page_size;
+  r.page_resident.resize(r.mapped_size / r.page_size);
+  r.block_resident.resize(r.reader.num_blocks());
+  r.queue.resize(max_blocks);
+  r.scratch.resize(r.block_bytes);
+
+  r.fd = memfd_create("yang_compressed_array", MFD_CLOEXEC);
+  if (r.fd < 0 || ftruncate(r.fd, r.mapped_size) != 0) {
+    if (r.fd >= 0) close(r.fd);
+    throw MakeExcept<IoError>("Failed to create the view of {}", path);
+  }
+  auto view = mmap(nullptr, r.mapped_size, PROT_NONE, MAP_SHARED, r.fd, 0);
+  auto alias = mmap(nullptr, r.mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, r.fd, 0);
+  if (view == MAP_FAILED || alias == MAP_FAILED) {
+    if (view != MAP_FAILED) munmap(view, r.mapped_size);
+    if (alias != MAP_FAILED) munmap(alias, r.mapped_size);
+    close(r.fd);
+    throw MakeExcept<IoError>("Failed to map the view of {}", path);
+  }
+  r.view = reinterpret_cast<uint8_t *>(view);
+  r.alias = reinterpret_cast<uint8_t *>(alias);
+  r.dctx = ZSTD_createDCtx();
+
+  InstallHandler();
+  for (int slot = 0; slot < MAX_VIEWS; ++slot) {
+    Region *expected = nullptr;
+    if (g_views[slot].compare_exchange_strong(expected, &r)) {
+      r.slot = slot;
+      int num_slots = g_num_view_slots.load();
+      while (num_slots <= slot && !g_num_view_slots.compare_exchange_weak(num_slots, slot + 1)) {
+      }
+      break;
+    }
+  }
+  if (r.slot < 0) {
+    munmap(r.view, r.mapped_size);
+    munmap(r.alias, r.mapped_size);
+    close(r.fd);
+    ZSTD_freeDCtx(r.dctx);
+    throw MakeExcept<IoError>("Too many compressed array views, failed to map {}", path);
+  }
+  LOG_DEBUG("Mapped the view of {}: {} blocks, {} resident", path, r.reader.num_blocks(),
+            max_blocks);
+}
+
+CompressedArrayView::~CompressedArrayView() {
+  auto &r = *region_;
+  g_views[r.slot].store(nullptr);
+  while (g_active_handlers.load() > 0) std::this_thread::yield();
+  munmap(r.view, r.mapped_size);
+  munmap(r.alias, r.mapped_size);
+  close(r.fd);
+  ZSTD_freeDCtx(r.dctx);
+}
+
+uint8_t *CompressedArrayView::data() const {
+  return region_->view;
+}
+
+int CompressedArrayView::resident_blocks() const {
+  while (region_->lock.test_and_set(std::memory_order_acquire)) {
+  }
+  int count = region_->queue_count;
+  region_->lock.clear(std::memory_order_release);
+  return count;
+}
+
+int64_t CompressedArrayView::faults() const {
+  return region_->faults.load(std::memory_order_relaxed);
+}
+
+#else
+
+struct CompressedArrayView::Region {
+  CompressedArrayReader reader;
+};
+
+bool CompressedArrayView::Supported() {
+  return false;
+}
+
+CompressedArrayView::CompressedArrayView(const std::string &path, int max_blocks) {
+  throw MakeExcept<IoError>("Compressed array views are not supported, failed to map {}", path);
+}
+
+CompressedArrayView::~CompressedArrayView() {}
+
+uint8_t *CompressedArrayView::data() const {
+  return nullptr;
+}
+
+int CompressedArrayView::resident_blocks() const {
+  return 0;
+}
+
+int64_t CompressedArrayView::faults() const {
+  return 0;
+}
+
+#endif
+
+const CompressedArrayReader &CompressedArrayView::reader() const {
+  return region_->reader;
+}
+
+}  // namespace yang
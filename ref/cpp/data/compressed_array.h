@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "yang/data/array.h"
+#include "yang/util/mmap_file.h"
+#include "yang/util/task_pool.h"
+
+struct ZSTD_DCtx_s;
+
+namespace yang {
+
+// Reader of a read-only array stored as zstd compressed row blocks.
+//
+// File layout: the compressed blocks, followed by the block offsets (num_blocks + 1 uint64), the
+// number of blocks (uint64) and a magic number (uint64). Each block holds `block_rows` rows of the
+// first dimension.
+class CompressedArrayReader {
+ public:
+  static constexpr std::string_view COMPRESSION = "zstd";
+  static constexpr int DEFAULT_BLOCK_ROWS = 64;
+
+  explicit CompressedArrayReader(const std::string &path,
+                                 MMapAdvice advice = MMapAdvice::SEQUENTIAL);
+
+  const detail::ArrayMeta &meta() const {
+    return meta_;
+  }
+
+  SizeType rows() const {
+    return meta_.shape[0];
+  }
+
+  SizeType row_bytes() const {
+    return row_bytes_;
+  }
+
+  int num_blocks() const {
+    return num_blocks_;
+  }
+
+  SizeType GetBlockRows(int block) const;
+
+  // Decompress the whole array into dest, blocks are decompressed in parallel on pool
+  void ReadAll(void *dest, TaskPool *pool = nullptr) const;
+
+  // Decompress a block into dest with dctx, which does not allocate. Returns the zstd result
+  // instead of throwing, so that it can run in a signal handler.
+  size_t DecompressBlock(int block, void *dest, ZSTD_DCtx_s *dctx) const;
+
+  // Compress the array at path in place, blocks are compressed in parallel on pool. An interrupted
+  // compression of the array is finished instead.
+  static void Compress(const std::string &path, int block_rows = DEFAULT_BLOCK_ROWS,
+                       int level = 3, TaskPool *pool = nullptr);
+
+ private:
+  std::string path_;
+  detail::ArrayMeta meta_;
+  MMapFile file_;
+  SizeType row_bytes_ = 0;
+  int num_blocks_ = 0;
+  const uint64_t *offsets_ = nullptr;
+
+  void DecompressBlock(int block, void *dest) const;
+};
+
+// Read-only view of a compressed array at a fixed address, whose blocks are decompressed on first
+// access. The view is reserved without access rights, a SIGSEGV handler decompresses the block of
+// a faulting address into its pages and makes them readable. At most max_blocks blocks stay
+// resident, the oldest one is dropped when another block is faulted in.
+//
+// Only accesses from user space fault blocks in. System calls such as write() fail with EFAULT on
+// blocks that are not resident, so copy rows out before passing them to the kernel.
+class CompressedArrayView {
+ public:
+  static constexpr int DEFAULT_MAX_BLOCKS = 64;
+
+  // Whether views are supported on this platform, otherwise arrays are decompressed on load
+  static bool Supported();
+
+  explicit CompressedArrayView(const std::string &path, int max_blocks = DEFAULT_MAX_BLOCKS);
+
+  ~CompressedArrayView();
+
+  CompressedArrayView(const CompressedArrayView &) = delete;
+  CompressedArrayView &operator=(const CompressedArrayView &) = delete;
+
+  uint8_t *data() const;
+
+  const CompressedArrayReader &reader() const;
+
+  // Blocks currently decompressed
+  int resident_blocks() const;
+
+  // Blocks decompressed so far, including ones faulted in again after they were dropped
+  int64_t faults() const;
+
+  struct Region;
+
+ private:
+  std::unique_ptr<Region> region_;
+};
+
+}  // namespace yang
@@ -1,10 +1,102 @@
 #include "yang/data/data_cache.h"
 
+#include <limits>
+
 namespace yang {
 
+DataCache::DataCache(int max_size, int num_shards)
+    : max_size_(max_size), num_shards_(num_shards), shards_(new Shard[num_shards]) {
+  ENSURE(num_shards_ > 0, "Invalid DataCache num_shards: {}", num_shards_);
+}
+
+std::shared_ptr<DataCache::Entry> DataCache::Insert(Shard &shard, std::string_view name) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.entries.find(name);
+    if (it != shard.entries.end()) return it->second;
+    entry = std::make_shared<Entry>();
+    entry->last_access.store(clock_.fetch_add(1, std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+    shard.entries.emplace(name, entry);
+  }
+  // delete old entries
+  if (size_.fetch_add(1, std::memory_order_relaxed) + 1 > max_size_) {
+    EvictOldest(shard, entry.get());
+  }
+  return entry;
+}
+
+void DataCache::Erase(Shard &shard, std::string_view name, Entry &entry) {
+  std::unique_lock lock(shard.mutex);
+  entry.erased.store(true, std::memory_order_release);
+  auto it = shard.entries.find(name);
+  if (it != shard.entries.end() && it->second.get() == &entry) {
+    shard.entries.erase(it);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+void DataCache::EvictOldest(Shard &shard, const Entry *keep) {
+  // only other shards when the shard of the insert has nothing to evict, e.g. all loading
+  int shard_idx = &shard - shards_.get();
+  for (int i = 0; i < num_shards_ && size() > max_size_; ++i) {
+    auto &victim_shard = shards_[(shard_idx + i) % num_shards_];
+    std::unique_lock lock(victim_shard.mutex);
+    while (size() > max_size_) {
+      auto victim = victim_shard.entries.end();
+      uint64_t victim_access = std::numeric_limits<uint64_t>::max();
+      for (auto it = victim_shard.entries.begin(); it != victim_shard.entries.end(); ++it) {
+        auto &entry = it->second;
+        // entries being loaded are never evicted
+        if (entry.get() == keep || !entry->loaded.load(std::memory_order_acquire)) continue;
+        auto access = entry->last_access.load(std::memory_order_relaxed);
+        if (access < victim_access) {
+          victim = it;
+          victim_access = access;
+        }
+      }
+      if (victim == victim_shard.entries.end()) break;
+      victim_shard.entries.erase(victim);
+      size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void DataCache::EraseIf(const std::function<bool(std::string_view)> &pred) {
+  EraseEntriesIf([&pred](std::string_view name, const Entry &) { return pred(name); });
+}
+
+void DataCache::EraseShortArrays(SizeType rows) {
+  EraseEntriesIf([rows](std::string_view, const Entry &entry) {
+    auto entry_rows = entry.holder->rows();
+    return entry_rows >= 0 && entry_rows < rows;
+  });
+}
+
+void DataCache::EraseEntriesIf(const std::function<bool(std::string_view, const Entry &)> &pred) {
+  for (int i = 0; i < num_shards_; ++i) {
+    std::unique_lock lock(shards_[i].mutex);
+    auto &entries = shards_[i].entries;
+    for (auto it = entries.begin(); it != entries.end();) {
+      // entries being loaded are left to their loader
+      if (it->second->loaded.load(std::memory_order_acquire) && pred(it->first, *it->second)) {
+        it->second->erased.store(true, std::memory_order_release);
+        entries.erase(it++);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
 void DataCache::Clear() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  data_dict_.clear();
+  for (int i = 0; i < num_shards_; ++i) {
+    std::unique_lock lock(shards_[i].mutex);
+    size_.fetch_sub(shards_[i].entries.size(), std::memory_order_relaxed);
+    shards_[i].entries.clear();
+  }
 }
 
 }  // namespace yang
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <type_traits>
 
@@ -21,12 +23,19 @@ struct DataLoader<Array<T>> {
   }
 };
 
+// A sharded cache for immutable data.
+//
+// Hits only take a shared lock on one shard, so concurrent readers never block each other. LRU is
+// approximated with a logical clock which only advances on inserts: hits record the current clock
+// value, and eviction drops the entry with the oldest recorded value in the shard of the insert,
+// so an insert only scans one shard. Concurrent requests for the
+// same missing key are deduplicated, only one of them runs the loader while the others wait.
 class DataCache {
  public:
-  DataCache(int max_size = 1024) : max_size_(max_size) {}
+  DataCache(int max_size = 1024, int num_shards = 16);
 
   int size() const {
-    return data_list_.size();
+    return size_.load(std::memory_order_relaxed);
   }
 
   int max_size() const {
@@ -52,35 +61,51 @@ class DataCache {
 
   template <class T, class Func>
   const T *GetOrMake(std::string_view name, Func &&f) {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    auto *ptr = GetInternal<T>(name);
-    if (ptr == nullptr) {
-      auto holder = std::make_unique<DataHolderT<T>>(f());
-      ptr = holder->ptr;
-      data_list_.emplace_front(std::string(name), std::move(holder));
-      data_dict_.emplace(name, data_list_.begin());
-      // delete old entries
-      while (static_cast<int>(data_list_.size()) > max_size_) {
-        data_dict_.erase(data_list_.back().first);
-        data_list_.pop_back();
-      }
+    auto &shard = GetShard(name);
+    while (true) {
+      auto entry = shard.Find(name);
+      if (!entry) entry = Insert(shard, name);
+      Touch(*entry);
+
+      // concurrent callers block here until the first one finishes loading. A failed load erases
+      // the entry before the next caller gets here, which then retries with a new entry.
+      std::call_once(entry->once, [this, &shard, &name, &entry, &f]() {
+        if (entry->erased.load(std::memory_order_acquire)) return;
+        try {
+          entry->holder = std::make_unique<DataHolderT<T>>(f());
+        } catch (...) {
+          Erase(shard, name, *entry);
+          throw;
+        }
+        entry->loaded.store(true, std::memory_order_release);
+      });
+      if (!entry->erased.load(std::memory_order_acquire)) return entry->Get<T>(name);
     }
-    return ptr;
   }
 
   template <class T>
   const T *Get(std::string_view name) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return GetInternal<T>(name);
+    auto entry = GetShard(name).Find(name);
+    if (!entry || !entry->loaded.load(std::memory_order_acquire)) return nullptr;
+    Touch(*entry);
+    return entry->Get<T>(name);
   }
 
+  // Erase the entries whose name matches pred, e.g. data that has to be read again. Like eviction
+  // it must not race with readers still using the erased data.
+  void EraseIf(const std::function<bool(std::string_view)> &pred);
+
+  // Erase the arrays with fewer than rows rows, e.g. mapped before their files grew
+  void EraseShortArrays(SizeType rows);
+
   void Clear();
 
  private:
   struct DataHolder {
     virtual ~DataHolder() {}
     virtual std::string_view data_type() const = 0;
+    // the first dimension of arrays, -1 for other data
+    virtual SizeType rows() const = 0;
   };
 
   template <class T>
@@ -98,43 +123,72 @@ class DataCache {
       return GetTypeName<T>();
     }
 
+    SizeType rows() const override {
+      if constexpr (is_array_v<T>) {
+        return ptr->shape().empty() ? 0 : ptr->shape(0);
+      } else {
+        return -1;
+      }
+    }
+
     ~DataHolderT() {
       if (ptr) delete ptr;
     }
   };
 
-  using List = std::list<std::pair<std::string, std::unique_ptr<DataHolder>>>;
+  struct Entry {
+    std::once_flag once;
+    std::unique_ptr<DataHolder> holder;
+    std::atomic<bool> loaded{false};
+    std::atomic<bool> erased{false};
+    std::atomic<uint64_t> last_access{0};
 
-  int max_size_;
-  mutable unordered_map<std::string, List::iterator> data_dict_;
-  mutable List data_list_;
-  mutable std::mutex mutex_;
-
-  template <class T>
-  const T *GetInternal(std::string_view name) const {
-    auto it = data_dict_.find(name);
-    if (it != data_dict_.end()) {
-      auto &holder = it->second->second;
+    template <class T>
+    const T *Get(std::string_view name) const {
+      if (!loaded.load(std::memory_order_acquire)) return nullptr;
       ENSURE(holder->data_type() == GetTypeName<T>(),
              "Data type mismatched for {}, expected {}, got {}", name, GetTypeName<T>(),
              holder->data_type());
-      auto ptr = static_cast<DataHolderT<T> *>(holder.get())->ptr;
-
-      // move to front
-      auto &list_it = it->second;
-      if (list_it != data_list_.begin()) {
-        auto name_v = std::move(list_it->first);
-        auto holder_v = std::move(list_it->second);
-        data_list_.erase(list_it);
-        data_list_.emplace_front(std::string(name_v), std::move(holder_v));
-        list_it = data_list_.begin();
-      }
+      return static_cast<DataHolderT<T> *>(holder.get())->ptr;
+    }
+  };
 
-      return ptr;
-    } else {
-      return nullptr;
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    unordered_map<std::string, std::shared_ptr<Entry>> entries;
+
+    std::shared_ptr<Entry> Find(std::string_view name) const {
+      std::shared_lock lock(mutex);
+      auto it = entries.find(name);
+      return it == entries.end() ? nullptr : it->second;
+    }
+  };
+
+  int max_size_;
+  int num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<int> size_{0};
+  std::atomic<uint64_t> clock_{0};
+
+  Shard &GetShard(std::string_view name) const {
+    return shards_[std::hash<std::string_view>{}(name) % num_shards_];
+  }
+
+  void Touch(Entry &entry) const {
+    // plain loads and stores only, hits must not contend on a shared cache line
+    auto now = clock_.load(std::memory_order_relaxed);
+    if (entry.last_access.load(std::memory_order_relaxed) != now) {
+      entry.last_access.store(now, std::memory_order_relaxed);
     }
   }
+
+  std::shared_ptr<Entry> Insert(Shard &shard, std::string_view name);
+
+  void Erase(Shard &shard, std::string_view name, Entry &entry);
+
+  void EvictOldest(Shard &shard, const Entry *keep);
+
+  void EraseEntriesIf(const std::function<bool(std::string_view, const Entry &)> &pred);
 };
 
 }  // namespace yang
@@ -5,6 +5,8 @@
 #include <limits>
 #include <type_traits>
 
+#include "yang/base/float16.h"
+
 namespace yang {
 namespace detail {
 
@@ -14,6 +16,12 @@ struct NullValue {
     if constexpr (std::is_floating_point_v<T>) {
       return NAN;
     }
+    if constexpr (std::is_same_v<T, float16>) {
+      return float16::FromBits(0x7e00);
+    }
+    if constexpr (std::is_same_v<T, bfloat16>) {
+      return bfloat16::FromBits(0x7fc0);
+    }
     if constexpr (std::is_same_v<T, bool>) {
       return false;
     }
@@ -51,8 +59,11 @@ template <class T>
 constexpr bool IsNull(const T &v) {
   if constexpr (std::is_floating_point_v<T>) {
     return std::isnan(v);
+  } else if constexpr (is_reduced_float_v<T>) {
+    return std::isnan(static_cast<float>(v));
+  } else {
+    return v == GetNullValue<T>();
   }
-  return v == GetNullValue<T>();
 }
 
 }  // namespace yang
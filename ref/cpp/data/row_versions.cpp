@@ -0,0 +1,91 @@
+#include "yang/data/row_versions.h"
+
+#include <fstream>
+
+#include "yang/base/exception.h"
+#include "yang/util/fs.h"
+#include "yang/util/hash.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+
+RowVersions::RowVersions(const std::string &array_path) : path_(GetPath(array_path)) {
+  if (!fs::exists(path_)) return;
+
+  auto size = fs::file_size(path_);
+  if (size % sizeof(Entry) != 0) {
+    // rewritten from scratch on the next update
+    LOG_WARN("Row versions corrupted: {}", path_);
+    return;
+  }
+  entries_.resize(size / sizeof(Entry));
+  std::ifstream ifs(path_, std::ios::binary);
+  ifs.read(reinterpret_cast<char *>(entries_.data()), size);
+  if (!ifs.good()) {
+    LOG_WARN("Failed to read row versions: {}", path_);
+    entries_.clear();
+  }
+}
+
+SizeType RowVersions::Update(SizeType start_row, const std::vector<uint64_t> &checksums,
+                             uint64_t version) {
+  SizeType end_row = start_row + checksums.size();
+  if (static_cast<SizeType>(entries_.size()) < end_row) entries_.resize(end_row);
+  SizeType changed = 0;
+  for (SizeType row = start_row; row < end_row; ++row) {
+    auto checksum = checksums[row - start_row];
+    auto &entry = entries_[row];
+    if (entry.version == 0 || entry.checksum != checksum) {
+      entry.checksum = checksum;
+      entry.version = version;
+      ++changed;
+    }
+  }
+  return changed;
+}
+
+std::pair<SizeType, SizeType> RowVersions::GetChangedRange(uint64_t since_version) const {
+  SizeType n = entries_.size();
+  SizeType first = 0;
+  while (first < n && entries_[first].version != 0 && entries_[first].version <= since_version) {
+    ++first;
+  }
+  if (first == n) return {0, 0};
+  SizeType last = n;
+  while (entries_[last - 1].version != 0 && entries_[last - 1].version <= since_version) --last;
+  return {first, last};
+}
+
+uint64_t RowVersions::Fingerprint() const {
+  std::vector<uint64_t> checksums;
+  checksums.reserve(entries_.size());
+  for (auto &entry : entries_) checksums.push_back(entry.checksum);
+  return HashBytes(checksums.data(), checksums.size() * sizeof(uint64_t));
+}
+
+void RowVersions::Save() const {
+  auto tmp_path = path_ + ".tmp";
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char *>(entries_.data()), entries_.size() * sizeof(Entry));
+    if (!ofs.good()) throw MakeExcept<IoError>("Failed to write {}", tmp_path);
+  }
+  fs::rename(tmp_path, path_);
+}
+
+uint64_t RowVersions::Checksum(const void *data, SizeType size) {
+  return HashBytes(data, size);
+}
+
+std::vector<uint64_t> RowVersions::ChecksumRows(const void *data, SizeType row_bytes,
+                                                SizeType start_row, SizeType end_row) {
+  auto ptr = reinterpret_cast<const uint8_t *>(data);
+  std::vector<uint64_t> ret;
+  ret.reserve(end_row - start_row);
+  for (SizeType row = start_row; row < end_row; ++row) {
+    ret.push_back(Checksum(ptr + row * row_bytes, row_bytes));
+  }
+  return ret;
+}
+
+}  // namespace yang
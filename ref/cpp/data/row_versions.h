@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "yang/base/size.h"
+
+namespace yang {
+
+// Per-row version of an array, stored in the sidecar file `<array path>.rowver`.
+//
+// Each row keeps a checksum of its content and the version at which the content last changed, so
+// that readers can find out which rows changed since a given version and recompute only those.
+// Versions are usually timestamps, see Module::CommitWrites.
+class RowVersions {
+ public:
+  explicit RowVersions(const std::string &array_path);
+
+  SizeType rows() const {
+    return entries_.size();
+  }
+
+  // Version at which the row last changed, 0 if unknown
+  uint64_t version(SizeType row) const {
+    return row < rows() ? entries_[row].version : 0;
+  }
+
+  // Bump the version of the rows from start_row whose checksum changed, see ChecksumRows.
+  // Returns the number of changed rows.
+  SizeType Update(SizeType start_row, const std::vector<uint64_t> &checksums, uint64_t version);
+
+  // The smallest row range [first, last) that contains all rows changed after since_version, rows
+  // without a version are considered changed. Returns {0, 0} if nothing changed.
+  std::pair<SizeType, SizeType> GetChangedRange(uint64_t since_version) const;
+
+  // Hash of the row checksums, i.e. of the content of the array
+  uint64_t Fingerprint() const;
+
+  void Save() const;
+
+  static std::string GetPath(const std::string &array_path) {
+    return array_path + ".rowver";
+  }
+
+  static uint64_t Checksum(const void *data, SizeType size);
+
+  // Checksums of rows [start_row, end_row) of data
+  static std::vector<uint64_t> ChecksumRows(const void *data, SizeType row_bytes,
+                                            SizeType start_row, SizeType end_row);
+
+ private:
+  struct Entry {
+    uint64_t checksum = 0;
+    uint64_t version = 0;
+  };
+
+  std::string path_;
+  std::vector<Entry> entries_;
+};
+
+}  // namespace yang
@@ -4,49 +4,66 @@
 
 namespace yang::expr {
 
+namespace {
+
+// group scratch of the rows evaluated by the current thread
+ops::GroupAggregator<Float> &GroupScratch() {
+  thread_local ops::GroupAggregator<Float> agg;
+  return agg;
+}
+
+}  // namespace
+
 void GroupFunction::ApplyImpl(const FunctionArgs &args) const {
   ApplyMask(args.input(0), args.mask, args.output);
   ApplyGroup(args);
 }
 
 void GroupDemean::ApplyGroup(const FunctionArgs &args) const {
-  ops::group_demean<ops::DefaultCheck>(args.output.begin(), args.output.end(), args.group.begin());
+  ops::group_demean<ops::DefaultCheck>(args.output.begin(), args.output.end(), args.group.begin(),
+                                       args.output.begin(), GroupScratch());
 }
 
 void GroupRank::ApplyGroup(const FunctionArgs &args) const {
-  ops::group_rank(args.output.begin(), args.output.end(), args.group.begin());
+  ops::group_rank(args.output.begin(), args.output.end(), args.group.begin(), args.output.begin(),
+                  Float(ops::EPSILON), GroupScratch());
 }
 
 void GroupRankPow::ApplyGroup(const FunctionArgs &args) const {
   auto exp = args.scalar_args[0];
-  ops::group_rank_pow(args.output.begin(), args.output.end(), args.group.begin(), exp);
+  ops::group_rank_pow(args.output.begin(), args.output.end(), args.group.begin(),
+                      args.output.begin(), exp, Float(ops::EPSILON), GroupScratch());
 }
 
 void GroupZScore::ApplyGroup(const FunctionArgs &args) const {
   ops::group_zscore(args.output.begin(), args.output.end(), args.group.begin(),
-                    args.output.begin());
+                    args.output.begin(), GroupScratch());
 }
 
 void GroupTruncate::ApplyGroup(const FunctionArgs &args) const {
   auto cap = args.scalar_args[0];
-  ops::group_truncate(args.output.begin(), args.output.end(), args.group.begin(), cap);
+  ops::group_truncate(args.output.begin(), args.output.end(), args.group.begin(),
+                      args.output.begin(), cap, GroupScratch());
 }
 
 void GroupTruncateUpper::ApplyGroup(const FunctionArgs &args) const {
   auto cap = args.scalar_args[0];
-  ops::group_truncate_upper(args.output.begin(), args.output.end(), args.group.begin(), cap);
+  ops::group_truncate_upper(args.output.begin(), args.output.end(), args.group.begin(),
+                            args.output.begin(), cap, GroupScratch());
 }
 
 void GroupSigwin::ApplyGroup(const FunctionArgs &args) const {
   auto cap1 = args.scalar_args[0];
   auto cap2 = args.scalar_args[1];
-  ops::group_sigwin(args.output.begin(), args.output.end(), args.group.begin(), cap1, cap2);
+  ops::group_sigwin(args.output.begin(), args.output.end(), args.group.begin(),
+                    args.output.begin(), cap1, cap2, GroupScratch());
 }
 
 void GroupSigwinUpper::ApplyGroup(const FunctionArgs &args) const {
   auto cap1 = args.scalar_args[0];
   auto cap2 = args.scalar_args[1];
-  ops::group_sigwin_upper(args.output.begin(), args.output.end(), args.group.begin(), cap1, cap2);
+  ops::group_sigwin_upper(args.output.begin(), args.output.end(), args.group.begin(),
+                          args.output.begin(), cap1, cap2, GroupScratch());
 }
 
 }  // namespace yang::expr
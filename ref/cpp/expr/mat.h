@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cmath>
+#include <limits>
+#include <type_traits>
 #include <variant>
+#include <vector>
 
+#include "yang/base/float16.h"
 #include "yang/math/mat_view.h"
 #include "yang/math/vec_view.h"
 
@@ -12,10 +17,30 @@ class FloatMat {
   FloatMat(yang::math::MatView<const float> m) : data_(m) {}
   FloatMat(yang::math::MatView<const double> m) : data_(m) {}
   FloatMat(yang::math::MatView<const int32_t> m) : data_(m) {}
+  FloatMat(yang::math::MatView<const float16> m) : data_(m) {}
+  FloatMat(yang::math::MatView<const bfloat16> m) : data_(m) {}
+  // fixed point values, i.e. value = item * scale
+  FloatMat(yang::math::MatView<const int16_t> m, float scale) : data_(m), scale_(scale) {}
 
   template <class T>
   void LoadRow(yang::math::VecView<T> vec, int row) const {
-    std::visit([&](auto &&m) { vec.copy_from(m.row(row).to_vec()); }, data_);
+    std::visit(
+        [&](auto &&m) {
+          using Item = std::remove_const_t<typename std::decay_t<decltype(m)>::value_type>;
+          if constexpr (is_reduced_float_v<Item> || std::is_same_v<Item, int16_t>) {
+            LoadWidenedRow(vec, m.row(row).to_vec());
+          } else {
+            vec.copy_from(m.row(row).to_vec());
+          }
+        },
+        data_);
+  }
+
+  FloatMat slice(int row_begin, int row_end, int col_begin, int col_end) const {
+    auto ret = *this;
+    std::visit([&](auto &&m) { ret.data_ = m.slice(row_begin, row_end, col_begin, col_end); },
+               data_);
+    return ret;
   }
 
   int rows() const {
@@ -30,6 +55,10 @@ class FloatMat {
     return data_.index();
   }
 
+  float scale() const {
+    return scale_;
+  }
+
   template <class T>
   auto raw() const {
     return std::get<yang::math::MatView<const T>>(data_);
@@ -37,8 +66,47 @@ class FloatMat {
 
  private:
   std::variant<yang::math::MatView<const float>, yang::math::MatView<const double>,
-               yang::math::MatView<const int32_t>>
+               yang::math::MatView<const int32_t>, yang::math::MatView<const float16>,
+               yang::math::MatView<const bfloat16>, yang::math::MatView<const int16_t>>
       data_;
+  float scale_ = 0;
+
+  template <class T, class Src>
+  void LoadWidenedRow(yang::math::VecView<T> vec, Src src) const {
+    SizeType n = src.size();
+    ENSURE(vec.size() == n, "copy_from size mismatch, expected: {}, got: {}", vec.size(), n);
+    if (src.stride() != 1) {
+      for (SizeType i = 0; i < n; ++i) vec[i] = WidenItem(src[i]);
+      return;
+    }
+
+    auto widen = [&](float *dest) {
+      if constexpr (std::is_same_v<typename Src::value_type, const int16_t>) {
+        WidenToFloat(src.data(), dest, n, scale_);
+      } else {
+        WidenToFloat(src.data(), dest, n);
+      }
+    };
+    if constexpr (std::is_same_v<T, float>) {
+      if (vec.stride() == 1) {
+        widen(vec.data());
+        return;
+      }
+    }
+    thread_local std::vector<float> buf;
+    buf.resize(n);
+    widen(buf.data());
+    for (SizeType i = 0; i < n; ++i) vec[i] = buf[i];
+  }
+
+  float WidenItem(int16_t item) const {
+    return item == std::numeric_limits<int16_t>::min() ? NAN : item * scale_;
+  }
+
+  template <class Item>
+  float WidenItem(Item item) const {
+    return item;
+  }
 };
 
 class OutFloatMat {
@@ -149,6 +149,20 @@ template <class ValidCheck = DefaultCheck, class Mat, std::enable_if_t<is_mat_vi
 void demean(const Mat &mat) {
   demean<ValidCheck>(mat, mat);
 }
+// Momentum by group, by rows, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat, class T,
+          class Allocator, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
+          std::enable_if_t<is_mat_view_v<GMat>, int> = 0,
+          std::enable_if_t<is_mat_view_v<OutMat>, int> = 0>
+void group_mom(const Mat &mat, const GMat &g_mat, const OutMat &out_mat,
+               GroupAggregator<T, Allocator> &agg) {
+  detail::iterate_rows(
+      [&](auto first, auto last, auto g_first, auto out) {
+        group_mom<ValidCheck>(first, last, g_first, out, agg);
+      },
+      mat, g_mat, out_mat);
+}
+
 // Momentum by group, by rows
 template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat,
           class Allocator = std::allocator<int>, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
@@ -156,9 +170,8 @@ template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat,
           std::enable_if_t<is_mat_view_v<OutMat>, int> = 0>
 void group_mom(const Mat &mat, const GMat &g_mat, const OutMat &out_mat,
                const Allocator &alloc = Allocator()) {
-  detail::iterate_rows([&](auto first, auto last, auto g_first,
-                           auto out) { group_mom<ValidCheck>(first, last, g_first, out, alloc); },
-                       mat, g_mat, out_mat);
+  GroupAggregator<std::remove_cv_t<typename OutMat::value_type>, Allocator> agg(alloc);
+  group_mom<ValidCheck>(mat, g_mat, out_mat, agg);
 }
 
 // Demean by rows, in place version
@@ -170,20 +183,31 @@ void group_mom(const Mat &mat, const GMat &g_mat, const Allocator &alloc = Alloc
   group_mom<ValidCheck>(mat, g_mat, mat, alloc);
 }
 
-// Demean by group, by rows
-template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat,
-          class Allocator = std::allocator<int>, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
+// Demean by group, by rows, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat, class T,
+          class Allocator, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
           std::enable_if_t<is_mat_view_v<GMat>, int> = 0,
           std::enable_if_t<is_mat_view_v<OutMat>, int> = 0>
 void group_demean(const Mat &mat, const GMat &g_mat, const OutMat &out_mat,
-                  const Allocator &alloc = Allocator()) {
+                  GroupAggregator<T, Allocator> &agg) {
   detail::iterate_rows(
       [&](auto first, auto last, auto g_first, auto out) {
-        group_demean<ValidCheck>(first, last, g_first, out, alloc);
+        group_demean<ValidCheck>(first, last, g_first, out, agg);
       },
       mat, g_mat, out_mat);
 }
 
+// Demean by group, by rows
+template <class ValidCheck = DefaultCheck, class Mat, class GMat, class OutMat,
+          class Allocator = std::allocator<int>, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
+          std::enable_if_t<is_mat_view_v<GMat>, int> = 0,
+          std::enable_if_t<is_mat_view_v<OutMat>, int> = 0>
+void group_demean(const Mat &mat, const GMat &g_mat, const OutMat &out_mat,
+                  const Allocator &alloc = Allocator()) {
+  GroupAggregator<std::remove_cv_t<typename OutMat::value_type>, Allocator> agg(alloc);
+  group_demean<ValidCheck>(mat, g_mat, out_mat, agg);
+}
+
 // Demean by rows, in place version
 template <class ValidCheck = DefaultCheck, class Mat, class GMat,
           class Allocator = std::allocator<int>, std::enable_if_t<is_mat_view_v<Mat>, int> = 0,
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
@@ -10,92 +12,197 @@
 
 namespace yang::math::ops {
 
+// Dense per group sums, weights and counts over the non-negative group ids of a vector, e.g.
+// industries. Reset keeps the buffers, so one aggregator serves every row of a matrix or every
+// day of an operation without allocating.
+template <class T, class Allocator = std::allocator<int>>
+class GroupAggregator {
+  using TAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+ public:
+  explicit GroupAggregator(const Allocator &alloc = Allocator())
+      : sums_(TAllocator(alloc)), weights_(TAllocator(alloc)), counts_(alloc), offsets_(alloc),
+        members_(alloc), values_(TAllocator(alloc)) {}
+
+  // Clears num_groups groups
+  void Reset(int num_groups) {
+    num_groups_ = std::max(num_groups, 0);
+    sums_.assign(num_groups_, 0);
+    weights_.assign(num_groups_, 0);
+    counts_.assign(num_groups_, 0);
+  }
+
+  // Clears the groups of the ids in [g_first, g_first + n), returns their number, i.e. one more
+  // than the largest id
+  template <class GIter>
+  int Reset(GIter g_first, int n) {
+    int g_max = -1;
+    for (int i = 0; i < n; ++i) {
+      int g = *(g_first + i);
+      if (g > g_max) g_max = g;
+    }
+    Reset(g_max + 1);
+    return num_groups_;
+  }
+
+  int num_groups() const {
+    return num_groups_;
+  }
+
+  void Add(int g, T v) {
+    sums_[g] += v;
+    weights_[g] += 1;
+    ++counts_[g];
+  }
+
+  void Add(int g, T v, T w) {
+    sums_[g] += v * w;
+    weights_[g] += w;
+    ++counts_[g];
+  }
+
+  T sum(int g) const {
+    return sums_[g];
+  }
+
+  T weight(int g) const {
+    return weights_[g];
+  }
+
+  int count(int g) const {
+    return counts_[g];
+  }
+
+  // Weighted mean, sum / weight
+  T mean(int g) const {
+    return sums_[g] / weights_[g];
+  }
+
+  // Lists the indices i in [0, n) with is_member(i) by their group *(g_first + i), which must be
+  // in [0, num_groups()). Sets the counts of the groups.
+  template <class GIter, class Pred>
+  void Partition(GIter g_first, int n, Pred &&is_member) {
+    offsets_.assign(num_groups_ + 1, 0);
+    for (int i = 0; i < n; ++i) {
+      if (is_member(i)) ++offsets_[*(g_first + i) + 1];
+    }
+    for (int g = 0; g < num_groups_; ++g) offsets_[g + 1] += offsets_[g];
+    members_.resize(offsets_[num_groups_]);
+    std::fill(counts_.begin(), counts_.end(), 0);
+    for (int i = 0; i < n; ++i) {
+      if (is_member(i)) {
+        int g = *(g_first + i);
+        members_[offsets_[g] + counts_[g]++] = i;
+      }
+    }
+  }
+
+  // Indices of the members of group g in increasing order, after Partition
+  const int *members_begin(int g) const {
+    return members_.data() + offsets_[g];
+  }
+
+  const int *members_end(int g) const {
+    return members_.data() + offsets_[g + 1];
+  }
+
+  // Scratch for the values of one group
+  std::vector<T, TAllocator> &values() {
+    return values_;
+  }
+
+  Allocator get_allocator() const {
+    return counts_.get_allocator();
+  }
+
+ private:
+  int num_groups_ = 0;
+  std::vector<T, TAllocator> sums_;
+  std::vector<T, TAllocator> weights_;
+  std::vector<int, Allocator> counts_;
+  std::vector<int, Allocator> offsets_;
+  std::vector<int, Allocator> members_;
+  std::vector<T, TAllocator> values_;
+};
+
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class Func,
-          class Allocator = std::allocator<int>,
-          std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          class T, class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
           std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 ALWAYS_INLINE void simple_group(Iter first, Iter last, GIter g_first, OutIter out, Func &&f,
-                                const Allocator &alloc = Allocator()) {
+                                GroupAggregator<T, Allocator> &agg) {
   int n = last - first;
-  int g_max = -1;
-  for (int i = 0; i < n; ++i) {
-    auto g = *(g_first + i);
-    if (g > g_max) g_max = g;
-  }
-  ++g_max;
-  if (g_max <= 0) return;
+  if (agg.Reset(g_first, n) <= 0) return;
 
-  using T = iter_value_t<OutIter>;
-  using PAllocator =
-      typename std::allocator_traits<Allocator>::template rebind_alloc<std::vector<int, Allocator>>;
   ValidCheck is_valid;
-  std::vector<std::vector<int, Allocator>, PAllocator> group_members(g_max + 1);
+  auto is_member = [&](int i) { return *(g_first + i) >= 0 && is_valid(*(first + i)); };
+  agg.Partition(g_first, n, is_member);
   for (int i = 0; i < n; ++i) {
-    auto g = *(g_first + i);
-    auto v = *(first + i);
-    if (g >= 0 && is_valid(v)) {
-      group_members[g].push_back(i);
-    } else {
-      *(out + i) = detail::default_value<T>();
-    }
+    if (!is_member(i)) *(out + i) = detail::default_value<T>();
   }
-  std::vector<T, typename std::allocator_traits<Allocator>::template rebind_alloc<T>> values;
-  for (auto &group : group_members) {
-    values.reserve(group.size());
-    for (auto &i : group) values.push_back(*(first + i));
+  auto &values = agg.values();
+  for (int g = 0; g < agg.num_groups(); ++g) {
+    auto members_first = agg.members_begin(g);
+    auto members_last = agg.members_end(g);
+    values.clear();
+    for (auto it = members_first; it != members_last; ++it) values.push_back(*(first + *it));
     f(values);
-    for (int i = 0; i < static_cast<int>(group.size()); ++i) {
-      *(out + group[i]) = values[i];
+    for (int k = 0; k < members_last - members_first; ++k) {
+      *(out + members_first[k]) = values[k];
     }
-    values.clear();
   }
 }
 
-// Momentum by group
-template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class Func,
           class Allocator = std::allocator<int>,
           std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
           std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+ALWAYS_INLINE void simple_group(Iter first, Iter last, GIter g_first, OutIter out, Func &&f,
+                                const Allocator &alloc = Allocator()) {
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  simple_group<ValidCheck>(first, last, g_first, out, std::forward<Func>(f), agg);
+}
+
+// Momentum by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_mom(Iter first, Iter last, GIter g_first, OutIter out,
-               const Allocator &alloc = Allocator()) {
+               GroupAggregator<T, Allocator> &agg) {
   int n = last - first;
-  int g_max = -1;
-  for (int i = 0; i < n; ++i) {
-    auto g = *(g_first + i);
-    if (g > g_max) g_max = g;
-  }
-  ++g_max;
-  if (g_max <= 0) return;
+  if (agg.Reset(g_first, n) <= 0) return;
 
-  using Value = iter_value_t<OutIter>;
-  using PAllocator =
-      typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Value, int>>;
-  std::vector<std::pair<Value, int>, PAllocator> g_mean(g_max, {0, 0}, PAllocator(alloc));
   ValidCheck is_valid;
   for (int i = 0; i < n; ++i) {
     auto g = *(g_first + i);
     auto v = *(first + i);
-    if (g >= 0 && is_valid(v)) {
-      g_mean[g].first += v;
-      ++g_mean[g].second;
-    }
-  }
-  for (auto &[sum, count] : g_mean) {
-    if (count > 0) sum /= count;
+    if (g >= 0 && is_valid(v)) agg.Add(g, v);
   }
   for (int i = 0; i < n; ++i) {
     auto g = *(g_first + i);
     auto v = *(first + i);
     if (g >= 0 && is_valid(v)) {
-      *(out + i) = g_mean[g].first;
+      *(out + i) = agg.mean(g);
     } else {
-      *(out + i) = detail::default_value<Value>();
+      *(out + i) = detail::default_value<iter_value_t<OutIter>>();
     }
   }
 }
 
+// Momentum by group
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
+          class Allocator = std::allocator<int>,
+          std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_mom(Iter first, Iter last, GIter g_first, OutIter out,
+               const Allocator &alloc = Allocator()) {
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_mom<ValidCheck>(first, last, g_first, out, agg);
+}
+
 // Momentum by group, in-place version
 template <class ValidCheck = DefaultCheck, class Iter, class GIter,
           class Allocator = std::allocator<int>,
@@ -106,51 +213,45 @@ void group_mom(Iter first, Iter last, GIter g_first, const Allocator &alloc = Al
   group_mom<ValidCheck>(first, last, g_first, first, alloc);
 }
 
-// Demean by group
-template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
-          class Allocator = std::allocator<int>,
-          std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+// Demean by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
           std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_demean(Iter first, Iter last, GIter g_first, OutIter out,
-                  const Allocator &alloc = Allocator()) {
+                  GroupAggregator<T, Allocator> &agg) {
   int n = last - first;
-  int g_max = -1;
-  for (int i = 0; i < n; ++i) {
-    auto g = *(g_first + i);
-    if (g > g_max) g_max = g;
-  }
-  ++g_max;
-  if (g_max <= 0) return;
+  if (agg.Reset(g_first, n) <= 0) return;
 
-  using Value = iter_value_t<OutIter>;
-  using PAllocator =
-      typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Value, int>>;
-  std::vector<std::pair<Value, int>, PAllocator> g_mean(g_max, {0, 0}, PAllocator(alloc));
   ValidCheck is_valid;
   for (int i = 0; i < n; ++i) {
     auto g = *(g_first + i);
     auto v = *(first + i);
-    if (g >= 0 && is_valid(v)) {
-      g_mean[g].first += v;
-      ++g_mean[g].second;
-    }
-  }
-  for (auto &[sum, count] : g_mean) {
-    if (count > 0) sum /= count;
+    if (g >= 0 && is_valid(v)) agg.Add(g, v);
   }
   for (int i = 0; i < n; ++i) {
     auto g = *(g_first + i);
     auto v = *(first + i);
     if (g >= 0 && is_valid(v)) {
-      v -= g_mean[g].first;
-      *(out + i) = v;
+      *(out + i) = v - agg.mean(g);
     } else {
-      *(out + i) = detail::default_value<Value>();
+      *(out + i) = detail::default_value<iter_value_t<OutIter>>();
     }
   }
 }
 
+// Demean by group
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
+          class Allocator = std::allocator<int>,
+          std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_demean(Iter first, Iter last, GIter g_first, OutIter out,
+                  const Allocator &alloc = Allocator()) {
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_demean<ValidCheck>(first, last, g_first, out, agg);
+}
+
 // Demean by group, in-place version
 template <class ValidCheck = DefaultCheck, class Iter, class GIter,
           class Allocator = std::allocator<int>,
@@ -161,6 +262,18 @@ void group_demean(Iter first, Iter last, GIter g_first, const Allocator &alloc =
   group_demean<ValidCheck>(first, last, g_first, first, alloc);
 }
 
+// Rank by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_rank(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> eps,
+                GroupAggregator<T, Allocator> &agg) {
+  auto alloc = agg.get_allocator();
+  simple_group<ValidCheck>(
+      first, last, g_first, out, [&](auto &g) { rank(g.begin(), g.end(), eps, alloc); }, agg);
+}
+
 // Rank by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -169,8 +282,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_rank(Iter first, Iter last, GIter g_first, OutIter out,
                 iter_value_t<OutIter> eps = EPSILON, const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out, [&](auto &g) { rank(g.begin(), g.end(), eps, alloc); }, alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_rank<ValidCheck>(first, last, g_first, out, eps, agg);
 }
 
 // Rank by group, in-place version
@@ -184,6 +297,19 @@ void group_rank(Iter first, Iter last, GIter g_first, iter_value_t<Iter> eps = E
   group_rank<ValidCheck>(first, last, g_first, first, eps, alloc);
 }
 
+// rank_pow by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_rank_pow(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> exp,
+                    iter_value_t<OutIter> eps, GroupAggregator<T, Allocator> &agg) {
+  auto alloc = agg.get_allocator();
+  simple_group<ValidCheck>(
+      first, last, g_first, out,
+      [&](auto &g) { rank_pow(g.begin(), g.end(), exp, eps, alloc); }, agg);
+}
+
 // rank_pow by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -192,9 +318,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_rank_pow(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> exp,
                     iter_value_t<OutIter> eps = EPSILON, const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out, [&](auto &g) { rank_pow(g.begin(), g.end(), exp, eps, alloc); },
-      alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_rank_pow<ValidCheck>(first, last, g_first, out, exp, eps, agg);
 }
 
 // rank_pow by group, in-place version
@@ -208,6 +333,17 @@ void group_rank_pow(Iter first, Iter last, GIter g_first, iter_value_t<Iter> exp
   group_rank_pow<ValidCheck>(first, last, g_first, first, exp, eps, alloc);
 }
 
+// zscore by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_zscore(Iter first, Iter last, GIter g_first, OutIter out,
+                  GroupAggregator<T, Allocator> &agg) {
+  simple_group<ValidCheck>(
+      first, last, g_first, out, [&](auto &g) { zscore<ValidCheck>(g.begin(), g.end()); }, agg);
+}
+
 // zscore by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -216,8 +352,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_zscore(Iter first, Iter last, GIter g_first, OutIter out,
                   const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out, [&](auto &g) { zscore<ValidCheck>(g.begin(), g.end()); }, alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_zscore<ValidCheck>(first, last, g_first, out, agg);
 }
 
 // zscore by group, in-place version
@@ -230,6 +366,18 @@ void group_zscore(Iter first, Iter last, GIter g_first, const Allocator &alloc =
   group_zscore<ValidCheck>(first, last, g_first, first, alloc);
 }
 
+// truncate by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_truncate(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> cap,
+                    GroupAggregator<T, Allocator> &agg) {
+  simple_group<ValidCheck>(
+      first, last, g_first, out,
+      [&](auto &g) { truncate<ValidCheck>(g.begin(), g.end(), cap); }, agg);
+}
+
 // truncate by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -238,9 +386,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_truncate(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> cap,
                     const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out, [&](auto &g) { truncate<ValidCheck>(g.begin(), g.end(), cap); },
-      alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_truncate<ValidCheck>(first, last, g_first, out, cap, agg);
 }
 
 // truncate by group, in-place version
@@ -254,6 +401,18 @@ void group_truncate(Iter first, Iter last, GIter g_first, iter_value_t<Iter> cap
   group_truncate<ValidCheck>(first, last, g_first, first, cap, alloc);
 }
 
+// truncate_upper by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_truncate_upper(Iter first, Iter last, GIter g_first, OutIter out,
+                          iter_value_t<OutIter> cap, GroupAggregator<T, Allocator> &agg) {
+  simple_group<ValidCheck>(
+      first, last, g_first, out,
+      [&](auto &g) { truncate_upper<ValidCheck>(g.begin(), g.end(), cap); }, agg);
+}
+
 // truncate_upper by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -262,9 +421,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_truncate_upper(Iter first, Iter last, GIter g_first, OutIter out,
                           iter_value_t<OutIter> cap, const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out,
-      [&](auto &g) { truncate_upper<ValidCheck>(g.begin(), g.end(), cap); }, alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_truncate_upper<ValidCheck>(first, last, g_first, out, cap, agg);
 }
 
 // truncate_upper by group, in-place version
@@ -278,6 +436,18 @@ void group_truncate_upper(Iter first, Iter last, GIter g_first, iter_value_t<Ite
   group_truncate_upper<ValidCheck>(first, last, g_first, first, cap, alloc);
 }
 
+// sigwin by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_sigwin(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> cap1,
+                  iter_value_t<OutIter> cap2, GroupAggregator<T, Allocator> &agg) {
+  simple_group<ValidCheck>(
+      first, last, g_first, out,
+      [&](auto &g) { sigwin<ValidCheck>(g.begin(), g.end(), cap1, cap2); }, agg);
+}
+
 // sigwin by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -286,9 +456,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
           std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
 void group_sigwin(Iter first, Iter last, GIter g_first, OutIter out, iter_value_t<OutIter> cap1,
                   iter_value_t<OutIter> cap2, const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out,
-      [&](auto &g) { sigwin<ValidCheck>(g.begin(), g.end(), cap1, cap2); }, alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_sigwin<ValidCheck>(first, last, g_first, out, cap1, cap2, agg);
 }
 
 // sigwin by group, in-place version
@@ -302,6 +471,19 @@ void group_sigwin(Iter first, Iter last, GIter g_first, iter_value_t<Iter> cap1,
   group_sigwin<ValidCheck>(first, last, g_first, first, cap1, cap2, alloc);
 }
 
+// sigwin_upper by group, with the scratch of agg
+template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter, class T,
+          class Allocator, std::enable_if_t<is_random_access_iterator_v<Iter>, int> = 0,
+          std::enable_if_t<is_valid_check_v<ValidCheck>, int> = 0,
+          std::enable_if_t<std::is_integral_v<iter_value_t<GIter>>, int> = 0>
+void group_sigwin_upper(Iter first, Iter last, GIter g_first, OutIter out,
+                        iter_value_t<OutIter> cap1, iter_value_t<OutIter> cap2,
+                        GroupAggregator<T, Allocator> &agg) {
+  simple_group<ValidCheck>(
+      first, last, g_first, out,
+      [&](auto &g) { sigwin_upper<ValidCheck>(g.begin(), g.end(), cap1, cap2); }, agg);
+}
+
 // sigwin_upper by group
 template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIter,
           class Allocator = std::allocator<int>,
@@ -311,9 +493,8 @@ template <class ValidCheck = DefaultCheck, class Iter, class GIter, class OutIte
 void group_sigwin_upper(Iter first, Iter last, GIter g_first, OutIter out,
                         iter_value_t<OutIter> cap1, iter_value_t<OutIter> cap2,
                         const Allocator &alloc = Allocator()) {
-  simple_group<ValidCheck>(
-      first, last, g_first, out,
-      [&](auto &g) { sigwin_upper<ValidCheck>(g.begin(), g.end(), cap1, cap2); }, alloc);
+  GroupAggregator<iter_value_t<OutIter>, Allocator> agg(alloc);
+  group_sigwin_upper<ValidCheck>(first, last, g_first, out, cap1, cap2, agg);
 }
 
 // sigwin_upper by group, in-place version
@@ -4,7 +4,9 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "yang/sim/runner.h"
+#include "yang/util/control_socket.h"
 #include "yang/util/logging.h"
+#include "yang/util/strings.h"
 #include "yang/util/term_handler.h"
 
 ABSL_FLAG(std::string, config, "", "Config file path");
@@ -14,6 +16,9 @@ ABSL_FLAG(std::string, stage, "all", "Stage to run: all,prepare,intraday");
 ABSL_FLAG(int, num_threads, 1, "Number of worker threads");
 ABSL_FLAG(bool, live, false, "Enable live mode");
 ABSL_FLAG(bool, prod, false, "Enable production mode");
+ABSL_FLAG(std::string, trace_file, "", "Output Chrome trace JSON of the run");
+ABSL_FLAG(std::string, daemon_socket, "",
+          "Stay resident and run stages on commands from this Unix socket");
 
 int main(int argc, char **argv) {
   using namespace yang;
@@ -44,7 +49,41 @@ int main(int argc, char **argv) {
   }
   options.live = absl::GetFlag(FLAGS_live);
   options.prod = absl::GetFlag(FLAGS_prod);
+  options.trace_file = absl::GetFlag(FLAGS_trace_file);
   Runner runner;
-  runner.Run(options, config, absl::GetFlag(FLAGS_num_threads));
+  auto daemon_socket = absl::GetFlag(FLAGS_daemon_socket);
+  if (daemon_socket.empty()) {
+    runner.Run(options, config, absl::GetFlag(FLAGS_num_threads));
+    return 0;
+  }
+
+  // the first run builds or loads the env, later ones reuse it with the new datetimes
+  runner.Initialize(options, config, absl::GetFlag(FLAGS_num_threads));
+  runner.RunStages(options.stages);
+  ControlSocket control(daemon_socket);
+  control.Serve([&](std::string_view command) -> std::string {
+    std::vector<std::string_view> args = StrSplit(command, ' ');
+    if (args.empty() || args[0].empty()) return "error: empty command";
+    if (args[0] == "ping") return "ok";
+    if (args[0] == "stop") {
+      control.Stop();
+      return "ok";
+    }
+    if (args[0] != "run") return fmt::format("error: unknown command {}", args[0]);
+
+    // run [stage ...], only the intraday stage by default
+    std::set<RunStage> stages;
+    for (size_t i = 1; i < args.size(); ++i) {
+      auto stage_val = ParseRunStage(args[i]);
+      if (stage_val == RunStage::ERROR || stage_val == RunStage::PREPARE) {
+        return fmt::format("error: invalid stage {}", args[i]);
+      }
+      stages.insert(stage_val);
+    }
+    if (stages.empty()) stages.insert(RunStage::INTRADAY);
+    runner.RunStages(stages);
+    return "ok";
+  });
+  runner.Shutdown();
   return 0;
 }
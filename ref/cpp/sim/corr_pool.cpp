@@ -0,0 +1,232 @@
+#include "yang/sim/corr_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "yang/util/logging.h"
+
+namespace yang {
+
+namespace {
+
+// Pairwise sums of a set of series, where sx(i, j) sums series i over the values valid in j
+struct CorrSums {
+  Eigen::MatrixXd n;
+  Eigen::MatrixXd sx;
+  Eigen::MatrixXd sxx;
+  Eigen::MatrixXd sxy;
+
+  explicit CorrSums(int count)
+      : n(Eigen::MatrixXd::Zero(count, count)),
+        sx(Eigen::MatrixXd::Zero(count, count)),
+        sxx(Eigen::MatrixXd::Zero(count, count)),
+        sxy(Eigen::MatrixXd::Zero(count, count)) {}
+
+  template <class Z, class Mask>
+  void Add(const Z &z, const Mask &mask) {
+    n.noalias() += mask.transpose() * mask;
+    sx.noalias() += z.transpose() * mask;
+    sxx.noalias() += z.cwiseAbs2().transpose() * mask;
+    sxy.noalias() += z.transpose() * z;
+  }
+
+  CorrSums &operator+=(const CorrSums &other) {
+    n += other.n;
+    sx += other.sx;
+    sxx += other.sxx;
+    sxy += other.sxy;
+    return *this;
+  }
+};
+
+}  // namespace
+
+CorrPool::CorrPool(int size, int min_count)
+    : size_(size), min_count_(min_count), z_(size, 0), mask_(size, 0), z2_(size, 0) {
+  ENSURE(size > 0, "Invalid size {}", size);
+}
+
+double CorrPool::CorrFromSums(double n, double sx, double sy, double sxx, double syy, double sxy,
+                              int min_count) {
+  if (n < std::max(min_count, 1)) return NAN;
+  double var_x = n * sxx - sx * sx;
+  double var_y = n * syy - sy * sy;
+  if (var_x <= 0 || var_y <= 0) return NAN;
+  return (n * sxy - sx * sy) / std::sqrt(var_x * var_y);
+}
+
+bool CorrPool::Load(math::VecView<const double> x, Eigen::Ref<Eigen::VectorXd> z,
+                    Eigen::Ref<Eigen::VectorXd> mask, Eigen::Ref<Eigen::VectorXd> z2) const {
+  ENSURE(x.size() == size_, "Series of {} days for a pool of {} days", x.size(), size_);
+  double sum = 0;
+  int n = 0;
+  for (int di = 0; di < size_; ++di) {
+    if (std::isfinite(x[di])) {
+      sum += x[di];
+      ++n;
+    }
+  }
+  // centering keeps the sums of squares from cancelling when the means are large
+  double mean = n > 0 ? sum / n : 0;
+  for (int di = 0; di < size_; ++di) {
+    bool valid = std::isfinite(x[di]);
+    z[di] = valid ? x[di] - mean : 0;
+    mask[di] = valid;
+    z2[di] = z[di] * z[di];
+  }
+  return n < size_;
+}
+
+std::vector<double> CorrPool::Corr(math::VecView<const double> x) const {
+  Eigen::MatrixXd y(size_, 3);
+  Load(x, y.col(1), y.col(0), y.col(2));
+  auto z = z_.leftCols(count_);
+  auto mask = mask_.leftCols(count_);
+  // columns of sums over the common valid days: x and xy; n, y and y^2; x^2
+  Eigen::MatrixXd zy = z.transpose() * y.leftCols(2);
+  Eigen::MatrixXd my = mask.transpose() * y;
+  Eigen::VectorXd z2y = z2_.leftCols(count_).transpose() * y.col(0);
+
+  std::vector<double> ret(count_);
+  for (int i = 0; i < count_; ++i) {
+    ret[i] = CorrFromSums(my(i, 0), zy(i, 0), my(i, 1), z2y(i), my(i, 2), zy(i, 1), min_count_);
+  }
+  return ret;
+}
+
+int CorrPool::Add(math::VecView<const double> x) {
+  if (count_ == z_.cols()) {
+    int capacity = std::max<int>(16, z_.cols() * 2);
+    z_.conservativeResize(size_, capacity);
+    mask_.conservativeResize(size_, capacity);
+    z2_.conservativeResize(size_, capacity);
+  }
+  has_missing_ |= Load(x, z_.col(count_), mask_.col(count_), z2_.col(count_));
+  return count_++;
+}
+
+Eigen::MatrixXd CorrPool::Matrix(TaskPool *pool, int block_size) const {
+  ENSURE(block_size > 0, "Invalid block size {}", block_size);
+  Eigen::MatrixXd ret(count_, count_);
+  int num_blocks = (count_ + block_size - 1) / block_size;
+  std::vector<std::pair<int, int>> blocks;
+  for (int bi = 0; bi < num_blocks; ++bi) {
+    for (int bj = bi; bj < num_blocks; ++bj) blocks.emplace_back(bi, bj);
+  }
+  Eigen::VectorXd sum2 = z2_.leftCols(count_).colwise().sum().transpose();
+
+  TaskPool::ParallelFor(pool, 0, blocks.size(), 1, [&](int64_t begin, int64_t end) {
+    for (int64_t b = begin; b < end; ++b) {
+      int i0 = blocks[b].first * block_size;
+      int j0 = blocks[b].second * block_size;
+      int ni = std::min(block_size, count_ - i0);
+      int nj = std::min(block_size, count_ - j0);
+      auto zi = z_.middleCols(i0, ni);
+      auto zj = z_.middleCols(j0, nj);
+      Eigen::MatrixXd sxy = zi.transpose() * zj;
+      Eigen::MatrixXd n, sx, sy, sxx, syy;
+      if (has_missing_) {
+        auto mi = mask_.middleCols(i0, ni);
+        auto mj = mask_.middleCols(j0, nj);
+        n = mi.transpose() * mj;
+        sx = zi.transpose() * mj;
+        sy = mi.transpose() * zj;
+        sxx = z2_.middleCols(i0, ni).transpose() * mj;
+        syy = mi.transpose() * z2_.middleCols(j0, nj);
+      }
+      for (int i = 0; i < ni; ++i) {
+        for (int j = 0; j < nj; ++j) {
+          // complete columns are centered, so their sums are 0
+          double c = has_missing_ ? CorrFromSums(n(i, j), sx(i, j), sy(i, j), sxx(i, j),
+                                                 syy(i, j), sxy(i, j), min_count_)
+                                  : CorrFromSums(size_, 0, 0, sum2[i0 + i], sum2[j0 + j],
+                                                 sxy(i, j), min_count_);
+          ret(i0 + i, j0 + j) = c;
+          ret(j0 + j, i0 + i) = c;
+        }
+      }
+    }
+  });
+  return ret;
+}
+
+Eigen::MatrixXd CorrPool::SignalCorr(const std::vector<math::MatView<const float>> &sigs,
+                                     TaskPool *pool, int min_count) {
+  int count = sigs.size();
+  if (count == 0) return {};
+  int rows = sigs[0].rows();
+  int cols = sigs[0].cols();
+  for (auto &sig : sigs) {
+    ENSURE(sig.rows() == rows && sig.cols() == cols, "Signal {}x{} differs from {}x{}", sig.rows(),
+           sig.cols(), rows, cols);
+  }
+
+  std::vector<double> means(count);
+  TaskPool::ParallelFor(pool, 0, count, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t k = begin; k < end; ++k) {
+      double sum = 0;
+      int64_t n = 0;
+      for (int di = 0; di < rows; ++di) {
+        for (int ii = 0; ii < cols; ++ii) {
+          float v = sigs[k](di, ii);
+          if (std::isfinite(v)) {
+            sum += v;
+            ++n;
+          }
+        }
+      }
+      means[k] = n > 0 ? sum / n : 0;
+    }
+  });
+
+  // blocks of days are stacked into positions x signals. Consecutive blocks are split into a fixed
+  // number of groups, which depends on the signals only, each group sums into its own partial and
+  // the partials are added in group order, so the result is the same on any pool. The groups are
+  // capped so their partials stay within MAX_PARTIAL_BYTES.
+  constexpr int64_t MAX_GROUPS = 64;
+  constexpr int64_t MAX_PARTIAL_BYTES = int64_t(256) << 20;
+  int block_days = std::max(1, 8192 / std::max(cols, 1));
+  int64_t num_blocks = (rows + block_days - 1) / block_days;
+  int64_t partial_bytes = 4 * sizeof(double) * static_cast<int64_t>(count) * count;
+  int64_t max_groups = std::clamp<int64_t>(MAX_PARTIAL_BYTES / partial_bytes, 1, MAX_GROUPS);
+  int64_t group_blocks = std::max<int64_t>(1, (num_blocks + max_groups - 1) / max_groups);
+  int64_t num_groups = (num_blocks + group_blocks - 1) / group_blocks;
+  std::vector<CorrSums> partials(num_groups, CorrSums(count));
+  TaskPool::ParallelFor(pool, 0, num_groups, 1, [&](int64_t begin, int64_t end) {
+    Eigen::MatrixXd z(static_cast<int64_t>(block_days) * cols, count);
+    Eigen::MatrixXd mask(z.rows(), count);
+    for (int64_t g = begin; g < end; ++g) {
+      for (int64_t b = g * group_blocks; b < std::min(num_blocks, (g + 1) * group_blocks); ++b) {
+        int start_di = b * block_days;
+        int end_di = std::min(rows, start_di + block_days);
+        int64_t block_rows = static_cast<int64_t>(end_di - start_di) * cols;
+        for (int k = 0; k < count; ++k) {
+          for (int di = start_di; di < end_di; ++di) {
+            for (int ii = 0; ii < cols; ++ii) {
+              float v = sigs[k](di, ii);
+              bool valid = std::isfinite(v);
+              int64_t row = static_cast<int64_t>(di - start_di) * cols + ii;
+              z(row, k) = valid ? v - means[k] : 0;
+              mask(row, k) = valid;
+            }
+          }
+        }
+        partials[g].Add(z.topRows(block_rows), mask.topRows(block_rows));
+      }
+    }
+  });
+  CorrSums sums(count);
+  for (auto &partial : partials) sums += partial;
+
+  Eigen::MatrixXd ret(count, count);
+  for (int i = 0; i < count; ++i) {
+    for (int j = 0; j < count; ++j) {
+      ret(i, j) = CorrFromSums(sums.n(i, j), sums.sx(i, j), sums.sx(j, i), sums.sxx(i, j),
+                               sums.sxx(j, i), sums.sxy(i, j), min_count);
+    }
+  }
+  return ret;
+}
+
+}  // namespace yang
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <vector>
+
+#include "yang/math/mat_view.h"
+#include "yang/math/vec_view.h"
+#include "yang/util/task_pool.h"
+
+namespace yang {
+
+// Pearson correlations of series, e.g. the daily returns of alphas, where NaN is missing and each
+// pair only uses the days valid in both. Columns are stored centered with NaN as 0 next to their
+// valid masks, so the pairwise sums of a block of pairs are a few matrix products:
+//   n = M'M, sum x = Z'M, sum x^2 = (Z*Z)'M and sum xy = Z'Z.
+//
+// Checking a new series against a pool of N takes O(N * size) instead of recomputing the matrix.
+class CorrPool {
+ public:
+  // Pairs with fewer common valid days than min_count have NaN correlation
+  explicit CorrPool(int size, int min_count = 2);
+
+  // Days of each series
+  int size() const {
+    return size_;
+  }
+
+  // Series in the pool
+  int count() const {
+    return count_;
+  }
+
+  // Correlations of x with each series of the pool
+  std::vector<double> Corr(math::VecView<const double> x) const;
+
+  // Adds x to the pool and returns its index
+  int Add(math::VecView<const double> x);
+
+  // The count() x count() correlation matrix, computed in blocks of block_size series
+  Eigen::MatrixXd Matrix(TaskPool *pool = nullptr, int block_size = 256) const;
+
+  // The correlation matrix of signals as vectors of positions over all days and instruments, where
+  // non-finite positions are missing
+  static Eigen::MatrixXd SignalCorr(const std::vector<math::MatView<const float>> &sigs,
+                                    TaskPool *pool = nullptr, int min_count = 2);
+
+  // Correlation from the sums over the n common valid values of x and y
+  static double CorrFromSums(double n, double sx, double sy, double sxx, double syy, double sxy,
+                             int min_count);
+
+ private:
+  // Centers x by its mean into z with NaN as 0, and its valid mask and squares. Returns whether x
+  // has missing values.
+  bool Load(math::VecView<const double> x, Eigen::Ref<Eigen::VectorXd> z,
+            Eigen::Ref<Eigen::VectorXd> mask, Eigen::Ref<Eigen::VectorXd> z2) const;
+
+  int size_;
+  int min_count_;
+  int count_ = 0;
+  bool has_missing_ = false;
+  Eigen::MatrixXd z_;
+  Eigen::MatrixXd mask_;
+  Eigen::MatrixXd z2_;
+};
+
+}  // namespace yang
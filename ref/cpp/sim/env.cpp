@@ -1,13 +1,20 @@
 #include "yang/sim/env.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <string_view>
 #include <vector>
 
 #include "yang/data/array.h"
+#include "yang/data/row_versions.h"
 #include "yang/io/open.h"
+#include "yang/math/ops.h"
 #include "yang/util/datetime.h"
 #include "yang/util/fs.h"
+#include "yang/util/hash.h"
 #include "yang/util/logging.h"
 #include "yang/util/simple_csv.h"
 #include "yang/util/strings.h"
@@ -36,6 +43,96 @@ void Env::Initialize(const Config &config_arg) {
     rerun_manager_->Initialize(cache_dir_.GetWritePath("_rerun"));
     LOG_DEBUG("Enabled RerunManager");
   }
+
+  track_row_versions_ = config_.Get("track_row_versions", false);
+  persist_derived_data_ = config_.Get("persist_derived_data", false);
+
+  if (auto hints_config = config_["mmap_hints"]) {
+    LoadMMapHints(hints_config);
+  }
+
+  if (config_.Get("use_prefetcher", false)) {
+    prefetcher_ = std::make_unique<Prefetcher>(&cache_dir_, cache_dir_.GetWritePath("_prefetch"),
+                                               config_.Get("prefetch_threads", 2));
+    LOG_DEBUG("Enabled Prefetcher");
+  }
+}
+
+void Env::LoadMMapHints(const Config &hints_config) {
+  for (auto item : hints_config) {
+    auto key = item.first.as<std::string>();
+    auto &value = item.second;
+    MMapHints hints;
+    hints.populate = value.Get("populate", false);
+    hints.huge_pages = value.Get("huge_pages", false);
+    auto advice = value.Get<std::string>("advice", "normal");
+    ENSURE(ParseMMapAdvice(advice, hints.advice), "Invalid mmap advice for {}: {}", key, advice);
+    mmap_hints_[key] = hints;
+  }
+}
+
+MMapHints Env::GetMMapHints(std::string_view mod, std::string_view data,
+                            std::string_view item_type) const {
+  if (mmap_hints_.empty()) return {};
+  auto it = mmap_hints_.find(fmt::format("{}/{}", mod, data));
+  if (it != mmap_hints_.end()) return it->second;
+  it = mmap_hints_.find(item_type);
+  if (it != mmap_hints_.end()) return it->second;
+  it = mmap_hints_.find("default");
+  if (it != mmap_hints_.end()) return it->second;
+  return {};
+}
+
+std::pair<int, int> Env::GetChangedRows(std::string_view mod, std::string_view data,
+                                        uint64_t since_version) const {
+  RowVersions versions(cache_dir().GetReadPath(mod, data));
+  if (versions.rows() == 0) return {0, dates_size()};
+  auto [first, last] = versions.GetChangedRange(since_version);
+  return {std::min<int>(first, dates_size()), std::min<int>(last, dates_size())};
+}
+
+// Hash of the content of an array or file: row checksums if its row versions are up to date, the
+// bytes of small files, otherwise only size and modification time. 0 if it does not exist.
+static uint64_t GetFileFingerprint(const fs::path &path) {
+  constexpr uintmax_t max_hashed_size = 1 << 16;
+  std::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if (ec) return 0;
+  auto time = fs::last_write_time(path, ec);
+  auto row_versions_path = RowVersions::GetPath(path);
+  if (fs::exists(row_versions_path) && fs::last_write_time(row_versions_path, ec) >= time) {
+    return RowVersions(path).Fingerprint();
+  } else if (size <= max_hashed_size) {
+    std::ifstream ifs(path, std::ios::binary);
+    std::string bytes(size, '\0');
+    ifs.read(bytes.data(), size);
+    return HashBytes(bytes);
+  }
+  int64_t stat[] = {static_cast<int64_t>(size), time.time_since_epoch().count()};
+  return HashBytes(stat, sizeof(stat));
+}
+
+uint64_t Env::GetContentFingerprint(std::string_view mod) const {
+  std::error_code ec;
+  fs::path dir = cache_dir().GetWritePath(mod);
+  std::vector<fs::path> paths;
+  for (auto &entry : fs::recursive_directory_iterator(dir, ec)) {
+    auto ext = entry.path().extension();
+    if (entry.is_regular_file() && ext != ".rowver" && ext != ".tmp") {
+      paths.push_back(entry.path());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+
+  uint64_t ret = 0;
+  for (auto &path : paths) {
+    uint64_t hash = GetFileFingerprint(path);
+    if (hash == 0) continue;
+    auto name = fs::relative(path, dir).native();
+    uint64_t item[] = {ret, HashBytes(name), hash};
+    ret = HashBytes(item, sizeof(item));
+  }
+  return ret;
 }
 
 void Env::Build() {
@@ -278,11 +375,120 @@ void Env::Load() {
   PostLoad();
 }
 
+expr::FloatMat Env::ReadFloatMat(std::string_view data) const {
+  auto item_type = ArrayBase::GetItemType(cache_dir().GetPath(data));
+  if (item_type == GetTypeName<double>()) {
+    return ReadData<Array<double>>(data)->mat_view();
+  } else if (item_type == GetTypeName<float>()) {
+    return ReadData<Array<float>>(data)->mat_view();
+  } else if (item_type == GetTypeName<int32_t>()) {
+    return ReadData<Array<int32_t>>(data)->mat_view();
+  } else if (item_type == GetTypeName<float16>()) {
+    return ReadData<Array<float16>>(data)->mat_view();
+  } else if (item_type == GetTypeName<bfloat16>()) {
+    return ReadData<Array<bfloat16>>(data)->mat_view();
+  } else if (item_type == GetTypeName<int16_t>()) {
+    auto array = ReadData<Array<int16_t>>(data);
+    ENSURE(array->scale() != 0, "int16 data is not scaled: {}", data);
+    return expr::FloatMat(array->mat_view(), array->scale());
+  }
+  LOG_FATAL("unsupported data type {}", item_type);
+}
+
+const Array<float> *Env::GetFilledArray(std::string_view data, int horizon) const {
+  return GetDerivedData<Array<float>>(
+      fmt::format("ffill({},{})", data, horizon), {std::string(data)}, [&]() {
+        // reduced precision data is widened row by row into the result and filled in place
+        auto src = ReadFloatMat(data);
+        Array<float> filled({src.rows(), src.cols()});
+        for (int di = 0; di < src.rows(); di++) src.LoadRow(filled.row_vec(di), di);
+        for (int ii = 0; ii < src.cols(); ii++) {
+          math::ops::ffill(filled.col_vec(ii).begin(), filled.col_vec(ii).end(), horizon);
+        }
+        return filled;
+      });
+}
+
+std::string Env::GetDerivedName(std::string_view key) {
+  // keys are expressions like ffill(ibase/i_close,1000)
+  std::string name(key);
+  for (auto &c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') c = '_';
+  }
+  return name;
+}
+
+uint64_t Env::GetInputsFingerprint(const std::vector<std::string> &inputs) const {
+  uint64_t ret = 0;
+  for (auto &input : inputs) {
+    auto pos = input.find('/');
+    ENSURE(pos != std::string::npos, "Missing module name in data spec: {}", input);
+    auto input_path = cache_dir().GetReadPath(input.substr(0, pos), input.substr(pos + 1));
+    uint64_t item[] = {ret, HashBytes(input), GetFileFingerprint(input_path)};
+    ret = HashBytes(item, sizeof(item));
+  }
+  return ret;
+}
+
+bool Env::IsDerivedDataFresh(const std::string &path, uint64_t inputs_fingerprint) const {
+  if (!fs::exists(path + ".meta")) return false;
+  std::ifstream ifs(path + ".inputs");
+  uint64_t saved = 0;
+  return static_cast<bool>(ifs >> saved) && saved == inputs_fingerprint;
+}
+
+std::string Env::GetDerivedTmpPath(const std::string &name) const {
+  return fmt::format("{}.{}.tmp", cache_dir().GetWritePath("_derived", name), getpid());
+}
+
+std::string Env::CommitDerivedData(const std::string &tmp_path, const std::string &name,
+                                   uint64_t inputs_fingerprint) const {
+  {
+    std::ofstream ofs(tmp_path + ".inputs");
+    ofs << inputs_fingerprint;
+    ENSURE(ofs.good(), "Failed to save {}.inputs", tmp_path);
+  }
+  // the inputs are removed first and renamed last, data without them is never fresh
+  auto path = cache_dir().GetWritePath("_derived", name);
+  DirLock lock(fs::path(path).parent_path());
+  fs::remove(path + ".inputs");
+  fs::rename(tmp_path, path);
+  fs::rename(tmp_path + ".meta", path + ".meta");
+  fs::rename(tmp_path + ".inputs", path + ".inputs");
+  return path;
+}
+
+void Env::Refresh() {
+  ENSURE2(config_);
+  auto meta = Config::LoadFile(GetMetaPath());
+  ENSURE(meta.Get<int64_t>("univ_start_datetime") == univ_start_datetime_ &&
+             meta.Get<int64_t>("univ_end_datetime") >= univ_end_datetime_,
+         "Env rebuilt since load, please restart");
+  univ_end_datetime_ = meta.Get<int64_t>("univ_end_datetime");
+  sim_end_datetime_ = config<int64_t>(daily_ ? "sim_end_date" : "sim_end_datetime",
+                                      univ_end_datetime_);
+  datetimes_ = DateTimeIndex::Load(cache_dir_.GetPath(name(), "datetimes"), true);
+  univ_ = UnivIndex::Load(cache_dir().GetPath(name(), "univ"), true);
+  PostLoad();
+
+  // copies in memory miss the new rows, derived data is made again under the new epoch and
+  // compressed arrays are read again. Arrays mapped before max_datetimes_size grew are mapped
+  // again with the rows appended since.
+  ++refresh_epoch_;
+  data_cache_.EraseShortArrays(max_datetimes_size());
+  data_cache_.EraseIf([this](std::string_view key) {
+    if (key.starts_with("_derived.")) return true;
+    auto pos = key.find('.');
+    return pos != std::string_view::npos &&
+           IsCompressedArray(cache_dir().GetReadPath(key.substr(0, pos), key.substr(pos + 1)));
+  });
+}
+
 void Env::PostLoad() {
   start_dti_ = datetimes_.LowerBound(sim_start_datetime_);
   end_dti_ = datetimes_.UpperBound(sim_end_datetime_);
   if (rerun_manager_) {
-    rerun_manager_->SetDates(datetimes_[0], datetimes_[end_dti_ - 1]);
+    rerun_manager_->SetDates(datetimes_[0], datetimes_[end_dti_ - 1], end_dti_);
   }
 }
 
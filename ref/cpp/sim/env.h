@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -7,10 +8,16 @@
 #include "yang/data/data_cache.h"
 #include "yang/data/index.h"
 #include "yang/data/univ_index.h"
+#include "yang/expr/mat.h"
 #include "yang/sim/data_directory.h"
+#include "yang/sim/prefetcher.h"
 #include "yang/sim/rerun_manager.h"
 #include "yang/util/config.h"
+#include "yang/util/dir_lock.h"
 #include "yang/util/factory_registry.h"
+#include "yang/util/task_pool.h"
+#include "yang/util/trace.h"
+#include "yang/util/unordered_map.h"
 
 namespace yang {
 
@@ -70,6 +77,19 @@ class Env {
     return rerun_manager_.get();
   }
 
+  Prefetcher *prefetcher() const {
+    return prefetcher_.get();
+  }
+
+  // Worker threads shared with the runner, nullptr if not run by a runner
+  TaskPool *task_pool() const {
+    return task_pool_;
+  }
+
+  void set_task_pool(TaskPool *pool) {
+    task_pool_ = pool;
+  }
+
   const Config &config() const {
     return config_;
   }
@@ -221,7 +241,28 @@ class Env {
   template <class T>
   const T *ReadData(std::string_view mod, std::string_view data) const {
     auto key = fmt::format("{}.{}", mod, data);
-    return data_cache().GetOrLoad<T>(key, cache_dir().GetReadPath(mod, data));
+    if constexpr (is_array_v<T>) {
+      return data_cache().GetOrMake<T>(key, [&]() {
+        using Item = typename T::value_type;
+        TraceScope scope("ReadData", "data");
+        auto path = cache_dir().GetReadPath(mod, data);
+        auto hints = GetMMapHints(mod, data, GetTypeName<Item>());
+        if constexpr (std::is_floating_point_v<Item>) {
+          ENSURE(!IsReducedPrecisionArray(path),
+                 "{} has reduced precision, read it with ReadFloatMat", key);
+        }
+        auto array = T::MMap(path, false, hints);
+        if (scope.enabled()) {
+          SizeType bytes = sizeof(Item);
+          for (auto d : array.shape()) bytes *= d;
+          scope.AddArg("data", key);
+          scope.AddArg("bytes", bytes);
+        }
+        return array;
+      });
+    } else {
+      return data_cache().GetOrLoad<T>(key, cache_dir().GetReadPath(mod, data));
+    }
   }
 
   template <class T>
@@ -236,12 +277,87 @@ class Env {
     return ReadData<yang::Array<T>>(std::forward<Args>(args)...);
   }
 
+  // Numeric data of any item type as a FloatMat over its mmap, e.g. float16, bfloat16 or scaled
+  // int16 data is kept narrow and widened row by row by FloatMat::LoadRow
+  expr::FloatMat ReadFloatMat(std::string_view data) const;
+
+  // Rows [first, last) of data changed after since_version according to its row versions. Data
+  // without row versions is considered changed entirely.
+  std::pair<int, int> GetChangedRows(std::string_view mod, std::string_view data,
+                                     uint64_t since_version) const;
+
+  std::pair<int, int> GetChangedRows(std::string_view data, uint64_t since_version) const {
+    auto pos = data.find('/');
+    ENSURE(pos != std::string_view::npos, "Missing module name in data spec: {}", data);
+    return GetChangedRows(data.substr(0, pos), data.substr(pos + 1), since_version);
+  }
+
+  // Hash of the content of the data written by mod, 0 if it has none. Arrays with up to date row
+  // versions contribute their row checksums and small files their bytes, other files only their
+  // size and modification time.
+  uint64_t GetContentFingerprint(std::string_view mod) const;
+
+  // Data computed from other data, e.g. forward filled prices, made once per refresh of the env and
+  // shared read-only by all callers through the data cache. With `persist_derived_data` derived
+  // arrays are also saved in the `_derived` directory of the cache, and reused by later runs while
+  // the content of their inputs ("mod/data" specs) is unchanged. They are written aside and renamed
+  // in place under the lock of the directory, so runs in other processes never map a partial file.
+  template <class T, class Func>
+  const T *GetDerivedData(std::string_view key, const std::vector<std::string> &inputs,
+                          Func &&make) const {
+    auto cache_key = fmt::format("_derived.{}.{}", refresh_epoch_, key);
+    return data_cache().GetOrMake<T>(cache_key, [&]() -> T {
+      TraceScope scope("GetDerivedData", "data");
+      scope.AddArg("data", key);
+      if constexpr (is_array_v<T>) {
+        if (persist_derived_data_) {
+          auto name = GetDerivedName(key);
+          auto path = cache_dir().GetReadPath("_derived", name);
+          uint64_t inputs_fingerprint = GetInputsFingerprint(inputs);
+          {
+            DirLock lock(fs::path(path).parent_path());
+            if (IsDerivedDataFresh(path, inputs_fingerprint)) return T::MMap(path);
+          }
+          T data = make();
+          auto tmp_path = GetDerivedTmpPath(name);
+          {
+            auto saved = T::MMap(tmp_path, data.shape(), data.null_value());
+            SizeType size = 1;
+            for (auto d : data.shape()) size *= d;
+            std::copy_n(data.data(), size, saved.data());
+          }
+          path = CommitDerivedData(tmp_path, name, inputs_fingerprint);
+          LOG_DEBUG("Saved derived data {}", path);
+          return T::MMap(path);
+        }
+      }
+      return make();
+    });
+  }
+
+  // data forward filled over at most horizon rows, see math::ops::ffill
+  const Array<float> *GetFilledArray(std::string_view data, int horizon) const;
+
+  // Whether modules record row versions of the arrays they write, see Module::CommitWrites
+  bool track_row_versions() const {
+    return track_row_versions_;
+  }
+
+  // Default mmap hints of data, configured in `mmap_hints` by "mod/data", item type or "default"
+  MMapHints GetMMapHints(std::string_view mod, std::string_view data,
+                         std::string_view item_type) const;
+
   void Initialize(const Config &config_arg);
 
   void Build();
 
   void Load();
 
+  // Pick up datetimes and instruments added since Load by another process, e.g. the next live
+  // interval. Mapped arrays stay cached while they still have max_datetimes_size rows, those
+  // mapped with fewer rows, compressed arrays and derived data are read or made again.
+  void Refresh();
+
   virtual int default_max_univ_size() const {
     return 6000;
   }
@@ -266,12 +382,18 @@ class Env {
   DataDirectory cache_dir_;
   mutable DataCache data_cache_;
   std::unique_ptr<RerunManager> rerun_manager_;
+  std::unique_ptr<Prefetcher> prefetcher_;
+  TaskPool *task_pool_ = nullptr;
+  unordered_map<std::string, MMapHints> mmap_hints_;
   Config config_;
 
   bool live_ = false;
   bool prod_ = false;
   bool daily_ = true;
   bool user_mode_ = false;
+  bool track_row_versions_ = false;
+  bool persist_derived_data_ = false;
+  uint64_t refresh_epoch_ = 0;
 
   int64_t univ_start_datetime_ = 0;
   int64_t univ_end_datetime_ = 0;
@@ -309,6 +431,22 @@ class Env {
   virtual void BuildImpl(int new_start_dti);
 
   void PostLoad();
+
+  void LoadMMapHints(const Config &hints_config);
+
+  static std::string GetDerivedName(std::string_view key);
+
+  uint64_t GetInputsFingerprint(const std::vector<std::string> &inputs) const;
+
+  bool IsDerivedDataFresh(const std::string &path, uint64_t inputs_fingerprint) const;
+
+  // A path next to the derived data name to write it to before CommitDerivedData
+  std::string GetDerivedTmpPath(const std::string &name) const;
+
+  // Rename the derived data written to tmp_path in place with its inputs fingerprint, under the
+  // lock of the directory. Returns the path of the data.
+  std::string CommitDerivedData(const std::string &tmp_path, const std::string &name,
+                                uint64_t inputs_fingerprint) const;
 };
 
 #define REGISTER_ENV(cls) REGISTER_FACTORY("env", cls, cls, #cls)
@@ -3,6 +3,7 @@
 #include "yang/expr/expr.h"
 #include "yang/expr/mat_data_source.h"
 #include "yang/math/mat_ops.h"
+#include "yang/util/trace.h"
 #include "yang/util/unordered_map.h"
 #include "yang/util/unordered_set.h"
 
@@ -51,8 +52,76 @@ void ExprRunner::Run(std::string_view expr_str, std::string_view univ, expr::Out
   Run(expr_str, univ, output, mode, env_->dates_size(), env_->start_di(), env_->end_di());
 }
 
+std::pair<std::string_view, std::string_view> ExprRunner::GetDataPaths(std::string_view name,
+                                                                       Mode mode) const {
+  auto it = data_.find(name);
+  std::string_view live_path;
+  std::string_view eod_path;
+  if (it == data_.end()) {
+    live_path = name;
+    eod_path = name;
+  } else {
+    live_path = it->second.first;
+    eod_path = it->second.second;
+  }
+  if (mode == Mode::EOD) {
+    live_path = eod_path;
+  }
+  return std::make_pair(live_path, eod_path);
+}
+
+std::pair<int, int> ExprRunner::GetChangedRange(std::string_view expr_str, uint64_t since_version,
+                                                Mode mode) const {
+  int dates_size = env_->dates_size();
+  expr::MatDataSource data_src(dates_size, env_->univ_size());
+  expr::Expr expr(expr_str, &data_src);
+
+  int first = dates_size;
+  int last = 0;
+  auto add_changed = [&](std::string_view data_path) {
+    auto [changed_first, changed_last] = env_->GetChangedRows(data_path, since_version);
+    if (changed_first >= changed_last) return;
+    first = std::min(first, changed_first);
+    last = std::max(last, changed_last);
+  };
+  for (auto &group : expr.CollectGroups()) {
+    add_changed(groups_.count(group) ? "base/" + group : group);
+  }
+  for (auto &name : expr.CollectRawData()) {
+    auto [live_path, eod_path] = GetDataPaths(name, mode);
+    add_changed(live_path);
+    if (eod_path != live_path) add_changed(eod_path);
+  }
+  if (first >= last) return {0, 0};
+  // a changed row affects the outputs of the following rows within the lookback
+  return {first, std::min(dates_size, last + expr.full_hist_len() - 1)};
+}
+
+std::pair<int, int> ExprRunner::RunChanged(std::string_view expr_str, std::string_view univ,
+                                           expr::OutFloatMat output, Mode mode, int dates_size,
+                                           int start_di, int end_di, uint64_t since_version) {
+  auto [first, last] = GetChangedRange(expr_str, since_version, mode);
+  if (!univ.empty()) {
+    auto [univ_first, univ_last] = env_->GetChangedRows(univ, since_version);
+    if (univ_first < univ_last) {
+      first = first < last ? std::min(first, univ_first) : univ_first;
+      last = std::max(last, univ_last);
+    }
+  }
+  first = std::max(first, start_di);
+  last = std::min(last, end_di);
+  if (first >= last) {
+    LOG_DEBUG("Skip expr {}: inputs unchanged", expr_str);
+    return {0, 0};
+  }
+  Run(expr_str, univ, output, mode, dates_size, first, last);
+  return {first, last};
+}
+
 void ExprRunner::Run(std::string_view expr_str, std::string_view univ, expr::OutFloatMat output,
                      Mode mode, int dates_size, int start_di, int end_di) {
+  TraceScope scope("expr", "expr");
+  scope.AddArg("expr", expr_str);
   int univ_size = env_->univ_size();
 
   expr::MatDataSource data_src(dates_size, univ_size);
@@ -79,46 +148,34 @@ void ExprRunner::Run(std::string_view expr_str, std::string_view univ, expr::Out
     }
   }
 
-  auto add_data = [&](auto &name, auto &array, auto &eod_array) {
-    ENSURE2(array.shape(0) >= dates_size && array.shape(1) == env_->max_univ_size());
-    data_src.AddData(name, array.mat_view().block(0, 0, dates_size, univ_size),
-                     eod_array.mat_view().block(0, 0, dates_size, univ_size));
-  };
-  for (auto &name : expr.CollectRawData()) {
-    auto it = data_.find(name);
-    std::string_view live_path;
-    std::string_view eod_path;
-    if (it == data_.end()) {
-      live_path = name;
-      eod_path = name;
-    } else {
-      live_path = it->second.first;
-      eod_path = it->second.second;
-    }
-    if (mode == Mode::EOD) {
-      live_path = eod_path;
-    }
-    auto item_type = ArrayBase::GetItemType(env_->cache_dir().GetPath(live_path));
-    if (item_type == "double") {
-      add_data(name, *env_->ReadData<Array<double>>(live_path),
-               *env_->ReadData<Array<double>>(eod_path));
-    } else if (item_type == "float") {
-      add_data(name, *env_->ReadData<Array<float>>(live_path),
-               *env_->ReadData<Array<float>>(eod_path));
-    } else if (item_type == "int32") {
-      add_data(name, *env_->ReadData<Array<int32_t>>(live_path),
-               *env_->ReadData<Array<int32_t>>(eod_path));
-    } else {
-      LOG_FATAL("unsupported extra_data type {}", item_type);
+  auto raw_data = expr.CollectRawData();
+  int hist_start_di = std::max(start_di - expr.full_hist_len() + 1, 0);
+
+  if (auto prefetcher = env_->prefetcher()) {
+    // page in the needed rows in the background while the arrays are being mapped
+    for (auto &name : raw_data) {
+      auto [live_path, eod_path] = GetDataPaths(name, mode);
+      prefetcher->Prefetch(live_path, hist_start_di, end_di);
+      if (eod_path != live_path) prefetcher->Prefetch(eod_path, hist_start_di, end_di);
     }
   }
 
+  auto add_data = [&](auto &name, const expr::FloatMat &data, const expr::FloatMat &eod_data) {
+    ENSURE2(data.rows() >= dates_size && data.cols() == env_->max_univ_size());
+    ENSURE2(eod_data.rows() >= dates_size && eod_data.cols() == env_->max_univ_size());
+    data_src.AddData(name, data.slice(0, dates_size, 0, univ_size),
+                     eod_data.slice(0, dates_size, 0, univ_size));
+  };
+  for (auto &name : raw_data) {
+    auto [live_path, eod_path] = GetDataPaths(name, mode);
+    add_data(name, env_->ReadFloatMat(live_path), env_->ReadFloatMat(eod_path));
+  }
+
   if (!univ.empty()) {
     auto &univ_array = *env_->ReadData<Array<bool>>(univ);
     data_src.set_mask(univ_array.mat_view().block(0, 0, dates_size, univ_size));
   }
 
-  int hist_start_di = std::max(start_di - expr.full_hist_len() + 1, 0);
   LOG_INFO("Running expr: {} ({} - {}) (univ: {})", expr_str, hist_start_di, end_di, univ);
 
   data_src.set_live(mode == Mode::INTRADAY);
@@ -150,17 +207,7 @@ void ExprRunner::RunSimple(std::string_view name, std::string_view univ, expr::O
     data_path = mode == Mode::EOD ? data_it->second.second : data_it->second.first;
   }
 
-  auto item_type = ArrayBase::GetItemType(env_->cache_dir().GetPath(data_path));
-  expr::FloatMat input(yang::math::MatView<const float>{});
-  if (item_type == "double") {
-    input = expr::FloatMat(env_->ReadData<Array<double>>(data_path)->mat_view());
-  } else if (item_type == "float") {
-    input = expr::FloatMat(env_->ReadData<Array<float>>(data_path)->mat_view());
-  } else if (item_type == "int32") {
-    input = expr::FloatMat(env_->ReadData<Array<int32_t>>(data_path)->mat_view());
-  } else {
-    LOG_FATAL("unsupported data type {}", item_type);
-  }
+  auto input = env_->ReadFloatMat(data_path);
 
   int univ_size = env_->univ_size();
   LOG_INFO("Running expr: {} ({} - {}) (univ: {}) (fast path)", name, start_di, end_di, univ);
@@ -183,12 +230,29 @@ void ExprRunner::RunSimple(std::string_view name, std::string_view univ, expr::O
     copy_mat(input.raw<float>(), output.raw<double>());
   } else if (input.type_index() == 1) {
     copy_mat(input.raw<double>(), output.raw<float>());
-  } else {
+  } else if (input.type_index() == 2) {
     if (output.type_index() == 0) {
       copy_mat(input.raw<int32_t>(), output.raw<float>());
     } else {
       copy_mat(input.raw<int32_t>(), output.raw<double>());
     }
+  } else {
+    // reduced precision data, widen row by row
+    auto widen_mat = [&](auto out_mat) {
+      out_mat = out_mat.slice(start_di, end_di, 0, univ_size);
+      auto in_mat = input.slice(start_di, end_di, 0, univ_size);
+      for (int i = 0; i < out_mat.rows(); ++i) in_mat.LoadRow(out_mat.row(i).to_vec(), i);
+      if (!univ.empty()) {
+        auto &univ_array = *env_->ReadData<Array<bool>>(univ);
+        yang::math::ops::filter(out_mat,
+                                univ_array.mat_view().slice(start_di, end_di, 0, univ_size));
+      }
+    };
+    if (output.type_index() == 0) {
+      widen_mat(output.raw<float>());
+    } else {
+      widen_mat(output.raw<double>());
+    }
   }
 }
 
@@ -3,6 +3,7 @@
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "yang/expr/mat.h"
@@ -53,6 +54,18 @@ class ExprRunner {
   void Run(std::string_view expr_str, std::string_view univ, expr::OutFloatMat output, Mode mode,
            int dates_size, int start_di, int end_di);
 
+  // The date range [first, last) of the outputs of expr_str affected by input rows changed after
+  // since_version, including the lookback fan-out. Returns {0, 0} if no input changed.
+  std::pair<int, int> GetChangedRange(std::string_view expr_str, uint64_t since_version,
+                                      Mode mode = Mode::INTRADAY) const;
+
+  // Run only over the dates of [start_di, end_di) affected by input rows changed after
+  // since_version, e.g. the timestamp of the run that computed output. Returns the recomputed
+  // range, {0, 0} if nothing changed.
+  std::pair<int, int> RunChanged(std::string_view expr_str, std::string_view univ,
+                                 expr::OutFloatMat output, Mode mode, int dates_size, int start_di,
+                                 int end_di, uint64_t since_version);
+
   static Mode ParseMode(std::string_view str) {
     if (str == "intraday" || str == "INTRADAY") return Mode::INTRADAY;
     if (str == "eod" || str == "EOD") return Mode::EOD;
@@ -67,6 +80,9 @@ class ExprRunner {
 
   void RunSimple(std::string_view name, std::string_view univ, expr::OutFloatMat output, Mode mode,
                  int start_di, int end_di);
+
+  std::pair<std::string_view, std::string_view> GetDataPaths(std::string_view name,
+                                                             Mode mode) const;
 };
 
 }  // namespace yang
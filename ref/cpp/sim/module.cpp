@@ -1,7 +1,27 @@
 #include "yang/sim/module.h"
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include <fmt/format.h>
+
 namespace yang {
 
+namespace {
+
+std::atomic<uint64_t> next_access_epoch{1};
+
+// Data already recorded by this thread for the run with the epoch
+struct ThreadAccesses {
+  uint64_t epoch = 0;
+  unordered_set<std::string> seen;
+};
+
+thread_local ThreadAccesses thread_accesses;
+
+}  // namespace
+
 void Module::Initialize(const std::string &name, const Config &config, const Env *env) {
   name_ = name;
   env_ = env;
@@ -9,9 +29,45 @@ void Module::Initialize(const std::string &name, const Config &config, const Env
 }
 
 void Module::Run() {
+  access_epoch_ = next_access_epoch.fetch_add(1, std::memory_order_relaxed);
   BeforeRun();
   RunImpl();
   AfterRun();
 }
 
+void Module::CommitWrites(uint64_t version) {
+  for (auto &update : pending_row_versions_) update(version);
+  pending_row_versions_.clear();
+}
+
+std::vector<std::string> Module::TakeAccessLog() {
+  std::vector<std::string> ret;
+  {
+    std::lock_guard guard(access_mutex_);
+    ret.assign(access_log_.begin(), access_log_.end());
+    access_log_.clear();
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+void Module::RecordAccess(std::string_view data) {
+  auto &local = thread_accesses;
+  if (local.epoch != access_epoch_) {
+    local.epoch = access_epoch_;
+    local.seen.clear();
+  }
+  if (local.seen.contains(data)) return;
+  local.seen.emplace(data);
+  std::lock_guard guard(access_mutex_);
+  access_log_.emplace(data);
+}
+
+void Module::RecordAccess(std::string_view data_mod, std::string_view data) {
+  // formatted on the stack, no allocation for names that fit the inline buffer
+  fmt::memory_buffer buf;
+  fmt::format_to(std::back_inserter(buf), "{}/{}", data_mod, data);
+  RecordAccess(std::string_view(buf.data(), buf.size()));
+}
+
 }  // namespace yang
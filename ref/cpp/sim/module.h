@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "yang/base/valid.h"
 #include "yang/data/array.h"
@@ -10,6 +14,8 @@
 #include "yang/util/config.h"
 #include "yang/util/factory_registry.h"
 #include "yang/util/logging.h"
+#include "yang/util/parallel_ingest.h"
+#include "yang/util/unordered_set.h"
 
 namespace yang {
 
@@ -108,11 +114,18 @@ class Module {
   }
 
   int start_di() const {
-    return env_->start_di();
+    return start_di_ >= 0 ? start_di_ : env_->start_di();
   }
 
   int end_di() const {
-    return env_->end_di();
+    return end_di_ >= 0 ? end_di_ : env_->end_di();
+  }
+
+  // Restrict the run to [start_di, end_di), e.g. when extending a previous run. -1 means the
+  // range of the env.
+  void set_run_range(int start_di, int end_di) {
+    start_di_ = start_di;
+    end_di_ = end_di;
   }
 
   RunStage stage() const {
@@ -130,13 +143,32 @@ class Module {
   template <class T>
   Array<T> WriteArray(std::string_view mod, std::string_view array_name, const ArrayShape &shape,
                       const T &null = null_v<T>, bool fill_null = false) {
-    return WriteArrayImpl<T>(cache_dir().GetWritePath(mod, array_name), shape, null, fill_null);
+    return WriteArray<T>(mod, array_name, shape, null, fill_null,
+                         env_->GetMMapHints(mod, array_name, GetTypeName<T>()));
+  }
+
+  template <class T>
+  Array<T> WriteArray(std::string_view mod, std::string_view array_name, const ArrayShape &shape,
+                      const T &null, bool fill_null, const MMapHints &hints) {
+    return WriteArrayImpl<T>(cache_dir().GetWritePath(mod, array_name), shape, null, fill_null,
+                             hints);
   }
 
   template <class T>
   Array<T> WriteArray(std::string_view array_name, const ArrayShape &shape,
                       const T &null = null_v<T>, bool fill_null = false) {
-    return WriteArrayImpl<T>(GetDataPath<false>(array_name), shape, null, fill_null);
+    auto pos = array_name.find('/');
+    auto hints = pos == std::string_view::npos
+                     ? env_->GetMMapHints(name(), array_name, GetTypeName<T>())
+                     : env_->GetMMapHints(array_name.substr(0, pos), array_name.substr(pos + 1),
+                                          GetTypeName<T>());
+    return WriteArray<T>(array_name, shape, null, fill_null, hints);
+  }
+
+  template <class T>
+  Array<T> WriteArray(std::string_view array_name, const ArrayShape &shape, const T &null,
+                      bool fill_null, const MMapHints &hints) {
+    return WriteArrayImpl<T>(GetDataPath<false>(array_name), shape, null, fill_null, hints);
   }
 
   template <class T>
@@ -216,12 +248,53 @@ class Module {
 
   template <class T, class... Args>
   const T *ReadData(Args &&...args) {
+    if (env_->prefetcher()) RecordAccess(args...);
     return env_->ReadData<T>(std::forward<Args>(args)...);
   }
 
   template <class T, class... Args>
   const auto *ReadArray(Args &&...args) {
-    return env_->ReadData<yang::Array<T>>(std::forward<Args>(args)...);
+    return ReadData<yang::Array<T>>(std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  expr::FloatMat ReadFloatMat(Args &&...args) {
+    if (env_->prefetcher()) RecordAccess(args...);
+    return env_->ReadFloatMat(std::forward<Args>(args)...);
+  }
+
+  // The sorted data, in "mod/data" format, read since the start of the last run, see Prefetcher
+  std::vector<std::string> TakeAccessLog();
+
+  // Rows [first, last) of data changed after since_version, see Env::GetChangedRows
+  std::pair<int, int> GetChangedRows(std::string_view data_name, uint64_t since_version) const {
+    if (data_name.find('/') == std::string_view::npos) {
+      return env_->GetChangedRows(name(), data_name, since_version);
+    }
+    return env_->GetChangedRows(data_name, since_version);
+  }
+
+  // Record row versions of the arrays written in this run over [start_di, end_di), called by the
+  // runner after the module finishes. Only tracked if `track_row_versions` is enabled.
+  void CommitWrites(uint64_t version);
+
+  // Call fn(begin, end) over chunks of [begin, end) on the runner's workers, see TaskPool
+  void parallel_for(int64_t begin, int64_t end, int64_t grain,
+                    const TaskPool::RangeFunc &fn) const {
+    TaskPool::ParallelFor(env_->task_pool(), begin, end, grain, fn);
+  }
+
+  template <class T, class Fn, class Reduce>
+  T parallel_reduce(int64_t begin, int64_t end, int64_t grain, const T &init, const Fn &fn,
+                    const Reduce &reduce) const {
+    return TaskPool::ParallelReduce(env_->task_pool(), begin, end, grain, init, fn, reduce);
+  }
+
+  // Parse the dates [start_di, end_di) on the runner's workers and merge them in date order, see
+  // ParallelIngest
+  template <class Result, class Parse, class Merge>
+  void parallel_ingest(int start_di, int end_di, const Parse &parse, const Merge &merge) const {
+    ParallelIngest<Result>(env_->task_pool(), start_di, end_di, parse, merge);
   }
 
   template <class T>
@@ -234,6 +307,18 @@ class Module {
   Config config_;
   const Env *env_ = nullptr;
   RunStage stage_ = RunStage::INTRADAY;
+  int start_di_ = -1;
+  int end_di_ = -1;
+  std::vector<std::function<void(uint64_t)>> pending_row_versions_;
+  uint64_t access_epoch_ = 0;
+  std::mutex access_mutex_;
+  unordered_set<std::string> access_log_;
+
+  // Records reads for the prefetcher. A thread only takes the lock the first time it reads data in
+  // a run, repeated reads hit a thread local set.
+  void RecordAccess(std::string_view data);
+
+  void RecordAccess(std::string_view data_mod, std::string_view data);
 
   virtual void BeforeRun() {}
 
@@ -260,9 +345,15 @@ class Module {
 
   template <class T>
   Array<T> WriteArrayImpl(const std::string &path, const ArrayShape &shape,
-                          const T &null = null_v<T>, bool fill_null = false) {
-    auto arr = Array<T>::MMap(path, shape, null);
+                          const T &null = null_v<T>, bool fill_null = false,
+                          const MMapHints &hints = {}) {
+    auto arr = Array<T>::MMap(path, shape, null, hints);
     if (fill_null) arr.FillNull(start_di(), end_di());
+    if (env_->track_row_versions()) {
+      pending_row_versions_.emplace_back([this, arr](uint64_t version) mutable {
+        arr.UpdateRowVersions(start_di(), end_di(), version);
+      });
+    }
     return arr;
   }
 
@@ -21,6 +21,18 @@ struct Operation {
     return false;
   }
 
+  // Whether this is a RowOperation
+  virtual bool row_wise() const {
+    return false;
+  }
+
+  // Whether each row is computed from the same row of the inputs only. The OperationManager then
+  // splits the rows over the runner's workers, so Apply must be safe to call concurrently on
+  // disjoint row ranges.
+  virtual bool row_independent() const {
+    return false;
+  }
+
   virtual void Apply(MatView<float> sig, const Env &env, int start_di, int end_di,
                      const std::vector<std::string> &args,
                      const std::unordered_map<std::string, std::string> &kwargs) {
@@ -35,6 +47,51 @@ struct Operation {
   virtual void Apply(MatView<float> sig, const Env &env, int start_di, int end_di) {
     throw FatalError("Unimplemented");
   }
+
+  // Call fn(begin, end) over chunks of [begin, end) on the runner's workers, see TaskPool
+  static void parallel_for(const Env &env, int64_t begin, int64_t end, int64_t grain,
+                           const TaskPool::RangeFunc &fn) {
+    TaskPool::ParallelFor(env.task_pool(), begin, end, grain, fn);
+  }
+
+  template <class T, class Fn, class Reduce>
+  static T parallel_reduce(const Env &env, int64_t begin, int64_t end, int64_t grain,
+                           const T &init, const Fn &fn, const Reduce &reduce) {
+    return TaskPool::ParallelReduce(env.task_pool(), begin, end, grain, init, fn, reduce);
+  }
+};
+
+// An operation which transforms each row on its own, given the same row of its inputs. The
+// OperationManager runs consecutive row operations row by row, so that a chain of them passes over
+// each row while it is in cache instead of streaming the whole matrix once per operation.
+struct RowOperation : Operation {
+  using Operation::Apply;
+
+  bool row_wise() const final {
+    return true;
+  }
+
+  // ApplyRow only reads the state set up by Prepare by default
+  bool row_independent() const override {
+    return true;
+  }
+
+  // Parse args and look up inputs, called once before the rows
+  virtual void Prepare(const Env &env, const std::vector<std::string> &args,
+                       const std::unordered_map<std::string, std::string> &kwargs) {
+    Prepare(env, args);
+  }
+
+  virtual void Prepare(const Env &env, const std::vector<std::string> &args) {}
+
+  virtual void ApplyRow(MatView<float> sig, const Env &env, int di) = 0;
+
+  void Apply(MatView<float> sig, const Env &env, int start_di, int end_di,
+             const std::vector<std::string> &args,
+             const std::unordered_map<std::string, std::string> &kwargs) override {
+    Prepare(env, args, kwargs);
+    for (int di = start_di; di < end_di; ++di) ApplyRow(sig, env, di);
+  }
 };
 
 #define REGISTER_OPERATION(name, cls) REGISTER_FACTORY("operation", cls, cls, name)
@@ -2,6 +2,8 @@
 
 #include <cmath>
 
+#include "yang/util/trace.h"
+
 namespace yang {
 
 OperationFactory *py_op_factory = nullptr;
@@ -17,7 +19,28 @@ void OperationManager::Apply(math::MatView<float> sig, int start_di, int end_di,
 
 void OperationManager::Apply(math::MatView<const float> sig_in, math::MatView<float> sig_out,
                              int start_di, int end_di, const std::vector<OperationDesc> &ops) {
-  ApplyOperations(sig_in, sig_out, start_di, end_di, ops);
+  auto chain = MakeChain(ops);
+  ApplyChain(sig_in, sig_out, start_di, end_di, ops, chain);
+}
+
+void OperationManager::ApplyBatch(const std::vector<math::MatView<const float>> &sigs_in,
+                                  const std::vector<math::MatView<float>> &sigs_out, int start_di,
+                                  int end_di, const std::vector<OperationDesc> &ops,
+                                  TaskPool *pool) {
+  ENSURE(sigs_in.size() == sigs_out.size(), "Batch of {} inputs and {} outputs", sigs_in.size(),
+         sigs_out.size());
+  auto chain = MakeChain(ops);
+  auto apply = [&](int64_t begin, int64_t end) {
+    for (int64_t k = begin; k < end; ++k) {
+      ApplyChain(sigs_in[k], sigs_out[k], start_di, end_di, ops, chain);
+    }
+  };
+  // operations which are not row independent may keep state in Apply
+  if (chain.row_independent) {
+    TaskPool::ParallelFor(pool ? pool : env_->task_pool(), 0, sigs_in.size(), 1, apply);
+  } else {
+    apply(0, sigs_in.size());
+  }
 }
 
 OperationManager::OperationWrapper OperationManager::MakeOperation(const std::string &name) {
@@ -33,20 +56,40 @@ OperationManager::OperationWrapper OperationManager::MakeOperation(const std::st
   return wrapper;
 }
 
-template <class Ops>
-void OperationManager::ApplyOperations(math::MatView<const float> sig_in,
-                                       math::MatView<float> sig_out, int start_di, int end_di,
-                                       const Ops &ops) {
-  bool lookback = false;
-  std::vector<OperationWrapper> op_wrappers;
+OperationManager::Chain OperationManager::MakeChain(const std::vector<OperationDesc> &ops) const {
+  Chain chain;
   for (auto &[op_name, args, kwargs] : ops) {
-    op_wrappers.emplace_back(MakeOperation(op_name));
-    if (op_wrappers.back()->lookback()) lookback = true;
+    chain.ops.emplace_back(MakeOperation(op_name));
+    auto &op = chain.ops.back();
+    if (op->lookback()) chain.lookback = true;
+    if (!op->row_independent()) chain.row_independent = false;
+    if (!op->row_wise()) continue;
+    try {
+      static_cast<RowOperation *>(op.underlying)->Prepare(*env_, args, kwargs);
+    } catch (const std::exception &e) {
+      LOG_ERROR("Failed to apply operation {}({}): {}", op_name, args, e.what());
+      throw;
+    }
   }
-  if (lookback) start_di = 0;
+  return chain;
+}
 
-  if (sig_in != sig_out) {
-    for (int di = start_di; di < end_di; ++di) {
+void OperationManager::ApplyChain(math::MatView<const float> sig_in, math::MatView<float> sig_out,
+                                  int start_di, int end_di, const std::vector<OperationDesc> &ops,
+                                  const Chain &chain) const {
+  if (chain.lookback) start_di = 0;
+
+  // row independent work is split over the runner's workers, rows never depend on the split
+  auto for_rows = [&](bool parallel, const TaskPool::RangeFunc &fn) {
+    if (parallel) {
+      Operation::parallel_for(*env_, start_di, end_di, 0, fn);
+    } else {
+      fn(start_di, end_di);
+    }
+  };
+
+  auto copy_rows = [&](int64_t row_begin, int64_t row_end) {
+    for (int64_t di = row_begin; di < row_end; ++di) {
       for (int ii = 0; ii < sig_in.cols(); ++ii) {
         if (std::isfinite(sig_in(di, ii))) {
           sig_out(di, ii) = sig_in(di, ii);
@@ -55,17 +98,58 @@ void OperationManager::ApplyOperations(math::MatView<const float> sig_in,
         }
       }
     }
-  }
-  for (int i = 0; i < static_cast<int>(ops.size()); ++i) {
-    auto &[op_name, args, kwargs] = ops[i];
-    Operation *op = op_wrappers[i].underlying;
+  };
+  bool pending_copy = sig_in != sig_out;
+
+  int num_ops = ops.size();
+  for (int i = 0; i < num_ops;) {
+    if (!chain.ops[i]->row_wise()) {
+      if (pending_copy) for_rows(true, copy_rows);
+      pending_copy = false;
+      auto &[op_name, args, kwargs] = ops[i];
+      Operation *op = chain.ops[i].underlying;
+      TRACE_SCOPE(op_name, "operation");
+      try {
+        for_rows(op->row_independent(), [&](int64_t row_begin, int64_t row_end) {
+          op->Apply(sig_out, *env_, row_begin, row_end, args, kwargs);
+        });
+      } catch (const std::exception &e) {
+        LOG_ERROR("Failed to apply operation {}({}): {}", op_name, args, e.what());
+        throw;
+      }
+      ++i;
+      continue;
+    }
+
+    // fuse the prepared row operations [i, j), and the copy of the input
+    int j = i;
+    while (j < num_ops && chain.ops[j]->row_wise()) ++j;
+    std::vector<RowOperation *> row_ops;
+    std::string names;
+    bool parallel = true;
+    for (int k = i; k < j; ++k) {
+      auto *op = static_cast<RowOperation *>(chain.ops[k].underlying);
+      row_ops.push_back(op);
+      parallel = parallel && op->row_independent();
+      auto &op_name = std::get<0>(ops[k]);
+      names += names.empty() ? op_name : "," + op_name;
+    }
+    TRACE_SCOPE(names, "operation");
     try {
-      op->Apply(sig_out, *env_, start_di, end_di, args, kwargs);
+      for_rows(parallel, [&](int64_t row_begin, int64_t row_end) {
+        for (int64_t di = row_begin; di < row_end; ++di) {
+          if (pending_copy) copy_rows(di, di + 1);
+          for (auto *op : row_ops) op->ApplyRow(sig_out, *env_, di);
+        }
+      });
     } catch (const std::exception &e) {
-      LOG_ERROR("Failed to apply operation {}({}): {}", op_name, args, e.what());
+      LOG_ERROR("Failed to apply operations {}: {}", names, e.what());
       throw;
     }
+    pending_copy = false;
+    i = j;
   }
+  if (pending_copy) for_rows(true, copy_rows);
 }
 
 OperationManager::OperationWrapper::~OperationWrapper() {
@@ -35,6 +35,13 @@ class OperationManager {
   void Apply(math::MatView<const float> sig_in, math::MatView<float> sig_out, int start_di,
              int end_di, const std::vector<OperationDesc> &ops);
 
+  // Apply ops to each signal, e.g. the alphas of a combo. The operations are made and prepared
+  // once for the batch, and the signals run in parallel on pool, or the pool of the env, when every
+  // operation is row independent.
+  void ApplyBatch(const std::vector<math::MatView<const float>> &sigs_in,
+                  const std::vector<math::MatView<float>> &sigs_out, int start_di, int end_di,
+                  const std::vector<OperationDesc> &ops, TaskPool *pool = nullptr);
+
  private:
   struct OperationWrapper {
     Operation *underlying = nullptr;
@@ -65,11 +72,19 @@ class OperationManager {
     }
   };
 
+  // The operations of ops, with the row operations prepared
+  struct Chain {
+    std::vector<OperationWrapper> ops;
+    bool lookback = false;
+    bool row_independent = true;
+  };
+
   const Env *env_ = nullptr;
 
-  template <class Ops>
-  void ApplyOperations(math::MatView<const float> sig_in, math::MatView<float> sig_out,
-                       int start_di, int end_di, const Ops &ops);
+  Chain MakeChain(const std::vector<OperationDesc> &ops) const;
+
+  void ApplyChain(math::MatView<const float> sig_in, math::MatView<float> sig_out, int start_di,
+                  int end_di, const std::vector<OperationDesc> &ops, const Chain &chain) const;
 
   static OperationWrapper MakeOperation(const std::string &name);
 };
@@ -0,0 +1,234 @@
+#include "yang/sim/pnl_engine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "yang/util/logging.h"
+
+namespace yang {
+
+void PnlStats::Resize(int n) {
+  long_count.assign(n, 0);
+  short_count.assign(n, 0);
+  for (auto *v : {&long_pnl, &short_pnl, &long_val, &short_val, &trade_val, &trade_cost, &pnl, &ret,
+                  &long_ret, &short_ret, &hedge_ret, &ic}) {
+    v->assign(n, 0.);
+  }
+}
+
+PnlStats PnlEngine::Compute(math::MatView<const float> sig, math::MatView<const float> ret,
+                            math::MatView<const float> prc) const {
+  int n = sig.rows();
+  int univ_size = std::min<int>(options_.univ_size, sig.cols());
+  ENSURE(ret.rows() >= n && ret.cols() >= univ_size, "Returns {}x{} too small for signal {}x{}",
+         ret.rows(), ret.cols(), n, univ_size);
+  ENSURE(options_.hedge_ii < ret.cols(), "Invalid hedge column {}", options_.hedge_ii);
+  bool lots = !prc.empty();
+  if (lots) ENSURE(prc.rows() >= n && prc.cols() >= univ_size, "Prices too small");
+  double book_size = options_.book_size;
+
+  PnlStats stats;
+  stats.Resize(n);
+  std::vector<double> prev(univ_size, 0.);
+  std::vector<double> cur(univ_size);
+  for (int di = 0; di < n; ++di) {
+    for (int ii = 0; ii < univ_size; ++ii) {
+      double v = sig(di, ii);
+      if (!std::isfinite(v)) {
+        v = 0;
+      } else if (lots && std::isfinite(prc(di, ii)) && prc(di, ii) > 0) {
+        double lot_val = static_cast<double>(prc(di, ii)) * LOT_SIZE;
+        v = std::round(v / lot_val) * lot_val;
+      }
+      cur[ii] = v;
+    }
+
+    int long_count = 0;
+    int short_count = 0;
+    double long_val = 0;
+    double short_val = 0;
+    double trade_val = 0;
+    double buy_val = 0;
+    double sell_val = 0;
+    double long_pnl = 0;
+    double short_pnl = 0;
+    double xy = 0;
+    double x2 = 0;
+    double y2 = 0;
+    for (int ii = 0; ii < univ_size; ++ii) {
+      double v = cur[ii];
+      double p = prev[ii];
+      if (v > 0) {
+        ++long_count;
+        long_val += v;
+      } else if (v < 0) {
+        ++short_count;
+        short_val += v;
+      }
+      double trade = v - p;
+      trade_val += std::abs(trade);
+      if (trade > 0) {
+        buy_val += trade;
+      } else {
+        sell_val += trade;
+      }
+      if (p != 0) {
+        double pnl = p * ret(di, ii);
+        if (std::isfinite(pnl)) (p > 0 ? long_pnl : short_pnl) += pnl;
+      }
+      if (di > 0) {
+        double x = sig(di - 1, ii);
+        double y = ret(di, ii);
+        if (std::isfinite(x) && std::isfinite(y)) {
+          xy += x * y;
+          x2 += x * x;
+          y2 += y * y;
+        }
+      }
+    }
+
+    double trade_cost = di > 0 ? -options_.buy_fee * buy_val + options_.sell_fee * sell_val : 0;
+    double pnl = long_pnl + short_pnl + trade_cost;
+    stats.long_count[di] = long_count;
+    stats.short_count[di] = short_count;
+    stats.long_val[di] = long_val;
+    stats.short_val[di] = short_val;
+    stats.trade_val[di] = trade_val;
+    stats.trade_cost[di] = trade_cost;
+    stats.long_pnl[di] = long_pnl;
+    stats.short_pnl[di] = short_pnl;
+    stats.pnl[di] = pnl;
+    stats.ret[di] = pnl / book_size;
+    stats.long_ret[di] = long_pnl / book_size;
+    stats.short_ret[di] = short_pnl / book_size;
+    if (di == 0) {
+      stats.hedge_ret[di] = 0;
+    } else if (options_.hedge_ii >= 0) {
+      stats.hedge_ret[di] = stats.long_ret[di] - ret(di, options_.hedge_ii);
+    } else {
+      stats.hedge_ret[di] = NAN;
+    }
+    if (di > 0) stats.ic[di] = x2 == 0 || y2 == 0 ? NAN : xy / std::sqrt(x2 * y2);
+    std::swap(prev, cur);
+  }
+  return stats;
+}
+
+std::vector<PnlStats> PnlEngine::Compute(const std::vector<math::MatView<const float>> &sigs,
+                                         math::MatView<const float> ret,
+                                         math::MatView<const float> prc, TaskPool *pool) const {
+  std::vector<PnlStats> stats(sigs.size());
+  TaskPool::ParallelFor(pool, 0, sigs.size(), 1, [&](int64_t begin, int64_t end) {
+    for (int64_t k = begin; k < end; ++k) stats[k] = Compute(sigs[k], ret, prc);
+  });
+  return stats;
+}
+
+PnlSummary PnlEngine::Summarize(const PnlStats &stats, int start, int end) const {
+  ENSURE(0 <= start && start <= end && end < stats.size(), "Invalid range [{}, {}] of {} days",
+         start, end, stats.size());
+  PnlSummary sum;
+  sum.start = start;
+  sum.end = end;
+  sum.count = end - start + 1;
+  sum.max_dd_start = start;
+  sum.max_dd_end = start;
+
+  int ret_count = 0;
+  double ret_sum = 0;
+  int hedge_count = 0;
+  int ic_count = 0;
+  // drawdown as in the python pnl metrics: the running loss since the cumulative return was last
+  // non-negative
+  double dd = 0;
+  double min_dd = 0;
+  int dd_start = start;
+  int dd_end = start;
+  for (int di = start; di <= end; ++di) {
+    sum.long_count += stats.long_count[di];
+    sum.short_count += stats.short_count[di];
+    sum.long_val += stats.long_val[di];
+    sum.short_val += stats.short_val[di];
+    sum.trade_val += stats.trade_val[di];
+    sum.trade_cost += stats.trade_cost[di];
+    sum.long_pnl += stats.long_pnl[di];
+    sum.short_pnl += stats.short_pnl[di];
+    sum.pnl += stats.pnl[di];
+    sum.long_ret += stats.long_ret[di];
+    sum.short_ret += stats.short_ret[di];
+    if (stats.pnl[di] > 0) ++sum.up_days;
+    if (stats.pnl[di] < 0) ++sum.down_days;
+    if (std::isfinite(stats.hedge_ret[di])) {
+      sum.hedge_ret += stats.hedge_ret[di];
+      ++hedge_count;
+    }
+    if (std::isfinite(stats.ic[di])) {
+      sum.ic += stats.ic[di];
+      ++ic_count;
+    }
+
+    double ret = stats.ret[di];
+    if (std::isfinite(ret)) {
+      ret_sum += ret;
+      ++ret_count;
+    }
+    dd += ret;
+    if (dd < 0) {
+      if (dd_end != di - 1) dd_start = di;
+      dd_end = di;
+      if (dd < min_dd) {
+        min_dd = dd;
+        sum.max_dd_start = dd_start;
+        sum.max_dd_end = dd_end;
+      }
+    } else {
+      dd = 0;
+    }
+  }
+
+  double annual = static_cast<double>(options_.days_per_year) * options_.intervals_per_day;
+  sum.long_count /= sum.count;
+  sum.short_count /= sum.count;
+  sum.long_val /= sum.count;
+  sum.short_val /= sum.count;
+  sum.trade_val /= sum.count;
+  sum.long_ret = sum.long_ret / sum.count * annual;
+  sum.short_ret = sum.short_ret / sum.count * annual;
+  sum.ret = ret_count > 0 ? ret_sum / ret_count * annual : NAN;
+  sum.hedge_ret = hedge_count > 0 ? sum.hedge_ret / hedge_count * annual : NAN;
+  sum.ic = ic_count > 0 ? sum.ic / ic_count : NAN;
+  sum.tvr = sum.trade_val / options_.book_size;
+  sum.max_dd = -min_dd * 100;
+
+  // sample std of the returns, a second pass is more accurate than a running sum of squares
+  double mean = ret_count > 0 ? ret_sum / ret_count : NAN;
+  double var = 0;
+  for (int di = start; di <= end; ++di) {
+    if (std::isfinite(stats.ret[di])) var += (stats.ret[di] - mean) * (stats.ret[di] - mean);
+  }
+  sum.std = ret_count > 1 ? std::sqrt(var / (ret_count - 1)) : NAN;
+  sum.ir = mean / sum.std * std::sqrt(options_.intervals_per_day);
+  return sum;
+}
+
+std::vector<PnlSummary> PnlEngine::SummarizeYearly(const PnlStats &stats,
+                                                   const std::vector<int64_t> &dates,
+                                                   bool include_total) const {
+  ENSURE(static_cast<int>(dates.size()) == stats.size(), "{} dates for {} days of stats",
+         dates.size(), stats.size());
+  std::vector<PnlSummary> ret;
+  if (dates.empty()) return ret;
+  // yyyymmddHHMM for intraday dates
+  int64_t year_multiplier = dates[0] >= 10000000000 ? 100000000 : 10000;
+  int start = 0;
+  for (int di = 1; di <= stats.size(); ++di) {
+    if (di == stats.size() || dates[di] / year_multiplier != dates[start] / year_multiplier) {
+      ret.push_back(Summarize(stats, start, di - 1));
+      start = di;
+    }
+  }
+  if (include_total) ret.push_back(Summarize(stats, 0, stats.size() - 1));
+  return ret;
+}
+
+}  // namespace yang
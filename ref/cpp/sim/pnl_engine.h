@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "yang/math/mat_view.h"
+#include "yang/util/task_pool.h"
+
+namespace yang {
+
+// Daily statistics of a signal held from each day to the next, values are in book currency and
+// the returns are relative to the book size
+struct PnlStats {
+  std::vector<int> long_count;
+  std::vector<int> short_count;
+  std::vector<double> long_pnl;
+  std::vector<double> short_pnl;
+  std::vector<double> long_val;
+  std::vector<double> short_val;
+  std::vector<double> trade_val;
+  std::vector<double> trade_cost;
+  std::vector<double> pnl;
+  std::vector<double> ret;
+  std::vector<double> long_ret;
+  std::vector<double> short_ret;
+  std::vector<double> hedge_ret;  // long_ret over the hedge instrument
+  std::vector<double> ic;         // cosine of the previous signal and the returns
+
+  int size() const {
+    return pnl.size();
+  }
+
+  void Resize(int n);
+};
+
+// Statistics of the days [start, end] of PnlStats. Counts and values are daily means, pnls and
+// costs are sums and returns are annualized.
+struct PnlSummary {
+  int start = 0;
+  int end = 0;
+  int count = 0;
+  double long_count = 0;
+  double short_count = 0;
+  double long_pnl = 0;
+  double short_pnl = 0;
+  double long_val = 0;
+  double short_val = 0;
+  double trade_val = 0;
+  double trade_cost = 0;
+  double pnl = 0;
+  double ret = 0;
+  double long_ret = 0;
+  double short_ret = 0;
+  double hedge_ret = 0;
+  double tvr = 0;
+  double std = 0;
+  double ir = 0;
+  double ic = 0;
+  int up_days = 0;
+  int down_days = 0;
+  double max_dd = 0;  // in percent of the book
+  int max_dd_start = 0;
+  int max_dd_end = 0;
+};
+
+struct PnlOptions {
+  int univ_size = 0;
+  double book_size = 0;
+  // column of the returns of the hedge instrument, e.g. the benchmark index, -1 for none
+  int hedge_ii = -1;
+  // fees of the traded value, 0 for no trading cost
+  double buy_fee = 0;
+  double sell_fee = 0;
+  int days_per_year = 250;
+  int intervals_per_day = 1;
+};
+
+// Computes the pnl statistics of signals against returns, where ret(di, ii) is the return of
+// instrument ii from di - 1 to di. Each signal is streamed row by row once, so signals can be
+// mmapped arrays, and batches of signals are spread over a TaskPool.
+class PnlEngine {
+ public:
+  // Positions are rounded to lots of this many shares when prices are given
+  static constexpr int LOT_SIZE = 100;
+
+  explicit PnlEngine(PnlOptions options) : options_(options) {}
+
+  const PnlOptions &options() const {
+    return options_;
+  }
+
+  // prc, if not empty, rounds the positions to lots at these prices
+  PnlStats Compute(math::MatView<const float> sig, math::MatView<const float> ret,
+                   math::MatView<const float> prc = {}) const;
+
+  std::vector<PnlStats> Compute(const std::vector<math::MatView<const float>> &sigs,
+                                math::MatView<const float> ret, math::MatView<const float> prc,
+                                TaskPool *pool) const;
+
+  PnlSummary Summarize(const PnlStats &stats, int start, int end) const;
+
+  // A summary for each year of dates, i.e. yyyymmdd or yyyymmddHHMM of each day of stats, and
+  // one for all days if include_total
+  std::vector<PnlSummary> SummarizeYearly(const PnlStats &stats,
+                                          const std::vector<int64_t> &dates,
+                                          bool include_total) const;
+
+ private:
+  PnlOptions options_;
+};
+
+}  // namespace yang
@@ -0,0 +1,148 @@
+#include "yang/sim/prefetcher.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "yang/data/array.h"
+#include "yang/util/logging.h"
+#include "yang/util/unordered_set.h"
+
+namespace yang {
+
+Prefetcher::Prefetcher(const DataDirectory *cache_dir, std::string_view workdir, int num_threads)
+    : cache_dir_(cache_dir), workdir_(workdir) {
+  ENSURE(num_threads > 0, "Invalid prefetch threads: {}", num_threads);
+  if (!fs::exists(workdir_)) fs::create_directories(workdir_);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back([this]() { Work(); });
+  }
+}
+
+Prefetcher::~Prefetcher() {
+  Stop();
+}
+
+void Prefetcher::Stop() {
+  {
+    std::lock_guard guard(mutex_);
+    if (stop_) return;
+    stop_ = true;
+    requests_.clear();
+  }
+  cv_.notify_all();
+  for (auto &t : threads_) t.join();
+  threads_.clear();
+}
+
+void Prefetcher::Prefetch(std::string_view data, int start_row, int end_row) {
+  start_row = std::max(start_row, 0);
+  if (start_row >= end_row) return;
+
+  auto path = cache_dir_->GetReadPath(data);
+  {
+    std::lock_guard guard(mutex_);
+    if (stop_) return;
+    auto [it, inserted] = requested_.emplace(path, std::make_pair(start_row, end_row));
+    if (!inserted) {
+      auto &range = it->second;
+      if (range.first <= start_row && range.second >= end_row) return;
+      range.first = std::min(range.first, start_row);
+      range.second = std::max(range.second, end_row);
+    }
+    requests_.push_back({std::move(path), start_row, end_row});
+  }
+  cv_.notify_one();
+}
+
+void Prefetcher::PrefetchModule(std::string_view mod, std::vector<std::string> declared,
+                                int start_row, int end_row) {
+  {
+    std::lock_guard guard(mutex_);
+    if (stop_) return;
+    requests_.push_back({std::string(mod), start_row, end_row, true, std::move(declared)});
+  }
+  cv_.notify_one();
+}
+
+void Prefetcher::ClearRequested() {
+  std::lock_guard guard(mutex_);
+  requested_.clear();
+}
+
+std::vector<std::string> Prefetcher::GetReadSet(std::string_view mod,
+                                                const std::vector<std::string> &declared) {
+  unordered_set<std::string> seen;
+  std::vector<std::string> read_set;
+  auto add = [&](const std::string &data) {
+    if (data.empty() || data.find('/') == std::string::npos) return;
+    if (seen.insert(data).second) read_set.push_back(data);
+  };
+  for (auto &data : declared) add(data);
+
+  std::ifstream ifs(GetLogPath(mod));
+  std::string line;
+  while (std::getline(ifs, line)) add(line);
+  return read_set;
+}
+
+void Prefetcher::SaveAccessLog(std::string_view mod, const std::vector<std::string> &accessed) {
+  if (accessed.empty()) return;
+  std::ofstream ofs(GetLogPath(mod));
+  for (auto &data : accessed) ofs << data << '\n';
+  if (!ofs.good()) LOG_ERROR("Failed to save access log for {}", mod);
+}
+
+void Prefetcher::Work() {
+  while (true) {
+    Request req;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this]() { return stop_ || !requests_.empty(); });
+      if (stop_) return;
+      req = std::move(requests_.front());
+      requests_.pop_front();
+    }
+    // prefetching is best effort only
+    try {
+      if (req.module) {
+        auto read_set = GetReadSet(req.path, req.declared);
+        LOG_DEBUG("Prefetching {} arrays for {} ({} - {})", read_set.size(), req.path,
+                  req.start_row, req.end_row);
+        for (auto &data : read_set) Prefetch(data, req.start_row, req.end_row);
+        continue;
+      }
+      PrefetchFile(req);
+    } catch (const std::exception &ex) {
+      LOG_DEBUG("Failed to prefetch {}: {}", req.path, ex.what());
+    }
+  }
+}
+
+void Prefetcher::PrefetchFile(const Request &req) {
+  detail::ArrayMeta meta;
+  // not an array, e.g. an index
+  if (!meta.Load(req.path + ".meta") || meta.shape.empty()) return;
+
+  int fd = open(req.path.c_str(), O_RDONLY);
+  if (fd == -1) return;
+
+  off_t row_bytes = meta.item_size;
+  for (int i = 1; i < static_cast<int>(meta.shape.size()); ++i) row_bytes *= meta.shape[i];
+  off_t end_row = std::min<off_t>(req.end_row, meta.shape[0]);
+  if (!meta.compression.empty()) {
+    // compressed arrays are decompressed as a whole, rows do not map to file offsets
+    int ret = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    if (ret != 0) LOG_DEBUG("Failed to prefetch {}: {}", req.path, GetErrorString(ret));
+  } else if (req.start_row < end_row) {
+    off_t offset = req.start_row * row_bytes;
+    off_t len = (end_row - req.start_row) * row_bytes;
+    int ret = posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+    if (ret != 0) LOG_DEBUG("Failed to prefetch {}: {}", req.path, GetErrorString(ret));
+  }
+  close(fd);
+}
+
+}  // namespace yang
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "yang/sim/data_directory.h"
+#include "yang/util/fs.h"
+#include "yang/util/unordered_map.h"
+
+namespace yang {
+
+// Warms up the page cache for arrays which are about to be read.
+//
+// Requests are served by background threads with posix_fadvise(WILLNEED), which only touches the
+// byte range of the requested rows. The read set of a module is either declared in its config
+// (`reads`) or learned from the access log saved by the previous run, and is resolved by the
+// background threads too, so requesting never does file I/O on the caller's thread.
+class Prefetcher {
+ public:
+  Prefetcher(const DataDirectory *cache_dir, std::string_view workdir, int num_threads = 2);
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher &) = delete;
+  Prefetcher &operator=(const Prefetcher &) = delete;
+
+  // Prefetch rows [start_row, end_row) of data (in "mod/data" format) asynchronously
+  void Prefetch(std::string_view data, int start_row, int end_row);
+
+  // Prefetch the declared and the previously recorded read set of mod asynchronously
+  void PrefetchModule(std::string_view mod, std::vector<std::string> declared, int start_row,
+                      int end_row);
+
+  std::vector<std::string> GetReadSet(std::string_view mod,
+                                      const std::vector<std::string> &declared);
+
+  // Save the data accessed by a run of mod, see Module::TakeAccessLog, so that the next run can
+  // prefetch it
+  void SaveAccessLog(std::string_view mod, const std::vector<std::string> &accessed);
+
+  // Forget the requested row ranges, e.g. at the start of a run since the data may have changed
+  void ClearRequested();
+
+  void Stop();
+
+ private:
+  struct Request {
+    std::string path;  // or the module name of a module request
+    int start_row;
+    int end_row;
+    bool module = false;
+    std::vector<std::string> declared;
+  };
+
+  const DataDirectory *cache_dir_;
+  fs::path workdir_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> requests_;
+  bool stop_ = false;
+  // row ranges already requested, keyed by path
+  unordered_map<std::string, std::pair<int, int>> requested_;
+
+  void Work();
+
+  static void PrefetchFile(const Request &req);
+
+  std::string GetLogPath(std::string_view mod) const {
+    return (workdir_ / mod).native();
+  }
+};
+
+}  // namespace yang
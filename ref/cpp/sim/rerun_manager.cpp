@@ -1,6 +1,9 @@
 #include "yang/sim/rerun_manager.h"
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
+#include <map>
 
 #include "yang/util/config.h"
 #include "yang/util/datetime.h"
@@ -13,9 +16,10 @@ void RerunManager::Initialize(std::string_view workdir) {
   if (!fs::exists(workdir_)) fs::create_directories(workdir_);
 }
 
-void RerunManager::SetDates(int64_t start_date, int64_t end_date) {
+void RerunManager::SetDates(int64_t start_date, int64_t end_date, int end_di) {
   start_date_ = start_date;
   end_date_ = end_date;
+  end_di_ = end_di;
 }
 
 bool RerunManager::CanSkipRun(std::string_view mod, const std::vector<std::string> &deps) {
@@ -31,35 +35,138 @@ bool RerunManager::CanSkipRun(std::string_view mod, const std::vector<std::strin
   return true;
 }
 
+RerunManager::Decision RerunManager::Check(std::string_view mod, const ModInfo &info,
+                                           const std::vector<std::string> &deps,
+                                           const std::function<int(int64_t)> &first_changed_row) {
+  auto meta = GetMeta(mod);
+  auto full = [&](std::string_view reason) {
+    LOG_DEBUG("Full rerun of {}: {}", mod, reason);
+    return Decision{Action::FULL, 0};
+  };
+  if (meta.timestamp == 0) return full("no previous run");
+  if (meta.start_date != start_date_) return full("start date changed");
+  if (meta.info.config_hash != info.config_hash) return full("config changed");
+  if (meta.info.code_version != info.code_version) return full("code changed");
+
+  // the first date index whose inputs differ from the last run
+  constexpr int none = std::numeric_limits<int>::max();
+  int start_di = none;
+  if (meta.end_date < end_date_) start_di = meta.end_di;
+  int deps_start_di = none;
+  for (auto &dep : deps) {
+    auto dep_meta = GetMeta(dep);
+    auto it = meta.dep_fingerprints.find(dep);
+    if (it == meta.dep_fingerprints.end()) {
+      // recorded without dep fingerprints
+      if (dep_meta.timestamp > meta.timestamp) return full(fmt::format("dep {} changed", dep));
+    } else if (dep_meta.GetDepFingerprint() != it->second) {
+      if (dep_meta.timestamp == 0) return full(fmt::format("dep {} removed", dep));
+      auto changed_from_di = dep_meta.GetChangedFrom(it->second);
+      if (!changed_from_di) return full(fmt::format("dep {} changed too often", dep));
+      deps_start_di = std::min(deps_start_di, *changed_from_di);
+    }
+  }
+  if (deps_start_di != none && first_changed_row) {
+    // both are lower bounds of the first input row that differs
+    deps_start_di = std::max(deps_start_di, first_changed_row(meta.timestamp));
+  }
+  start_di = std::min(start_di, deps_start_di);
+
+  if (start_di == none) return {Action::SKIP, 0};
+  if (start_di <= 0) return full("deps changed from the start");
+  return {Action::EXTEND, start_di};
+}
+
 void RerunManager::RecordBeforeRun(std::string_view mod) {
+  auto history = GetMeta(mod).history;
   auto meta_path = GetMetaPath(mod);
   if (fs::exists(meta_path)) {
     fs::remove(meta_path);
   }
+  std::lock_guard guard(mutex_);
+  // dependents checked during the run must not see the old meta
+  mods_.erase(mod);
+  run_start_timestamps_[mod] = GetTimestamp();
+  run_histories_[mod] = std::move(history);
 }
 
 void RerunManager::RecordRun(std::string_view mod) {
-  SaveMeta(mod);
+  SaveMeta(mod, ModMeta());
 }
 
-void RerunManager::SaveMeta(std::string_view mod) {
+void RerunManager::RecordRun(std::string_view mod, const ModInfo &info,
+                             const std::vector<std::string> &deps, int changed_from_di,
+                             uint64_t fingerprint) {
   ModMeta meta;
+  meta.info = info;
+  meta.changed_from_di = changed_from_di;
+  meta.fingerprint = fingerprint;
+  for (auto &dep : deps) {
+    meta.dep_fingerprints[dep] = GetMeta(dep).GetDepFingerprint();
+  }
+  SaveMeta(mod, std::move(meta));
+}
+
+void RerunManager::SaveMeta(std::string_view mod, ModMeta meta) {
   meta.timestamp = GetTimestamp();
   meta.start_date = start_date_;
   meta.end_date = end_date_;
+  meta.end_di = end_di_;
+  {
+    std::lock_guard guard(mutex_);
+    auto it = run_start_timestamps_.find(mod);
+    if (it != run_start_timestamps_.end()) {
+      meta.duration = (meta.timestamp - it->second) / 1e9;
+      run_start_timestamps_.erase(it);
+    }
+    auto history_it = run_histories_.find(mod);
+    if (history_it != run_histories_.end()) {
+      meta.history = std::move(history_it->second);
+      run_histories_.erase(history_it);
+    }
+  }
+  meta.history.push_back({meta.GetDepFingerprint(), meta.changed_from_di});
+  if (meta.history.size() > MAX_HISTORY) {
+    meta.history.erase(meta.history.begin(), meta.history.end() - MAX_HISTORY);
+  }
 
   Config yaml;
   yaml.Set("timestamp", meta.timestamp);
   yaml.Set("start_date", meta.start_date);
   yaml.Set("end_date", meta.end_date);
+  yaml.Set("end_di", meta.end_di);
+  yaml.Set("changed_from_di", meta.changed_from_di);
+  yaml.Set("duration", meta.duration);
+  yaml.Set("fingerprint", meta.fingerprint);
+  yaml.Set("config_hash", meta.info.config_hash);
+  yaml.Set("code_version", meta.info.code_version);
+  yaml.Set("deps", std::map<std::string, uint64_t>(meta.dep_fingerprints.begin(),
+                                                   meta.dep_fingerprints.end()));
+  std::vector<uint64_t> history_fingerprints;
+  std::vector<int> history_changed_from_di;
+  for (auto &change : meta.history) {
+    history_fingerprints.push_back(change.fingerprint);
+    history_changed_from_di.push_back(change.changed_from_di);
+  }
+  yaml.Set("history_fingerprints", history_fingerprints);
+  yaml.Set("history_changed_from_di", history_changed_from_di);
   std::ofstream ofs(GetMetaPath(mod));
   ofs << yaml.ToYamlString();
   ENSURE2(ofs.good());
 
   {
     std::lock_guard guard(mutex_);
-    mods_[mod] = meta;
+    mods_[mod] = std::move(meta);
+  }
+}
+
+std::optional<int> RerunManager::ModMeta::GetChangedFrom(uint64_t dep_fingerprint) const {
+  int ret = std::numeric_limits<int>::max();
+  for (auto it = history.rbegin(); it != history.rend(); ++it) {
+    if (it->fingerprint == dep_fingerprint) return ret;
+    ret = std::min(ret, it->changed_from_di);
   }
+  return std::nullopt;
 }
 
 RerunManager::ModMeta RerunManager::GetMeta(std::string_view mod) {
@@ -77,6 +184,23 @@ RerunManager::ModMeta RerunManager::GetMeta(std::string_view mod) {
       meta.timestamp = yaml.Get<int64_t>("timestamp");
       meta.start_date = yaml.Get<int64_t>("start_date");
       meta.end_date = yaml.Get<int64_t>("end_date");
+      meta.end_di = yaml.Get<int>("end_di", 0);
+      meta.changed_from_di = yaml.Get<int>("changed_from_di", 0);
+      meta.duration = yaml.Get<double>("duration", 0);
+      meta.fingerprint = yaml.Get<uint64_t>("fingerprint", 0);
+      meta.info.config_hash = yaml.Get<uint64_t>("config_hash", 0);
+      meta.info.code_version = yaml.Get<std::string>("code_version", "");
+      if (auto deps = yaml["deps"]) {
+        for (auto &[dep, fingerprint] : deps.as<std::map<std::string, uint64_t>>()) {
+          meta.dep_fingerprints[dep] = fingerprint;
+        }
+      }
+      auto history_fingerprints = yaml.Get<std::vector<uint64_t>>("history_fingerprints", {});
+      auto history_changed_from_di = yaml.Get<std::vector<int>>("history_changed_from_di", {});
+      ENSURE2(history_fingerprints.size() == history_changed_from_di.size());
+      for (size_t i = 0; i < history_fingerprints.size(); ++i) {
+        meta.history.push_back({history_fingerprints[i], history_changed_from_di[i]});
+      }
     } catch (const std::exception &ex) {
       LOG_ERROR("Failed to load meta: {}", meta_path);
       meta = ModMeta();
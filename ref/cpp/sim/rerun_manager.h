@@ -1,6 +1,8 @@
 #pragma once
 
+#include <functional>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -10,33 +12,113 @@
 
 namespace yang {
 
-// TODO: the rules are very simple now and do not work in all cases, e.g. live
+// Decides whether a module has to run again, based on what it was built from in the last run: the
+// dates, a hash of its config, the build id of its code and the fingerprints of its deps' outputs.
+//
+// Each run records a fingerprint of the module's outputs, see Env::GetContentFingerprint, and the
+// first date index whose outputs were recomputed. A dep that ran again with the same outputs does
+// not trigger a rerun. A module whose config and code are unchanged only needs to recompute from
+// the earliest of its old end and the changed dates of its deps over all of their runs since its
+// own, i.e. it can be extended instead of rebuilt.
+// TODO: the rules do not work in all cases, e.g. live
 class RerunManager {
  public:
+  enum class Action {
+    SKIP = 0,
+    EXTEND,  // recompute from start_di
+    FULL,
+  };
+
+  struct Decision {
+    Action action = Action::FULL;
+    int start_di = 0;
+  };
+
+  // What a module is built from besides its deps' outputs
+  struct ModInfo {
+    uint64_t config_hash = 0;
+    // build id of the module's library, or the module's `code_version` config
+    std::string code_version;
+  };
+
   void Initialize(std::string_view workdir);
 
-  void SetDates(int64_t start_date, int64_t end_date);
+  // Date range of the run, end_di is the number of dates up to end_date
+  void SetDates(int64_t start_date, int64_t end_date, int end_di);
 
   bool CanSkipRun(std::string_view mod, const std::vector<std::string> &deps);
 
+  // first_changed_row(since), if set, returns the first row of the inputs of mod that changed
+  // after the timestamp since, or INT_MAX if none did, e.g. from their row versions. It narrows
+  // the range recomputed for changed deps.
+  Decision Check(std::string_view mod, const ModInfo &info, const std::vector<std::string> &deps,
+                 const std::function<int(int64_t since)> &first_changed_row = {});
+
   void RecordBeforeRun(std::string_view mod);
 
   void RecordRun(std::string_view mod);
 
+  // changed_from_di is the first date index whose outputs were recomputed, fingerprint the hash of
+  // the outputs, 0 if unknown
+  void RecordRun(std::string_view mod, const ModInfo &info, const std::vector<std::string> &deps,
+                 int changed_from_di, uint64_t fingerprint = 0);
+
+  // Timestamp of the last recorded run of mod, 0 if never run. Rows of its inputs with a newer
+  // row version changed after that run, see Env::GetChangedRows.
+  int64_t GetLastRunTimestamp(std::string_view mod) {
+    return GetMeta(mod).timestamp;
+  }
+
+  // Duration of the last recorded run of mod in seconds, 0 if unknown
+  double GetLastRunDuration(std::string_view mod) {
+    return GetMeta(mod).duration;
+  }
+
  private:
+  // Output fingerprint and changed_from_di of a run
+  struct RunChange {
+    uint64_t fingerprint = 0;
+    int changed_from_di = 0;
+  };
+
   struct ModMeta {
     int64_t timestamp = 0;
     int64_t start_date = 0;
     int64_t end_date = 0;
+    int end_di = 0;
+    int changed_from_di = 0;
+    double duration = 0;
+    uint64_t fingerprint = 0;
+    ModInfo info;
+    // dep fingerprints the run was built from, see GetDepFingerprint
+    unordered_map<std::string, uint64_t> dep_fingerprints;
+    // the last runs, oldest first, so that dependents which missed some of them still recompute
+    // from the earliest change
+    std::vector<RunChange> history;
+
+    // Output fingerprint, or the timestamp if unknown, as recorded by dependents
+    uint64_t GetDepFingerprint() const {
+      return fingerprint != 0 ? fingerprint : timestamp;
+    }
+
+    // The earliest changed_from_di of the runs after the one with dep_fingerprint, empty if that
+    // run is no longer in the history
+    std::optional<int> GetChangedFrom(uint64_t dep_fingerprint) const;
   };
 
+  static constexpr int MAX_HISTORY = 16;
+
   fs::path workdir_;
   unordered_map<std::string, ModMeta> mods_;
+  unordered_map<std::string, int64_t> run_start_timestamps_;
+  // history of the modules being run, whose metas are removed until they finish
+  unordered_map<std::string, std::vector<RunChange>> run_histories_;
   std::mutex mutex_;
   int64_t start_date_ = 0;
   int64_t end_date_ = 0;
+  int end_di_ = 0;
 
-  void SaveMeta(std::string_view mod);
+  void SaveMeta(std::string_view mod, ModMeta meta);
 
   ModMeta GetMeta(std::string_view mod);
 
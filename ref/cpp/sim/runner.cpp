@@ -1,90 +1,84 @@
 #include "yang/sim/runner.h"
 
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <string>
+#include <typeinfo>
 
 #include "yang/sim/module.h"
 #include "yang/sim/scheduler.h"
+#include "yang/util/datetime.h"
 #include "yang/util/factory_registry.h"
+#include "yang/util/hash.h"
 #include "yang/util/logging.h"
 #include "yang/util/module_loader.h"
+#include "yang/util/trace.h"
 #include "yang/util/unordered_map.h"
 #include "yang/util/unordered_set.h"
 
 namespace yang {
 
+static int64_t GetThreadMajorFaults() {
+  rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) return 0;
+  return usage.ru_majflt;
+}
+
+Runner::~Runner() {
+  Shutdown();
+}
+
 void Runner::Run(RunnerOptions options, const Config &config, int num_threads) {
-  std::vector<void *> libs;
+  Initialize(options, config, num_threads);
+  RunStages(options_.stages);
+  Shutdown();
+}
+
+void Runner::Initialize(RunnerOptions options, const Config &config, int num_threads) {
+  options_ = std::move(options);
+  config_ = config;
   for (auto &lib : config.Get<std::vector<std::string>>("libs", {})) {
     auto handle = ModuleLoader::Load(lib);
     ENSURE2(handle != nullptr);
-    libs.push_back(handle);
+    libs_.push_back(handle);
   }
 
   LOG_INFO("Running ({} threads)", num_threads);
-  std::unique_ptr<Env> env(FactoryRegistry::Make<Env>("env", config.Get<std::string>("env")));
+  env_.reset(FactoryRegistry::Make<Env>("env", config.Get<std::string>("env")));
   LOG_INFO("daily: {}", config.Get<bool>("daily", true));
-  LOG_INFO("live: {}", options.live);
-  env->set_live(options.live);
-  LOG_INFO("prod: {}", options.prod);
-  env->set_prod(options.prod);
-
-  env->Initialize(config);
-  if (!env->user_mode() && options.stages.count(RunStage::PREPARE)) {
-    env->Build();
+  LOG_INFO("live: {}", options_.live);
+  env_->set_live(options_.live);
+  LOG_INFO("prod: {}", options_.prod);
+  env_->set_prod(options_.prod);
+
+  env_->Initialize(config);
+  if (!env_->user_mode() && options_.stages.count(RunStage::PREPARE)) {
+    env_->Build();
   } else {
-    env->Load();
+    env_->Load();
   }
+  refresh_env_ = false;
 
-  LOG_INFO("univ_start_datetime: {}", env->univ_start_datetime());
-  LOG_INFO("univ_end_datetime: {}", env->univ_end_datetime());
-  LOG_INFO("sim_start_datetime: {}", env->sim_start_datetime());
-  LOG_INFO("sim_end_datetime: {}", env->sim_end_datetime());
+  LOG_INFO("univ_start_datetime: {}", env_->univ_start_datetime());
+  LOG_INFO("univ_end_datetime: {}", env_->univ_end_datetime());
+  LOG_INFO("sim_start_datetime: {}", env_->sim_start_datetime());
+  LOG_INFO("sim_end_datetime: {}", env_->sim_end_datetime());
 
   auto load_mod = [&](const auto &name, const Config &config) {
     std::unique_ptr<Module> mod(
         FactoryRegistry::Make<Module>("module", config.Get<std::string>("class")));
-    mod->Initialize(name, config, env.get());
+    mod->Initialize(name, config, env_.get());
     return mod;
   };
 
   std::unique_ptr<Module> base_data;
-  std::vector<std::unique_ptr<Module>> mods;
-  unordered_map<std::string, std::vector<std::string>> mod_deps;
   unordered_set<std::string> run_modules(config.Get<std::vector<std::string>>("run_modules", {}));
-  unordered_set<std::string> always_run_mods(
+  always_run_mods_ = unordered_set<std::string>(
       config.Get<std::vector<std::string>>("always_run_modules", {}));
 
-  auto run_mod = [&](auto &mod) {
-    // check stage
-    auto stages = mod->config("stages", std::vector<std::string>{"intraday"});
-    std::set<RunStage> stages_to_run;
-    for (auto &s : stages) {
-      auto stage_val = ParseRunStage(s);
-      if (options.stages.count(stage_val)) stages_to_run.insert(stage_val);
-    }
-    if (stages_to_run.empty()) return;
-
-    if (env->rerun_manager()) {
-      if (!always_run_mods.count(mod->name()) &&
-          env->rerun_manager()->CanSkipRun(mod->name(), mod_deps[mod->name()])) {
-        LOG_DEBUG("Skip module {}: already built", mod->name());
-        return;
-      }
-      env->rerun_manager()->RecordBeforeRun(mod->name());
-    }
-
-    for (auto stage : stages_to_run) {
-      LOG_INFO("Running module {} - {}", mod->name(), ToString(stage));
-      mod->set_stage(stage);
-      mod->Run();
-    }
-    LOG_INFO("Finished module {}", mod->name());
-
-    if (env->rerun_manager()) {
-      env->rerun_manager()->RecordRun(mod->name());
-    }
-  };
-
   for (auto mod_config : config["modules"]) {
     // check lang
     if (mod_config.Get<std::string>("lang") != "cpp") continue;
@@ -92,32 +86,232 @@ void Runner::Run(RunnerOptions options, const Config &config, int num_threads) {
     auto name = mod_config.Get<std::string>("name");
     if (!run_modules.empty() && !run_modules.count(name)) continue;
     auto mod = load_mod(name, mod_config);
+    // modules computing each date from its inputs and lookback may split their date range, the
+    // extra instances run the other shards
+    int num_shards = mod_config.Get("shards", 1);
+    for (int k = 1; k < num_shards; ++k) {
+      shard_mods_[name].emplace_back(load_mod(name, mod_config));
+    }
     if (name == "base") {
       base_data = std::move(mod);
     } else {
-      mods.emplace_back(std::move(mod));
-      mod_deps[name] = mod_config.Get<std::vector<std::string>>("deps", {});
+      mods_.emplace_back(std::move(mod));
+      mod_deps_[name] = mod_config.Get<std::vector<std::string>>("deps", {});
     }
   }
 
   if (base_data) {
-    for (auto &[_, deps] : mod_deps) {
+    for (auto &[_, deps] : mod_deps_) {
       deps.push_back("base");
     }
-    mods.emplace_back(std::move(base_data));
+    mods_.emplace_back(std::move(base_data));
+  }
+
+  // modules share the scheduler's workers for their parallel loops
+  pool_ = std::make_unique<TaskPool>(std::max(num_threads, 1));
+}
+
+void Runner::RunModule(Module &mod, const std::set<RunStage> &stages) {
+  // check stage
+  auto mod_stages = mod.config("stages", std::vector<std::string>{"intraday"});
+  std::set<RunStage> stages_to_run;
+  for (auto &s : mod_stages) {
+    auto stage_val = ParseRunStage(s);
+    if (stages.count(stage_val)) stages_to_run.insert(stage_val);
+  }
+  if (stages_to_run.empty()) return;
+
+  // mod_deps_ is shared by the scheduler threads, do not insert
+  static const std::vector<std::string> no_deps;
+  auto deps_it = mod_deps_.find(mod.name());
+  auto &deps = deps_it == mod_deps_.end() ? no_deps : deps_it->second;
+
+  RerunManager::ModInfo mod_info;
+  if (auto rerun_manager = env_->rerun_manager()) {
+    mod_info.config_hash = HashBytes(mod.config().ToYamlString());
+    // the build id covers every module of the library, a module can pin an explicit version to
+    // ignore changes of the others
+    mod_info.code_version = mod.config(
+        "code_version", ModuleLoader::GetBuildId(ModuleLoader::GetFactoryLibrary(
+                            "module", mod.config().Get<std::string>("class"))));
+    RerunManager::Decision decision;
+    if (!always_run_mods_.count(mod.name())) {
+      std::function<int(int64_t)> first_changed_row;
+      auto reads = mod.config("reads", std::vector<std::string>{});
+      if (env_->track_row_versions() && mod.config("rerun_rows", false) && !reads.empty()) {
+        // the module declares all data it reads in `reads`, their row versions tell which rows
+        // changed since its last run
+        first_changed_row = [this, reads = std::move(reads)](int64_t since) {
+          int first = std::numeric_limits<int>::max();
+          for (auto &data : reads) {
+            auto [changed_first, changed_last] = env_->GetChangedRows(data, since);
+            if (changed_first < changed_last) first = std::min(first, changed_first);
+          }
+          return first;
+        };
+      }
+      decision = rerun_manager->Check(mod.name(), mod_info, deps, first_changed_row);
+    }
+    if (decision.action == RerunManager::Action::SKIP) {
+      LOG_DEBUG("Skip module {}: already built", mod.name());
+      Tracer::Get().Instant("skip", "rerun", {{"module", mod.name()}});
+      return;
+    }
+    // only modules that compute each date from its inputs and its lookback can be extended
+    if (decision.action == RerunManager::Action::EXTEND &&
+        mod.config("rerun_extend", config_.Get("rerun_extend", false))) {
+      int start_di = std::max(env_->start_di(), decision.start_di - mod.config("lookback", 0));
+      LOG_INFO("Extending module {} from {}", mod.name(), env_->datetimes()[start_di]);
+      Tracer::Get().Instant("extend", "rerun",
+                            {{"module", mod.name()}, {"start_di", std::to_string(start_di)}});
+      mod.set_run_range(start_di, env_->end_di());
+    } else {
+      mod.set_run_range(-1, -1);
+    }
+    rerun_manager->RecordBeforeRun(mod.name());
+  }
+
+  auto run_stages = [&](Module &instance) {
+    for (auto stage : stages_to_run) {
+      LOG_INFO("Running module {} - {} ({} - {})", instance.name(), ToString(stage),
+               instance.start_di(), instance.end_di());
+      TraceScope scope(instance.name(), "module");
+      int64_t major_faults = scope.enabled() ? GetThreadMajorFaults() : 0;
+      instance.set_stage(stage);
+      instance.Run();
+      if (scope.enabled()) {
+        scope.AddArg("stage", ToString(stage));
+        scope.AddArg("start_di", instance.start_di());
+        scope.AddArg("end_di", instance.end_di());
+        scope.AddArg("major_faults", GetThreadMajorFaults() - major_faults);
+      }
+    }
+  };
+
+  int run_start_di = mod.start_di();
+  auto shards_it = shard_mods_.find(mod.name());
+  if (shards_it == shard_mods_.end()) {
+    run_stages(mod);
+  } else {
+    // contiguous date shards on the runner's workers, each instance writes the rows of its own
+    // shard of the same arrays
+    std::vector<Module *> instances{&mod};
+    for (auto &shard : shards_it->second) instances.push_back(shard.get());
+    int num_shards = instances.size();
+    int run_size = mod.end_di() - run_start_di;
+    for (int k = 0; k < num_shards; ++k) {
+      instances[k]->set_run_range(run_start_di + run_size * k / num_shards,
+                                  run_start_di + run_size * (k + 1) / num_shards);
+    }
+    TaskPool::ParallelFor(pool_.get(), 0, num_shards, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t k = begin; k < end; ++k) run_stages(*instances[k]);
+    });
+  }
+  LOG_INFO("Finished module {}", mod.name());
+  uint64_t version = GetTimestamp();
+  mod.CommitWrites(version);
+  std::vector<std::string> access_log;
+  if (env_->prefetcher()) access_log = mod.TakeAccessLog();
+  if (shards_it != shard_mods_.end()) {
+    for (auto &shard : shards_it->second) {
+      shard->CommitWrites(version);
+      shard->set_run_range(-1, -1);
+      if (env_->prefetcher()) {
+        auto shard_log = shard->TakeAccessLog();
+        access_log.insert(access_log.end(), shard_log.begin(), shard_log.end());
+      }
+    }
+    std::sort(access_log.begin(), access_log.end());
+    access_log.erase(std::unique(access_log.begin(), access_log.end()), access_log.end());
+    // the next run picks its range again
+    mod.set_run_range(-1, -1);
   }
 
+  if (env_->prefetcher()) {
+    env_->prefetcher()->SaveAccessLog(mod.name(), access_log);
+  }
+
+  if (env_->rerun_manager()) {
+    // without row versions large outputs are only fingerprinted by their modification times
+    uint64_t fingerprint = env_->track_row_versions() ? env_->GetContentFingerprint(mod.name()) : 0;
+    env_->rerun_manager()->RecordRun(mod.name(), mod_info, deps, run_start_di, fingerprint);
+  }
+}
+
+void Runner::RunStages(const std::set<RunStage> &stages) {
+  ENSURE(env_ != nullptr, "Runner is not initialized");
+  if (refresh_env_) {
+    env_->Refresh();
+    LOG_INFO("sim_end_datetime: {}", env_->sim_end_datetime());
+  }
+  refresh_env_ = true;
+  if (!options_.trace_file.empty()) Tracer::Get().Start();
+
   Scheduler scheduler;
+  if (auto prefetcher = env_->prefetcher()) {
+    prefetcher->ClearRequested();
+    unordered_map<std::string, const Module *> mod_map;
+    for (auto &mod : mods_) mod_map[mod->name()] = mod.get();
+    int default_lookback = config_.Get("prefetch_lookback", 0);
+    scheduler.set_ready_callback([env = env_.get(), prefetcher, mod_map = std::move(mod_map),
+                                  default_lookback](const std::string &name) {
+      auto &mod = mod_map.at(name);
+      int lookback = mod->config("prefetch_lookback", default_lookback);
+      prefetcher->PrefetchModule(name, mod->config("reads", std::vector<std::string>{}),
+                                 env->start_di() - lookback, env->end_di());
+    });
+  }
+  scheduler.set_memory_limit(config_.Get("max_memory_gb", 0.0));
+  scheduler.set_max_bypass(config_.Get("scheduler_max_bypass", -1));
+  for (auto &mod : mods_) {
+    Scheduler::TaskOptions task_options;
+    // durations of the last runs prioritize long chains, unknown ones count as 1 second
+    if (auto rerun_manager = env_->rerun_manager()) {
+      double duration = rerun_manager->GetLastRunDuration(mod->name());
+      if (duration > 0) task_options.cost = duration;
+    }
+    // a sharded module runs its shards at the same time
+    auto shards_it = shard_mods_.find(mod->name());
+    int num_shards = shards_it == shard_mods_.end() ? 1 : shards_it->second.size() + 1;
+    task_options.threads = mod->config("threads", num_shards);
+    task_options.memory = mod->config("memory_gb", 0.0);
+    scheduler.set_task_options(mod->name(), task_options);
+  }
   std::vector<std::pair<std::string, Scheduler::Func>> tasks;
-  tasks.reserve(mods.size());
-  for (auto &mod : mods) {
-    tasks.emplace_back(mod->name(), [&mod, &run_mod]() { run_mod(mod); });
+  tasks.reserve(mods_.size());
+  for (auto &mod : mods_) {
+    tasks.emplace_back(mod->name(), [this, &mod, &stages]() { RunModule(*mod, stages); });
   }
-  scheduler.Run(num_threads, mod_deps, tasks);
 
-  for (auto lib : libs) {
+  env_->set_task_pool(pool_.get());
+  auto save_trace = [&]() {
+    if (options_.trace_file.empty()) return;
+    Tracer::Get().Stop();
+    Tracer::Get().Save(options_.trace_file);
+  };
+  try {
+    scheduler.Run(*pool_, mod_deps_, tasks);
+  } catch (...) {
+    // the timeline of a failed run is the most interesting one
+    env_->set_task_pool(nullptr);
+    save_trace();
+    throw;
+  }
+  env_->set_task_pool(nullptr);
+  save_trace();
+}
+
+void Runner::Shutdown() {
+  // modules may hold code and data of the libs
+  pool_.reset();
+  shard_mods_.clear();
+  mods_.clear();
+  mod_deps_.clear();
+  env_.reset();
+  for (auto lib : libs_) {
     ModuleLoader::Unload(lib);
   }
+  libs_.clear();
 }
 
 }  // namespace yang
@@ -2,8 +2,14 @@
 
 #include <memory>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "yang/sim/env.h"
+#include "yang/sim/module.h"
+#include "yang/util/task_pool.h"
+#include "yang/util/unordered_map.h"
+#include "yang/util/unordered_set.h"
 
 namespace yang {
 
@@ -11,11 +17,41 @@ struct RunnerOptions {
   std::set<RunStage> stages;
   bool live = false;
   bool prod = false;
+  // Chrome trace JSON of the run, empty to disable tracing
+  std::string trace_file;
 };
 
+// Loads the libs, env and modules of a config and runs the modules in dependency order.
+//
+// Run does everything once. A resident process calls Initialize once and then RunStages for each
+// new interval, so that the env, its data cache and the module instances stay loaded.
 class Runner {
  public:
+  ~Runner();
+
   void Run(RunnerOptions options, const Config &config, int num_threads = 1);
+
+  void Initialize(RunnerOptions options, const Config &config, int num_threads = 1);
+
+  // Run the modules for stages, picking up new datetimes first unless the env was just built
+  void RunStages(const std::set<RunStage> &stages);
+
+  void Shutdown();
+
+ private:
+  RunnerOptions options_;
+  Config config_;
+  std::vector<void *> libs_;
+  std::unique_ptr<Env> env_;
+  std::vector<std::unique_ptr<Module>> mods_;
+  // instances running the other date shards of modules configured with `shards`
+  unordered_map<std::string, std::vector<std::unique_ptr<Module>>> shard_mods_;
+  unordered_map<std::string, std::vector<std::string>> mod_deps_;
+  unordered_set<std::string> always_run_mods_;
+  std::unique_ptr<TaskPool> pool_;
+  bool refresh_env_ = false;
+
+  void RunModule(Module &mod, const std::set<RunStage> &stages);
 };
 
 }  // namespace yang
@@ -1,28 +1,36 @@
 #include "yang/sim/scheduler.h"
 
-#include <atomic>
-#include <functional>
-#include <future>
-#include <queue>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <stdexcept>
-#include <thread_pool.hpp>
 
 #include "yang/base/exception.h"
 #include "yang/util/logging.h"
+#include "yang/util/trace.h"
 
 namespace yang {
 
 void Scheduler::Run(int num_threads, const unordered_map<Id, std::vector<Id>> &dep_map,
                     const std::vector<std::pair<Id, Func>> &tasks) {
+  TaskPool pool(std::max(num_threads, 1));
+  Run(pool, dep_map, tasks);
+}
+
+void Scheduler::Run(TaskPool &pool, const unordered_map<Id, std::vector<Id>> &dep_map,
+                    const std::vector<std::pair<Id, Func>> &tasks) {
   if (tasks.empty()) return;
+  int num_threads = pool.num_threads();
+  ENSURE(num_threads > 0, "Scheduler needs at least one worker thread");
 
   // Topological sort - Kahn's algorithm
   // compute auxiliary info
-  std::vector<std::atomic<int>> in_degrees(tasks.size());
-  std::vector<std::vector<int>> out_edges(tasks.size());
+  int num_tasks = tasks.size();
+  std::vector<int> in_degrees(num_tasks);
+  std::vector<std::vector<int>> out_edges(num_tasks);
   {
     unordered_map<Id, int> id_map;
-    for (int i = 0; i < static_cast<int>(tasks.size()); ++i) {
+    for (int i = 0; i < num_tasks; ++i) {
       ENSURE(!id_map.count(tasks[i].first), "Duplicate task id: {}", tasks[i].first);
       id_map[tasks[i].first] = i;
     }
@@ -42,52 +50,166 @@ void Scheduler::Run(int num_threads, const unordered_map<Id, std::vector<Id>> &d
     }
   }
 
-  thread_pool worker(num_threads);
+  std::vector<TaskOptions> options(num_tasks);
+  for (int i = 0; i < num_tasks; ++i) {
+    auto it = task_options_.find(tasks[i].first);
+    if (it != task_options_.end()) options[i] = it->second;
+    options[i].threads = std::clamp(options[i].threads, 1, num_threads);
+  }
 
-  std::atomic<int> status{0};
-  std::atomic<int> active_counter{0};
-  std::promise<void> run_promise;
-  std::function<void(int)> run_task = [&](int task_id) {
-    active_counter.fetch_add(1, std::memory_order_relaxed);
+  // critical path priorities, computed in reverse topological order. Tasks in a cycle never run,
+  // their priority does not matter.
+  std::vector<double> priorities(num_tasks);
+  {
+    std::vector<int> out_degrees(num_tasks);
+    std::vector<std::vector<int>> in_edges(num_tasks);
+    std::vector<int> sinks;
+    for (int i = 0; i < num_tasks; ++i) {
+      out_degrees[i] = out_edges[i].size();
+      for (auto j : out_edges[i]) in_edges[j].push_back(i);
+      if (out_degrees[i] == 0) sinks.push_back(i);
+    }
+    while (!sinks.empty()) {
+      int i = sinks.back();
+      sinks.pop_back();
+      double downstream = 0;
+      for (auto j : out_edges[i]) downstream = std::max(downstream, priorities[j]);
+      priorities[i] = options[i].cost + downstream;
+      for (auto j : in_edges[i]) {
+        if (--out_degrees[j] == 0) sinks.push_back(j);
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<int> ready;
+  int running = 0;
+  int used_threads = 0;
+  double used_memory = 0;
+  bool failed = false;
+  std::vector<int64_t> ready_us(num_tasks);
+  int max_bypass = max_bypass_ >= 0 ? max_bypass_ : num_threads;
+  std::vector<int> bypasses(num_tasks);
+  int head = -1;  // the highest priority ready task, if it did not fit
 
-    worker.push_task([&, task_id]() {
-      if (status.load(std::memory_order_relaxed) == 0) {
+  // must be called without holding the lock
+  auto make_ready = [&](const std::vector<int> &task_ids) {
+    if (ready_callback_) {
+      for (auto task_id : task_ids) {
         try {
-          tasks[task_id].second();
+          ready_callback_(tasks[task_id].first);
         } catch (const std::exception &e) {
-          LOG_ERROR("{} failed: {}", tasks[task_id].first, e.what());
-          status.store(-1, std::memory_order_relaxed);
-        } catch (...) {
-          LOG_ERROR("{} failed", tasks[task_id].first);
-          status.store(-1, std::memory_order_relaxed);
+          LOG_WARN("Ready callback failed for {}: {}", tasks[task_id].first, e.what());
         }
+      }
+    }
+    auto &tracer = Tracer::Get();
+    std::lock_guard guard(mutex);
+    if (failed) return;
+    for (auto task_id : task_ids) {
+      if (tracer.enabled()) {
+        ready_us[task_id] = tracer.Now();
+        tracer.Instant("ready", "scheduler", {{"task", tasks[task_id].first}});
+      }
+    }
+    ready.insert(ready.end(), task_ids.begin(), task_ids.end());
+    cv.notify_all();
+  };
 
-        for (auto &downstream_id : out_edges[task_id]) {
-          int d = in_degrees[downstream_id].fetch_add(-1, std::memory_order_relaxed) - 1;
-          if (d == 0) run_task(downstream_id);
-        }
+  // the ready task with the highest priority that fits into the free threads and memory, a task
+  // never fits if it exceeds the limits on its own, so let it run alone
+  auto fits = [&](int task_id) {
+    auto &opts = options[task_id];
+    return running == 0 || (used_threads + opts.threads <= num_threads &&
+                            (memory_limit_ <= 0 || used_memory + opts.memory <= memory_limit_));
+  };
+  auto pick_task = [&]() {
+    head = -1;
+    int top = -1;
+    int best = -1;
+    for (int k = 0; k < static_cast<int>(ready.size()); ++k) {
+      if (top < 0 || priorities[ready[k]] > priorities[ready[top]]) top = k;
+      if (fits(ready[k]) && (best < 0 || priorities[ready[k]] > priorities[ready[best]])) best = k;
+    }
+    if (best >= 0 && best != top) {
+      // bypass the head until it reserves what is freed
+      if (bypasses[ready[top]] >= max_bypass) return -1;
+      head = ready[top];
+    }
+    return best;
+  };
+
+  auto run_task = [&](int task_id) {
+    bool ok = true;
+    try {
+      TraceScope scope(tasks[task_id].first, "task");
+      if (scope.enabled()) {
+        scope.AddArg("waited_ms", (Tracer::Get().Now() - ready_us[task_id]) / 1000);
+        scope.AddArg("threads", options[task_id].threads);
       }
+      tasks[task_id].second();
+    } catch (const std::exception &e) {
+      LOG_ERROR("{} failed: {}", tasks[task_id].first, e.what());
+      ok = false;
+    } catch (...) {
+      LOG_ERROR("{} failed", tasks[task_id].first);
+      ok = false;
+    }
 
-      int n = active_counter.fetch_add(-1, std::memory_order_relaxed) - 1;
-      if (n == 0) {
-        run_promise.set_value();
+    std::vector<int> downstream_ready;
+    std::unique_lock lock(mutex);
+    if (!ok) {
+      // same as before: queued tasks are dropped and nothing downstream starts
+      failed = true;
+      ready.clear();
+    } else if (!failed) {
+      for (auto &downstream_id : out_edges[task_id]) {
+        if (--in_degrees[downstream_id] == 0) downstream_ready.push_back(downstream_id);
       }
-    });
+    }
+    if (!downstream_ready.empty()) {
+      // keep the task counted as running so that the dispatcher does not stop before they are
+      // queued
+      lock.unlock();
+      make_ready(downstream_ready);
+      lock.lock();
+    }
+    auto &opts = options[task_id];
+    running--;
+    used_threads -= opts.threads;
+    used_memory -= opts.memory;
+    cv.notify_all();
   };
 
   std::vector<int> seed_tasks;
-  for (int i = 0; i < static_cast<int>(tasks.size()); ++i) {
-    if (in_degrees[i].load(std::memory_order_relaxed) == 0) seed_tasks.push_back(i);
+  for (int i = 0; i < num_tasks; ++i) {
+    if (in_degrees[i] == 0) seed_tasks.push_back(i);
   }
-  for (auto &task_id : seed_tasks) run_task(task_id);
+  make_ready(seed_tasks);
+
+  std::unique_lock lock(mutex);
+  while (true) {
+    int k = -1;
+    // stop once nothing is running or ready, either all done or blocked by failure or a cycle
+    cv.wait(lock, [&]() { return (k = pick_task()) >= 0 || (running == 0 && ready.empty()); });
+    if (k < 0) break;
 
-  auto run_future = run_promise.get_future();
-  run_future.get();
-  if (status < 0) throw FatalError("Task failure");
+    int task_id = ready[k];
+    ready.erase(ready.begin() + k);
+    if (head >= 0) bypasses[head]++;
+    auto &opts = options[task_id];
+    running++;
+    used_threads += opts.threads;
+    used_memory += opts.memory;
+    pool.Submit([&run_task, task_id]() { run_task(task_id); });
+  }
+  lock.unlock();
+  if (failed) throw FatalError("Task failure");
 
   bool cycle = false;
-  for (int i = 0; i < static_cast<int>(tasks.size()); ++i) {
-    if (in_degrees[i].load(std::memory_order_relaxed) > 0) {
+  for (int i = 0; i < num_tasks; ++i) {
+    if (in_degrees[i] > 0) {
       LOG_ERROR("Found dependency cycle containing {}", tasks[i].first);
       cycle = true;
     }
@@ -4,17 +4,64 @@
 #include <string>
 #include <vector>
 
+#include "yang/util/task_pool.h"
 #include "yang/util/unordered_map.h"
 
 namespace yang {
 
+// Runs a DAG of tasks. Ready tasks are started in the order of their critical path, i.e. the
+// largest total cost of the task and its downstream chain, so that long chains start early.
+//
+// Smaller tasks may start ahead of the highest priority ready task while it does not fit into the
+// free threads or memory. Once it has been bypassed max_bypass times, the resources freed by
+// finished tasks are held for it, so that a large task is not starved by a stream of small ones.
 class Scheduler {
  public:
   using Id = std::string;
   using Func = std::function<void()>;
+  using ReadyCallback = std::function<void(const Id &)>;
+
+  struct TaskOptions {
+    double cost = 1;    // expected duration, in any unit consistent across tasks
+    int threads = 1;    // worker threads occupied by the task
+    double memory = 0;  // expected peak memory, in the unit of the memory limit
+  };
+
+  // Called (from any thread) once all dependencies of a task have finished and right before it is
+  // queued, e.g. to warm up its inputs while it waits for a free worker
+  void set_ready_callback(ReadyCallback callback) {
+    ready_callback_ = std::move(callback);
+  }
+
+  // Tasks without options use the defaults
+  void set_task_options(const Id &id, const TaskOptions &options) {
+    task_options_[id] = options;
+  }
+
+  // Total memory of running tasks, 0 means unlimited. A task that does not fit only starts once
+  // nothing else is running.
+  void set_memory_limit(double limit) {
+    memory_limit_ = limit;
+  }
+
+  // Tasks started ahead of the waiting head of the queue before it reserves the resources, a
+  // negative value means the number of threads
+  void set_max_bypass(int max_bypass) {
+    max_bypass_ = max_bypass;
+  }
 
   void Run(int num_threads, const unordered_map<Id, std::vector<Id>> &dep_map,
            const std::vector<std::pair<Id, Func>> &tasks);
+
+  // Run the tasks on the workers of pool, which the tasks may share via TaskPool::ParallelFor
+  void Run(TaskPool &pool, const unordered_map<Id, std::vector<Id>> &dep_map,
+           const std::vector<std::pair<Id, Func>> &tasks);
+
+ private:
+  ReadyCallback ready_callback_;
+  unordered_map<Id, TaskOptions> task_options_;
+  double memory_limit_ = 0;
+  int max_bypass_ = -1;
 };
 
 }  // namespace yang
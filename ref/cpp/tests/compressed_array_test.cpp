@@ -0,0 +1,156 @@
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yang/data/array.h"
+#include "yang/data/compressed_array.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+// 1000 rows in blocks of 64 leave a partial last block, and odd rows put block boundaries inside
+// pages
+constexpr SizeType ROWS = 1000;
+constexpr SizeType COLS = 37;
+constexpr int BLOCK_ROWS = 64;
+
+fs::path GetTestDir() {
+  return fs::temp_directory_path() / "compressed_array_test";
+}
+
+template <class T>
+T GetValue(SizeType i, SizeType j) {
+  return static_cast<T>(static_cast<float>((i * 31 + j * 7) % 100));
+}
+
+template <class T>
+void Write(const std::string &path) {
+  fs::remove(path);
+  fs::remove(path + ".meta");
+  auto array = Array<T>::MMap(path, {ROWS, COLS});
+  for (SizeType i = 0; i < ROWS; ++i) {
+    for (SizeType j = 0; j < COLS; ++j) array(i, j) = GetValue<T>(i, j);
+  }
+}
+
+template <class T>
+bool IsRowEqual(const T *row, SizeType i) {
+  for (SizeType j = 0; j < COLS; ++j) {
+    auto expected = GetValue<T>(i, j);
+    if (std::memcmp(&row[j], &expected, sizeof(T)) != 0) return false;
+  }
+  return true;
+}
+
+template <class T>
+void TestRoundTrip() {
+  auto path = (GetTestDir() / GetTypeName<T>()).string();
+  Write<T>(path);
+  ArrayBase::Compress(path, BLOCK_ROWS);
+  ENSURE2(IsCompressedArray(path));
+
+  CompressedArrayReader reader(path);
+  ENSURE2(reader.num_blocks() == 16);
+  ENSURE2(reader.GetBlockRows(15) == ROWS - 15 * BLOCK_ROWS);
+  std::vector<T> all(ROWS * COLS);
+  reader.ReadAll(all.data());
+  for (SizeType i = 0; i < ROWS; ++i) ENSURE2(IsRowEqual(&all[i * COLS], i));
+
+  // mapped lazily, then decompressed on load
+  MMapHints populate;
+  populate.populate = true;
+  for (auto &hints : {MMapHints(), populate}) {
+    auto array = Array<T>::MMap(path, false, hints);
+    ENSURE2(array.shape(0) == ROWS && array.shape(1) == COLS);
+    for (SizeType i = ROWS; i-- > 0;) ENSURE2(IsRowEqual(&array(i, 0), i));
+  }
+}
+
+void TestBoundedView() {
+  // random rows from several threads through a view of two resident blocks
+  auto path = (GetTestDir() / "bounded").string();
+  Write<double>(path);
+  ArrayBase::Compress(path, BLOCK_ROWS);
+  ENSURE2(CompressedArrayView::Supported());
+  CompressedArrayView view(path, 2);
+  auto data = reinterpret_cast<const double *>(view.data());
+  std::vector<std::thread> threads;
+  std::vector<int> errors(4);
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (int k = 0; k < 2000; ++k) {
+        SizeType i = rng() % ROWS;
+        if (!IsRowEqual(data + i * COLS, i)) ++errors[t];
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  for (int count : errors) ENSURE2(count == 0);
+  ENSURE2(view.resident_blocks() <= 2);
+  ENSURE2(view.faults() > 16);
+
+  // a sequential scan faults each block in once
+  CompressedArrayView scan(path, 2);
+  data = reinterpret_cast<const double *>(scan.data());
+  for (SizeType i = 0; i < ROWS; ++i) ENSURE2(IsRowEqual(data + i * COLS, i));
+  ENSURE2(scan.faults() == 16);
+}
+
+void TestInterruptedCompress() {
+  auto path = (GetTestDir() / "interrupted").string();
+  Write<float>(path);
+  fs::copy_file(path, path + ".raw");
+  ArrayBase::Compress(path, BLOCK_ROWS);
+
+  // killed after the meta was committed, before the data was
+  fs::rename(path, path + ".zst.tmp");
+  fs::rename(path + ".raw", path);
+  bool thrown = false;
+  try {
+    Array<float>::MMap(path);
+  } catch (const IoError &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+
+  ArrayBase::Compress(path, BLOCK_ROWS);
+  ENSURE2(!fs::exists(path + ".zst.tmp"));
+  auto array = Array<float>::MMap(path);
+  for (SizeType i = 0; i < ROWS; ++i) ENSURE2(IsRowEqual(&array(i, 0), i));
+
+  thrown = false;
+  try {
+    ArrayBase::Compress(path, BLOCK_ROWS);
+  } catch (const std::exception &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::fs::remove_all(yang::GetTestDir());
+  yang::fs::create_directories(yang::GetTestDir());
+  yang::TestRoundTrip<int8_t>();
+  yang::TestRoundTrip<int16_t>();
+  yang::TestRoundTrip<int32_t>();
+  yang::TestRoundTrip<int64_t>();
+  yang::TestRoundTrip<uint8_t>();
+  yang::TestRoundTrip<uint16_t>();
+  yang::TestRoundTrip<uint32_t>();
+  yang::TestRoundTrip<uint64_t>();
+  yang::TestRoundTrip<float>();
+  yang::TestRoundTrip<double>();
+  yang::TestRoundTrip<yang::float16>();
+  yang::TestRoundTrip<yang::bfloat16>();
+  yang::TestBoundedView();
+  yang::TestInterruptedCompress();
+  yang::fs::remove_all(yang::GetTestDir());
+  return 0;
+}
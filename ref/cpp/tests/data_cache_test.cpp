@@ -0,0 +1,124 @@
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yang/data/data_cache.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+auto Const(int v) {
+  return [v]() { return v; };
+}
+
+void TestEviction() {
+  DataCache cache(4, 2);
+  for (int i = 0; i < 10; ++i) {
+    auto load = [i]() { return i; };
+    ENSURE2(*cache.GetOrMake<int>(std::to_string(i), load) == i);
+    ENSURE2(cache.size() <= 4);
+  }
+  ENSURE2(cache.size() == 4);
+  // the latest insert is never its own victim
+  ENSURE2(cache.Get<int>("9") != nullptr);
+  cache.Clear();
+  ENSURE2(cache.size() == 0);
+}
+
+void TestFailedLoad() {
+  DataCache cache(2, 1);
+  bool thrown = false;
+  try {
+    cache.GetOrMake<int>("bad", []() -> int { throw std::runtime_error("load failed"); });
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  ENSURE2(cache.size() == 0);
+  ENSURE2(*cache.GetOrMake<int>("bad", Const(1)) == 1);
+  // failed loads must not pin slots that can never be evicted
+  for (int i = 0; i < 5; ++i) {
+    try {
+      cache.GetOrMake<int>("fail" + std::to_string(i),
+                           []() -> int { throw std::runtime_error("load failed"); });
+    } catch (const std::runtime_error &) {
+    }
+  }
+  ENSURE2(cache.size() == 1);
+  ENSURE2(*cache.GetOrMake<int>("a", Const(2)) == 2);
+  ENSURE2(*cache.GetOrMake<int>("b", Const(3)) == 3);
+  ENSURE2(cache.size() == 2);
+}
+
+void TestEraseIf() {
+  DataCache cache;
+  for (int i = 0; i < 10; ++i) {
+    auto prefix = i % 2 ? "_derived." : "a.";
+    cache.GetOrMake<int>(prefix + std::to_string(i), Const(i));
+  }
+  cache.EraseIf([](std::string_view name) { return name.starts_with("_derived."); });
+  ENSURE2(cache.size() == 5);
+  ENSURE2(cache.Get<int>("_derived.1") == nullptr);
+  ENSURE2(*cache.Get<int>("a.2") == 2);
+  ENSURE2(*cache.GetOrMake<int>("_derived.1", Const(11)) == 11);
+}
+
+void TestEraseShortArrays() {
+  // arrays are erased by their rows, other data is kept
+  DataCache cache;
+  cache.GetOrMake<Array<float>>("a.short", []() { return Array<float>({64, 2}); });
+  cache.GetOrMake<Array<float>>("a.long", []() { return Array<float>({128, 2}); });
+  cache.GetOrMake<int>("a.int", Const(1));
+  cache.EraseShortArrays(128);
+  ENSURE2(cache.size() == 2);
+  ENSURE2(cache.Get<Array<float>>("a.short") == nullptr);
+  ENSURE2(cache.Get<Array<float>>("a.long")->shape(0) == 128);
+  ENSURE2(*cache.Get<int>("a.int") == 1);
+}
+
+void TestConcurrentLoad() {
+  DataCache cache;
+  std::atomic<int> loads = 0;
+  std::atomic<int> failures = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 100; ++i) {
+        auto load = [&loads, i]() {
+          ++loads;
+          return i;
+        };
+        ENSURE2(*cache.GetOrMake<int>(std::to_string(i), load) == i);
+        // every first load fails, so waiters retry with a new entry
+        try {
+          cache.GetOrMake<int>("f" + std::to_string(i), [&failures, i]() -> int {
+            if (failures.fetch_add(1) % 2 == 0) throw std::runtime_error("");
+            return i;
+          });
+        } catch (const std::runtime_error &) {
+        }
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+  ENSURE2(loads == 100);
+  for (int i = 0; i < 100; ++i) {
+    auto v = cache.Get<int>("f" + std::to_string(i));
+    ENSURE2(v == nullptr || *v == i);
+  }
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestEviction();
+  yang::TestFailedLoad();
+  yang::TestEraseIf();
+  yang::TestEraseShortArrays();
+  yang::TestConcurrentLoad();
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include <cmath>
+#include <fstream>
+#include <string>
+
+#include "yang/sim/env.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+fs::path GetTestDir() {
+  return fs::temp_directory_path() / "env_test";
+}
+
+// trade dates on days 1-28 of each month of 2020
+void WriteInputs() {
+  std::ofstream dates(GetTestDir() / "trade_dates.csv");
+  for (int month = 1; month <= 6; ++month) {
+    for (int day = 1; day <= 28; ++day) dates << 20200000 + month * 100 + day << "\n";
+  }
+  std::ofstream sec_master(GetTestDir() / "sec_master.csv");
+  sec_master << "sid|list|delist\n";
+  sec_master << "A|20200101|\n";
+  sec_master << "B|20200101|20200303\n";
+}
+
+Config MakeConfig(int univ_end_date, bool persist_derived_data = false) {
+  return Config::Load(fmt::format(
+      "cache: {}\nuniv_start_date: 20200101\nuniv_end_date: {}\ntrade_dates: {}\n"
+      "sec_master: {}\nmax_univ_size: 8\nuniv_indices_id_start: 4\npersist_derived_data: {}\n",
+      (GetTestDir() / "cache").native(), univ_end_date,
+      (GetTestDir() / "trade_dates.csv").native(), (GetTestDir() / "sec_master.csv").native(),
+      persist_derived_data));
+}
+
+void Build(int univ_end_date) {
+  Env env;
+  env.Initialize(MakeConfig(univ_end_date));
+  env.Build();
+}
+
+void TestRefresh() {
+  // a daemon keeps its Env while the next interval is built by another process, here past the
+  // 64 rows the arrays were first allocated with
+  Build(20200304);
+  Env env;
+  env.Initialize(MakeConfig(20200304));
+  env.Load();
+  ENSURE2(env.datetimes().size() == 60 && env.max_datetimes_size() == 64);
+  auto listing = env.ReadData<Array<bool>>("env", "listing");
+  ENSURE2(listing->shape(0) == 64);
+  int a = env.univ().Find("A");
+  int b = env.univ().Find("B");
+  ENSURE2((*listing)(59, a) && (*listing)(57, b) && !(*listing)(58, b));
+
+  Build(20200316);
+  env.Refresh();
+  ENSURE2(env.datetimes().size() == 72 && env.max_datetimes_size() == 128);
+  listing = env.ReadData<Array<bool>>("env", "listing");
+  ENSURE2(listing->shape(0) == 128);
+  ENSURE2((*listing)(71, a) && !(*listing)(71, b));
+
+  // arrays which already have the rows stay cached
+  Build(20200320);
+  env.Refresh();
+  ENSURE2(env.datetimes().size() == 76);
+  ENSURE2(env.ReadData<Array<bool>>("env", "listing") == listing);
+  ENSURE2((*listing)(75, a));
+}
+
+// Derived data counting how often it is made
+struct Doubled {
+  Env &env;
+  int makes = 0;
+
+  const Array<float> *Get() {
+    return env.GetDerivedData<Array<float>>("double(base/close)", {"base/close"}, [this]() {
+      ++makes;
+      auto close = env.ReadData<Array<float>>("base/close");
+      Array<float> ret(close->shape());
+      for (SizeType i = 0; i < close->shape(0); ++i) {
+        for (SizeType j = 0; j < close->shape(1); ++j) ret(i, j) = 2 * (*close)(i, j);
+      }
+      return ret;
+    });
+  }
+};
+
+void TestDerivedData() {
+  // the env built by TestRefresh
+  constexpr int END_DATE = 20200320;
+  auto close_path = (GetTestDir() / "cache" / "base" / "close").string();
+  {
+    auto close = Array<float>::MMap(close_path, {64, 8});
+    for (SizeType i = 0; i < 64; ++i) {
+      for (SizeType j = 0; j < 8; ++j) close(i, j) = i % 5 == 0 ? NAN : i + j;
+    }
+  }
+  auto derived_path = GetTestDir() / "cache" / "_derived" / "double_base_close_";
+
+  // made once per refresh without persist_derived_data
+  Env env;
+  env.Initialize(MakeConfig(END_DATE));
+  env.Load();
+  Doubled doubled{env};
+  auto data = doubled.Get();
+  ENSURE2(doubled.Get() == data && doubled.makes == 1);
+  ENSURE2((*data)(1, 2) == 6 && std::isnan((*data)(5, 2)));
+  ENSURE2(!fs::exists(derived_path));
+  env.Refresh();
+  doubled.Get();
+  ENSURE2(doubled.makes == 2);
+
+  // filled data is derived data
+  auto filled = env.GetFilledArray("base/close", 1);
+  ENSURE2(env.GetFilledArray("base/close", 1) == filled);
+  ENSURE2((*filled)(5, 2) == 4 + 2 && (*filled)(10, 2) == 9 + 2);
+  ENSURE2(std::isnan((*env.GetFilledArray("base/close", 0))(5, 2)));
+
+  // persisted and reused across refreshes and processes while the input is unchanged
+  Env persisted;
+  persisted.Initialize(MakeConfig(END_DATE, true));
+  persisted.Load();
+  Doubled saved{persisted};
+  ENSURE2((*saved.Get())(1, 2) == 6 && saved.makes == 1);
+  ENSURE2(fs::exists(derived_path) && fs::exists(derived_path.native() + ".inputs"));
+  for (auto &entry : fs::directory_iterator(derived_path.parent_path())) {
+    ENSURE2(entry.path().native().find(".tmp") == std::string::npos);
+  }
+  persisted.Refresh();
+  ENSURE2((*saved.Get())(1, 2) == 6 && saved.makes == 1);
+  {
+    Env other;
+    other.Initialize(MakeConfig(END_DATE, true));
+    other.Load();
+    Doubled reused{other};
+    ENSURE2((*reused.Get())(1, 2) == 6 && reused.makes == 0);
+  }
+
+  // and made again once it changed
+  Array<float>::MMap(close_path, true)(1, 2) = 10;
+  persisted.Refresh();
+  ENSURE2((*saved.Get())(1, 2) == 20 && saved.makes == 2);
+  persisted.Refresh();
+  saved.Get();
+  ENSURE2(saved.makes == 2);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::fs::remove_all(yang::GetTestDir());
+  yang::fs::create_directories(yang::GetTestDir());
+  yang::WriteInputs();
+  yang::TestRefresh();
+  yang::TestDerivedData();
+  yang::fs::remove_all(yang::GetTestDir());
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "yang/sim/operation_manager.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+constexpr int ROWS = 50;
+constexpr int COLS = 13;
+constexpr int START_DI = 20;
+constexpr int END_DI = 45;
+
+// sig + args[0]
+struct AddOperation : RowOperation {
+  float value = 0;
+
+  void Prepare(const Env &env, const std::vector<std::string> &args) override {
+    value = std::stof(args.at(0));
+  }
+
+  void ApplyRow(MatView<float> sig, const Env &env, int di) override {
+    for (int ii = 0; ii < sig.cols(); ++ii) sig(di, ii) += value;
+  }
+};
+REGISTER_OPERATION("test_add", AddOperation);
+
+// sig minus the mean of the finite values of its row
+struct DemeanOperation : RowOperation {
+  void ApplyRow(MatView<float> sig, const Env &env, int di) override {
+    float sum = 0;
+    int count = 0;
+    for (int ii = 0; ii < sig.cols(); ++ii) {
+      if (std::isfinite(sig(di, ii))) {
+        sum += sig(di, ii);
+        ++count;
+      }
+    }
+    if (count == 0) return;
+    for (int ii = 0; ii < sig.cols(); ++ii) sig(di, ii) -= sum / count;
+  }
+};
+REGISTER_OPERATION("test_demean", DemeanOperation);
+
+// |sig|, a row independent operation which is not a RowOperation
+struct AbsOperation : Operation {
+  bool row_independent() const override {
+    return true;
+  }
+
+  void Apply(MatView<float> sig, const Env &env, int start_di, int end_di) override {
+    for (int di = start_di; di < end_di; ++di) {
+      for (int ii = 0; ii < sig.cols(); ++ii) sig(di, ii) = std::abs(sig(di, ii));
+    }
+  }
+};
+REGISTER_OPERATION("test_abs", AbsOperation);
+
+// sig of the previous row
+struct DelayOperation : Operation {
+  bool lookback() const override {
+    return true;
+  }
+
+  void Apply(MatView<float> sig, const Env &env, int start_di, int end_di) override {
+    for (int di = end_di - 1; di >= start_di; --di) {
+      for (int ii = 0; ii < sig.cols(); ++ii) sig(di, ii) = di > 0 ? sig(di - 1, ii) : NAN;
+    }
+  }
+};
+REGISTER_OPERATION("test_delay", DelayOperation);
+
+std::vector<float> MakeInput() {
+  std::vector<float> input(ROWS * COLS);
+  for (int i = 0; i < ROWS * COLS; ++i) {
+    input[i] = static_cast<float>((i * 37) % 101) / 7 - 5;
+    if (i % 11 == 3) input[i] = NAN;
+    if (i % 29 == 5) input[i] = INFINITY;
+  }
+  return input;
+}
+
+int GetStartDi(const std::vector<OperationDesc> &ops) {
+  for (auto &desc : ops) {
+    std::unique_ptr<Operation> op(FactoryRegistry::Make<Operation>("operation", std::get<0>(desc)));
+    if (op->lookback()) return 0;
+  }
+  return START_DI;
+}
+
+// The input copied to the output over the rows the operations run on, 7 elsewhere
+std::vector<float> CopyInput(const std::vector<float> &input, int start_di) {
+  std::vector<float> output(ROWS * COLS, 7);
+  for (int i = start_di * COLS; i < END_DI * COLS; ++i) {
+    output[i] = std::isfinite(input[i]) ? input[i] : NAN;
+  }
+  return output;
+}
+
+// The reference: each operation applied on its own, as before fusion
+std::vector<float> ApplySeparately(const std::vector<float> &input, const Env &env,
+                                   const std::vector<OperationDesc> &ops) {
+  int start_di = GetStartDi(ops);
+  auto output = CopyInput(input, start_di);
+  math::MatView<float> sig(output.data(), ROWS, COLS);
+  for (auto &[name, args, kwargs] : ops) {
+    std::unique_ptr<Operation> op(FactoryRegistry::Make<Operation>("operation", name));
+    op->Apply(sig, env, start_di, END_DI, args, kwargs);
+  }
+  return output;
+}
+
+bool IsEqual(const std::vector<float> &a, const std::vector<float> &b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i] && !(std::isnan(a[i]) && std::isnan(b[i]))) return false;
+  }
+  return true;
+}
+
+void TestChain(const Env &env, const std::vector<OperationDesc> &ops) {
+  OperationManager manager;
+  manager.Initialize(&env);
+  auto input = MakeInput();
+  auto expected = ApplySeparately(input, env, ops);
+
+  // rows outside of the range keep the output
+  std::vector<float> output(ROWS * COLS, 7);
+  math::MatView<const float> sig_in(input.data(), ROWS, COLS);
+  manager.Apply(sig_in, math::MatView<float>(output.data(), ROWS, COLS), START_DI, END_DI, ops);
+  ENSURE2(IsEqual(output, expected));
+
+  auto sig = CopyInput(input, GetStartDi(ops));
+  manager.Apply(math::MatView<float>(sig.data(), ROWS, COLS), START_DI, END_DI, ops);
+  ENSURE2(IsEqual(sig, expected));
+
+  // a batch prepares the chain once for all signals
+  std::vector<std::vector<float>> outputs(3, std::vector<float>(ROWS * COLS, 7));
+  std::vector<math::MatView<const float>> sigs_in;
+  std::vector<math::MatView<float>> sigs_out;
+  for (auto &batch_output : outputs) {
+    sigs_in.emplace_back(input.data(), ROWS, COLS);
+    sigs_out.emplace_back(batch_output.data(), ROWS, COLS);
+  }
+  manager.ApplyBatch(sigs_in, sigs_out, START_DI, END_DI, ops);
+  for (auto &batch_output : outputs) ENSURE2(IsEqual(batch_output, expected));
+}
+
+void TestChains(const Env &env) {
+  using Args = std::vector<std::string>;
+  OperationDesc add1{"test_add", Args{"1"}, {}};
+  OperationDesc add2{"test_add", Args{"-2.5"}, {}};
+  OperationDesc demean{"test_demean", Args{}, {}};
+  OperationDesc abs{"test_abs", Args{}, {}};
+  OperationDesc delay{"test_delay", Args{}, {}};
+  // fused row operations
+  TestChain(env, {add1, demean, add2});
+  TestChain(env, {demean});
+  // row operations around other operations
+  TestChain(env, {add1, demean, abs, add2, demean});
+  TestChain(env, {abs, add1});
+  // a lookback operation runs every operation from the first row
+  TestChain(env, {add1, demean, delay, add2, demean});
+  TestChain(env, {delay, add1, abs});
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::Env env;
+  yang::TestChains(env);
+  // rows and signals split over workers
+  yang::TaskPool pool(4);
+  env.set_task_pool(&pool);
+  yang::TestChains(env);
+  return 0;
+}
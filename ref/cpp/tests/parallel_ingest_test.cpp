@@ -0,0 +1,85 @@
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yang/util/logging.h"
+#include "yang/util/parallel_ingest.h"
+
+namespace yang {
+namespace {
+
+void TestOrderedMerge() {
+  TaskPool pool(4);
+  for (TaskPool *p : {static_cast<TaskPool *>(nullptr), &pool}) {
+    int start_di = 5;
+    int end_di = 103;
+    std::vector<int> merged;
+    ParallelIngest<std::string>(
+        p, start_di, end_di,
+        [&](int di) {
+          // later dates of a window finish first
+          std::this_thread::sleep_for(std::chrono::microseconds((end_di - di) % 7 * 100));
+          return std::to_string(di * 2);
+        },
+        [&](int di, std::string result) {
+          ENSURE2(result == std::to_string(di * 2));
+          merged.push_back(di);
+        });
+    ENSURE2(static_cast<int>(merged.size()) == end_di - start_di);
+    for (int k = 0; k < static_cast<int>(merged.size()); ++k) ENSURE2(merged[k] == start_di + k);
+  }
+}
+
+void TestMoveOnly() {
+  TaskPool pool(2);
+  int sum = 0;
+  ParallelIngest<std::unique_ptr<int>>(
+      &pool, 0, 50, [](int di) { return std::make_unique<int>(di); },
+      [&](int di, std::unique_ptr<int> result) {
+        ENSURE2(*result == di);
+        sum += *result;
+      });
+  ENSURE2(sum == 49 * 50 / 2);
+}
+
+void TestEmpty() {
+  TaskPool pool(2);
+  int calls = 0;
+  ParallelIngest<int>(
+      &pool, 10, 10, [&](int) { return ++calls; }, [&](int, int) { ++calls; });
+  ENSURE2(calls == 0);
+}
+
+void TestError() {
+  // dates after a failed parse are not merged
+  TaskPool pool(3);
+  int last_merged = -1;
+  bool thrown = false;
+  try {
+    ParallelIngest<int>(
+        &pool, 0, 100,
+        [](int di) {
+          if (di == 60) throw std::runtime_error("parse failed");
+          return di;
+        },
+        [&](int di, int) { last_merged = di; });
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  ENSURE2(last_merged < 60);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestOrderedMerge();
+  yang::TestMoveOnly();
+  yang::TestEmpty();
+  yang::TestError();
+  return 0;
+}
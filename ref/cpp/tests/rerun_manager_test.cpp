@@ -0,0 +1,136 @@
+#include <string>
+#include <vector>
+
+#include "yang/sim/rerun_manager.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+using Action = RerunManager::Action;
+
+constexpr int64_t START_DATE = 20200101;
+constexpr int64_t END_DATE = 20200601;
+constexpr int END_DI = 100;
+
+fs::path GetTestDir(const std::string &name) {
+  auto dir = fs::temp_directory_path() / "rerun_manager_test" / name;
+  fs::remove_all(dir);
+  return dir;
+}
+
+RerunManager::ModInfo MakeInfo(uint64_t config_hash = 1, const std::string &code_version = "v1") {
+  RerunManager::ModInfo info;
+  info.config_hash = config_hash;
+  info.code_version = code_version;
+  return info;
+}
+
+void Run(RerunManager &rm, const std::string &mod, const std::vector<std::string> &deps,
+         int changed_from_di, uint64_t fingerprint) {
+  rm.RecordBeforeRun(mod);
+  rm.RecordRun(mod, MakeInfo(), deps, changed_from_di, fingerprint);
+}
+
+const std::vector<std::string> no_deps;
+const std::vector<std::string> deps_a = {"a"};
+
+bool IsDecision(RerunManager::Decision decision, Action action, int start_di = 0) {
+  return decision.action == action && decision.start_di == start_di;
+}
+
+void TestFull() {
+  RerunManager rm;
+  rm.Initialize(GetTestDir("full").native());
+  rm.SetDates(START_DATE, END_DATE, END_DI);
+  auto info = MakeInfo();
+  ENSURE2(IsDecision(rm.Check("a", info, no_deps), Action::FULL));
+  Run(rm, "a", {}, 0, 11);
+  ENSURE2(IsDecision(rm.Check("a", info, no_deps), Action::SKIP));
+  ENSURE2(IsDecision(rm.Check("a", MakeInfo(2), no_deps), Action::FULL));
+  ENSURE2(IsDecision(rm.Check("a", MakeInfo(1, "v2"), no_deps), Action::FULL));
+
+  rm.SetDates(START_DATE + 1, END_DATE, END_DI);
+  ENSURE2(IsDecision(rm.Check("a", info, no_deps), Action::FULL));
+}
+
+void TestExtend() {
+  RerunManager rm;
+  rm.Initialize(GetTestDir("extend").native());
+  rm.SetDates(START_DATE, END_DATE, END_DI);
+  auto info = MakeInfo();
+  Run(rm, "a", {}, 0, 11);
+  Run(rm, "b", {"a"}, 0, 21);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::SKIP));
+
+  // new dates are computed from the old end
+  rm.SetDates(START_DATE, END_DATE + 7, END_DI + 5);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::EXTEND, END_DI));
+  rm.SetDates(START_DATE, END_DATE, END_DI);
+
+  // b recomputes from the earliest change of the runs of a it missed
+  Run(rm, "a", {}, 50, 12);
+  Run(rm, "a", {}, 80, 13);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::EXTEND, 50));
+  // the changed rows of its inputs narrow it
+  auto first_changed_row = [](int64_t) { return 70; };
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a, first_changed_row), Action::EXTEND, 70));
+  Run(rm, "b", {"a"}, 50, 22);
+
+  // a ran again with the outputs b was built from
+  Run(rm, "a", {}, 90, 13);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::SKIP));
+
+  // a changed from its first date
+  Run(rm, "a", {}, 0, 14);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::FULL));
+}
+
+void TestHistory() {
+  // runs of a dep beyond its history can not be traced
+  RerunManager rm;
+  rm.Initialize(GetTestDir("history").native());
+  rm.SetDates(START_DATE, END_DATE, END_DI);
+  auto info = MakeInfo();
+  Run(rm, "a", {}, 0, 100);
+  Run(rm, "b", {"a"}, 0, 200);
+  for (int k = 1; k <= 15; ++k) Run(rm, "a", {}, 50 + k, 100 + k);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::EXTEND, 51));
+  Run(rm, "a", {}, 90, 116);
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::FULL));
+}
+
+void TestReload() {
+  // decisions survive a restart, and a dep removed since is a full rerun
+  auto dir = GetTestDir("reload");
+  auto info = MakeInfo();
+  {
+    RerunManager rm;
+    rm.Initialize(dir.native());
+    rm.SetDates(START_DATE, END_DATE, END_DI);
+    Run(rm, "a", {}, 0, 11);
+    Run(rm, "b", {"a"}, 0, 21);
+    Run(rm, "a", {}, 60, 12);
+  }
+  RerunManager rm;
+  rm.Initialize(dir.native());
+  rm.SetDates(START_DATE, END_DATE, END_DI);
+  ENSURE2(IsDecision(rm.Check("a", info, no_deps), Action::SKIP));
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::EXTEND, 60));
+
+  // b is checked while a runs again
+  rm.RecordBeforeRun("a");
+  ENSURE2(IsDecision(rm.Check("b", info, deps_a), Action::FULL));
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestFull();
+  yang::TestExtend();
+  yang::TestHistory();
+  yang::TestReload();
+  yang::fs::remove_all(yang::fs::temp_directory_path() / "rerun_manager_test");
+  return 0;
+}
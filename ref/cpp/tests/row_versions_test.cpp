@@ -0,0 +1,118 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "yang/data/array.h"
+#include "yang/data/row_versions.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+constexpr SizeType ROWS = 100;
+constexpr SizeType COLS = 10;
+
+fs::path GetTestDir() {
+  return fs::temp_directory_path() / "row_versions_test";
+}
+
+void TestChangedRows() {
+  auto path = (GetTestDir() / "changed").string();
+  auto array = Array<float>::MMap(path, {ROWS, COLS});
+  for (SizeType i = 0; i < ROWS; ++i) {
+    for (SizeType j = 0; j < COLS; ++j) array(i, j) = i + j;
+  }
+  array.UpdateRowVersions(0, ROWS, 10);
+  auto fingerprint = RowVersions(path).Fingerprint();
+
+  // rows rewritten with the same content keep their version
+  array(40, 1) = 40 + 1;
+  array(30, 2) = -1;
+  array(50, 1) = -1;
+  array.UpdateRowVersions(0, ROWS, 20);
+
+  RowVersions versions(path);
+  ENSURE2(versions.rows() == ROWS);
+  ENSURE2(versions.version(0) == 10);
+  ENSURE2(versions.version(30) == 20 && versions.version(50) == 20);
+  ENSURE2(versions.version(40) == 10);
+  ENSURE2(versions.version(ROWS) == 0);
+  ENSURE2(versions.GetChangedRange(5) == std::make_pair(SizeType(0), ROWS));
+  ENSURE2(versions.GetChangedRange(10) == std::make_pair(SizeType(30), SizeType(51)));
+  ENSURE2(versions.GetChangedRange(20) == std::make_pair(SizeType(0), SizeType(0)));
+  ENSURE2(versions.Fingerprint() != fingerprint);
+
+  // restoring the content restores the fingerprint
+  array(30, 2) = 30 + 2;
+  array(50, 1) = 50 + 1;
+  array.UpdateRowVersions(30, 51, 30);
+  RowVersions restored(path);
+  ENSURE2(restored.Fingerprint() == fingerprint);
+  ENSURE2(restored.GetChangedRange(20) == std::make_pair(SizeType(30), SizeType(51)));
+}
+
+void TestGrowth() {
+  // rows appended later have no version until they are updated
+  auto path = (GetTestDir() / "growth").string();
+  {
+    auto array = Array<float>::MMap(path, {ROWS, COLS});
+    array.UpdateRowVersions(0, ROWS, 10);
+  }
+  auto array = Array<float>::MMap(path, {ROWS + 20, COLS});
+  RowVersions versions(path);
+  ENSURE2(versions.rows() == ROWS);
+  ENSURE2(versions.GetChangedRange(10) == std::make_pair(SizeType(0), SizeType(0)));
+  array.UpdateRowVersions(ROWS, ROWS + 20, 20);
+  RowVersions grown(path);
+  ENSURE2(grown.rows() == ROWS + 20);
+  ENSURE2(grown.GetChangedRange(10) == std::make_pair(ROWS, ROWS + 20));
+}
+
+void TestCorrupted() {
+  auto path = (GetTestDir() / "corrupted").string();
+  auto array = Array<float>::MMap(path, {ROWS, COLS});
+  array.UpdateRowVersions(0, ROWS, 10);
+  fs::resize_file(RowVersions::GetPath(path), 24);
+  ENSURE2(RowVersions(path).rows() == 0);
+  array.UpdateRowVersions(0, ROWS, 20);
+  RowVersions versions(path);
+  ENSURE2(versions.rows() == ROWS && versions.version(0) == 20);
+}
+
+void TestConcurrentProcesses() {
+  // date shards in several processes update disjoint rows of the same array
+  auto path = (GetTestDir() / "shards").string();
+  constexpr int NUM_PROCS = 8;
+  constexpr SizeType SHARD_ROWS = 50;
+  { Array<float>::MMap(path, {NUM_PROCS * SHARD_ROWS, COLS}); }
+  for (int p = 0; p < NUM_PROCS; ++p) {
+    if (fork() == 0) {
+      auto array = Array<float>::MMap(path, {NUM_PROCS * SHARD_ROWS, COLS});
+      for (int r = 0; r < 20; ++r) {
+        for (SizeType i = p * SHARD_ROWS; i < (p + 1) * SHARD_ROWS; ++i) array(i, 0) = r;
+        array.UpdateRowVersions(p * SHARD_ROWS, (p + 1) * SHARD_ROWS, 100 + r);
+      }
+      _exit(0);
+    }
+  }
+  int status;
+  while (wait(&status) > 0) ENSURE2(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  RowVersions versions(path);
+  ENSURE2(versions.rows() == NUM_PROCS * SHARD_ROWS);
+  for (SizeType i = 0; i < versions.rows(); ++i) ENSURE2(versions.version(i) == 119);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::fs::remove_all(yang::GetTestDir());
+  yang::fs::create_directories(yang::GetTestDir());
+  yang::TestChangedRows();
+  yang::TestGrowth();
+  yang::TestCorrupted();
+  yang::TestConcurrentProcesses();
+  yang::fs::remove_all(yang::GetTestDir());
+  return 0;
+}
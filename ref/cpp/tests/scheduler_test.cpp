@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yang/base/exception.h"
+#include "yang/sim/scheduler.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+using Tasks = std::vector<std::pair<Scheduler::Id, Scheduler::Func>>;
+using DepMap = unordered_map<Scheduler::Id, std::vector<Scheduler::Id>>;
+
+// Records the order in which tasks start
+struct Recorder {
+  std::mutex mutex;
+  std::vector<std::string> started;
+
+  Scheduler::Func Make(const std::string &id, int sleep_ms = 0, bool fail = false) {
+    return [this, id, sleep_ms, fail]() {
+      {
+        std::lock_guard guard(mutex);
+        started.push_back(id);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+      if (fail) throw std::runtime_error(id + " failed");
+    };
+  }
+};
+
+void TestCriticalPathOrder() {
+  // on one thread, ready tasks run by the total cost of their downstream chain
+  Recorder recorder;
+  Scheduler scheduler;
+  for (auto &[id, cost] : std::vector<std::pair<std::string, double>>{
+           {"a", 3}, {"b", 2}, {"big", 5}, {"d", 0.5}, {"c1", 100}, {"c2", 100}}) {
+    scheduler.set_task_options(id, {cost});
+  }
+  DepMap deps{{"c2", {"c1"}}, {"d", {"big"}}};
+  Tasks tasks;
+  for (auto id : {"a", "b", "big", "d", "c1", "c2"}) tasks.emplace_back(id, recorder.Make(id));
+  std::vector<std::string> ready;
+  scheduler.set_ready_callback([&](const Scheduler::Id &id) { ready.push_back(id); });
+  scheduler.Run(1, deps, tasks);
+  std::vector<std::string> expected{"c1", "c2", "big", "a", "b", "d"};
+  ENSURE2(recorder.started == expected);
+  ENSURE2(ready.size() == tasks.size());
+}
+
+void TestDepsAndResources() {
+  // a random DAG on 4 threads: every task starts after its deps, within the threads and memory
+  constexpr int NUM_TASKS = 60;
+  constexpr int NUM_THREADS = 4;
+  constexpr double MEMORY_LIMIT = 10;
+  std::mt19937 rng(3);
+  Scheduler scheduler;
+  scheduler.set_memory_limit(MEMORY_LIMIT);
+  std::vector<Scheduler::TaskOptions> options(NUM_TASKS);
+  DepMap deps;
+  for (int i = 0; i < NUM_TASKS; ++i) {
+    auto id = std::to_string(i);
+    options[i] = {1.0 + rng() % 5, 1 + static_cast<int>(rng() % 3),
+                  static_cast<double>(rng() % 6)};
+    scheduler.set_task_options(id, options[i]);
+    for (int j = 0; j < i; ++j) {
+      if (rng() % 8 == 0) deps[id].push_back(std::to_string(j));
+    }
+  }
+
+  std::mutex mutex;
+  std::vector<bool> done(NUM_TASKS);
+  int used_threads = 0;
+  double used_memory = 0;
+  int max_threads = 0;
+  double max_memory = 0;
+  int errors = 0;
+  Tasks tasks;
+  for (int i = 0; i < NUM_TASKS; ++i) {
+    auto id = std::to_string(i);
+    tasks.emplace_back(id, [&, i, id]() {
+      {
+        std::lock_guard guard(mutex);
+        if (auto it = deps.find(id); it != deps.end()) {
+          for (auto &dep : it->second) errors += !done[std::stoi(dep)];
+        }
+        used_threads += options[i].threads;
+        used_memory += options[i].memory;
+        max_threads = std::max(max_threads, used_threads);
+        max_memory = std::max(max_memory, used_memory);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1 + i % 3));
+      std::lock_guard guard(mutex);
+      used_threads -= options[i].threads;
+      used_memory -= options[i].memory;
+      done[i] = true;
+    });
+  }
+  scheduler.Run(NUM_THREADS, deps, tasks);
+  ENSURE2(errors == 0);
+  for (int i = 0; i < NUM_TASKS; ++i) ENSURE2(done[i]);
+  ENSURE2(max_threads <= NUM_THREADS);
+  ENSURE2(max_memory <= MEMORY_LIMIT);
+}
+
+void TestFailure() {
+  // a failed task stops its downstream and fails the run
+  Recorder recorder;
+  Scheduler scheduler;
+  DepMap deps{{"b", {"a"}}, {"c", {"b"}}};
+  Tasks tasks{{"a", recorder.Make("a", 5, true)}, {"b", recorder.Make("b")},
+              {"c", recorder.Make("c")}};
+  bool thrown = false;
+  try {
+    scheduler.Run(2, deps, tasks);
+  } catch (const FatalError &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  std::vector<std::string> expected{"a"};
+  ENSURE2(recorder.started == expected);
+}
+
+void TestCycle() {
+  // tasks outside of the cycle still run
+  Recorder recorder;
+  Scheduler scheduler;
+  DepMap deps{{"a", {"b"}}, {"b", {"a"}}, {"d", {"a"}}};
+  Tasks tasks{{"a", recorder.Make("a")}, {"b", recorder.Make("b")}, {"c", recorder.Make("c")},
+              {"d", recorder.Make("d")}};
+  bool thrown = false;
+  try {
+    scheduler.Run(2, deps, tasks);
+  } catch (const FatalError &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  std::vector<std::string> expected{"c"};
+  ENSURE2(recorder.started == expected);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestCriticalPathOrder();
+  yang::TestDepsAndResources();
+  yang::TestFailure();
+  yang::TestCycle();
+  return 0;
+}
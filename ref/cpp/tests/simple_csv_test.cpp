@@ -0,0 +1,122 @@
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "yang/io/open.h"
+#include "yang/util/fs.h"
+#include "yang/util/logging.h"
+#include "yang/util/simple_csv.h"
+
+namespace yang {
+namespace {
+
+constexpr int NUM_ROWS = 3000;
+
+fs::path GetTestPath(const std::string &name) {
+  auto dir = fs::temp_directory_path() / "simple_csv_test";
+  fs::create_directories(dir);
+  return dir / name;
+}
+
+// sid|close|volume|date, with a few empty and invalid closes and volumes
+std::string WritePrices() {
+  auto path = GetTestPath("prices.csv").string();
+  std::ofstream file(path);
+  file << "sid|close|volume|date\n";
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    std::string close = i % 97 == 5 ? "" : (i % 89 == 7 ? "n/a" : std::to_string(i * 0.25));
+    std::string volume = i % 101 == 3 ? "1e3" : std::to_string(i * 100);
+    file << "S" << i << "|" << close << "|" << volume << "|" << 20200101 + i % 28 << "\n";
+  }
+  return path;
+}
+
+// A reader of file, past its header
+SimpleCsvReader OpenReader(io::BufferedFile &file) {
+  std::string line;
+  ENSURE2(file.ReadLine(line));
+  return SimpleCsvReader(line, '|');
+}
+
+void TestReadColumns() {
+  auto path = WritePrices();
+  auto file = io::OpenBufferedFile(path);
+  auto reader = OpenReader(*file);
+  std::vector<std::string_view> names{"close", "volume"};
+  std::vector<std::vector<float>> floats;
+  ENSURE2(reader.ReadColumns(*file, names, floats) == NUM_ROWS);
+  ENSURE2(floats.size() == 2 && floats[0].size() == NUM_ROWS && floats[1].size() == NUM_ROWS);
+
+  // the same values as reading the fields of each row
+  auto rows = io::OpenBufferedFile(path);
+  auto row_reader = OpenReader(*rows);
+  std::string line;
+  for (int i = 0; rows->ReadLine(line); ++i) {
+    row_reader.ReadNext(line);
+    float close = row_reader.Get<float>("close");
+    ENSURE2(floats[0][i] == close || (std::isnan(floats[0][i]) && std::isnan(close)));
+    ENSURE2(floats[1][i] == row_reader.Get<float>("volume"));
+  }
+  ENSURE2(std::isnan(floats[0][5]) && std::isnan(floats[0][7]));
+  ENSURE2(floats[0][8] == 2 && floats[1][3] == 1000);
+
+  // integers, by column index and with a fallback
+  file = io::OpenBufferedFile(path);
+  reader = OpenReader(*file);
+  std::vector<int> cols{reader.Column("date"), reader.Column("volume")};
+  std::vector<std::vector<int64_t>> ints;
+  reader.ReadColumns(*file, cols, ints, int64_t(-1));
+  ENSURE2(ints[0][29] == 20200102 && ints[1][29] == 2900);
+  ENSURE2(ints[1][3] == -1);
+}
+
+void TestReuseBuffers() {
+  // buffers reserved or filled by a previous file are written in place
+  auto path = WritePrices();
+  std::vector<std::string_view> names{"volume"};
+  std::vector<std::vector<double>> columns(1);
+  columns[0].reserve(NUM_ROWS);
+  auto data = columns[0].data();
+  for (int k = 0; k < 2; ++k) {
+    auto file = io::OpenBufferedFile(path);
+    auto reader = OpenReader(*file);
+    ENSURE2(reader.ReadColumns(*file, names, columns) == NUM_ROWS);
+    ENSURE2(columns[0].data() == data && columns[0][NUM_ROWS - 1] == (NUM_ROWS - 1) * 100.0);
+  }
+}
+
+void TestErrors() {
+  auto path = GetTestPath("short.csv").string();
+  std::ofstream(path) << "a|b|c\n1|2|3\n4|5\n";
+  auto file = io::OpenBufferedFile(path);
+  auto reader = OpenReader(*file);
+  std::vector<std::vector<float>> columns;
+  bool thrown = false;
+  try {
+    reader.ReadColumns(*file, std::vector<std::string_view>{"d"}, columns);
+  } catch (const OutOfRange &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  // rows without the field of a column
+  thrown = false;
+  try {
+    reader.ReadColumns(*file, std::vector<std::string_view>{"a", "c"}, columns);
+  } catch (const OutOfRange &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestReadColumns();
+  yang::TestReuseBuffers();
+  yang::TestErrors();
+  yang::fs::remove_all(yang::fs::temp_directory_path() / "simple_csv_test");
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "yang/util/logging.h"
+#include "yang/util/task_pool.h"
+
+namespace yang {
+namespace {
+
+void TestParallelFor() {
+  TaskPool pool(4);
+  std::vector<int> hits(1000);
+  pool.ParallelFor(0, hits.size(), 7, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) hits[i]++;
+  });
+  for (auto h : hits) ENSURE2(h == 1);
+
+  // without a pool the range runs inline
+  int calls = 0;
+  TaskPool::ParallelFor(nullptr, 0, 10, 1, [&](int64_t begin, int64_t end) {
+    ++calls;
+    ENSURE2(begin == 0 && end == 10);
+  });
+  ENSURE2(calls == 1);
+}
+
+void TestNested() {
+  // every worker is busy with a task that runs nested loops, which must not deadlock
+  TaskPool pool(2);
+  std::atomic<int64_t> sum = 0;
+  std::atomic<int> done = 0;
+  for (int t = 0; t < 4; ++t) {
+    pool.Submit([&]() {
+      ENSURE2(TaskPool::Current() == &pool);
+      pool.ParallelFor(0, 100, 1, [&](int64_t begin, int64_t end) {
+        pool.ParallelFor(begin * 10, end * 10, 1, [&](int64_t begin2, int64_t end2) {
+          for (int64_t i = begin2; i < end2; ++i) sum += i;
+        });
+      });
+      ++done;
+    });
+  }
+  while (done < 4) std::this_thread::yield();
+  ENSURE2(sum == 4 * (999 * 1000 / 2));
+  ENSURE2(TaskPool::Current() == nullptr);
+}
+
+void TestReduce() {
+  // chunks are reduced in order, so a non-commutative reduce matches the serial result
+  auto concat = [](std::vector<int> lhs, const std::vector<int> &rhs) {
+    lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+    return lhs;
+  };
+  auto range = [](int64_t begin, int64_t end) {
+    std::vector<int> ret;
+    for (int64_t i = begin; i < end; ++i) ret.push_back(i);
+    return ret;
+  };
+  TaskPool pool(4);
+  for (int64_t grain : {0, 1, 3, 1000}) {
+    auto v = pool.ParallelReduce(0, 500, grain, std::vector<int>(), range, concat);
+    ENSURE2(v == range(0, 500));
+  }
+  auto serial = TaskPool::ParallelReduce(nullptr, 0, 500, 0, std::vector<int>(), range, concat);
+  ENSURE2(serial == range(0, 500));
+  std::vector<int> init(1, -1);
+  ENSURE2(pool.ParallelReduce(5, 5, 0, init, range, concat) == init);
+}
+
+void TestReduceChunks() {
+  // the chunks, and so a floating point sum, do not depend on the pool
+  auto sum = [](int64_t begin, int64_t end) {
+    double ret = 0;
+    for (int64_t i = begin; i < end; ++i) ret += 1.0 / (i + 1);
+    return ret;
+  };
+  auto plus = [](double lhs, double rhs) { return lhs + rhs; };
+  for (int64_t grain : {0, 7}) {
+    auto expected = TaskPool::ParallelReduce(nullptr, 0, 100000, grain, 0.0, sum, plus);
+    for (int num_threads : {1, 3, 8}) {
+      TaskPool pool(num_threads);
+      ENSURE2(pool.ParallelReduce(0, 100000, grain, 0.0, sum, plus) == expected);
+    }
+  }
+  int calls = 0;
+  auto count = [&](int64_t, int64_t) { return ++calls; };
+  TaskPool::ParallelReduce(nullptr, 0, 100000, 0, 0, count, [](int, int) { return 0; });
+  ENSURE2(calls == TaskPool::REDUCE_CHUNKS);
+}
+
+void TestError() {
+  TaskPool pool(4);
+  std::atomic<int> calls = 0;
+  bool thrown = false;
+  try {
+    pool.ParallelFor(0, 100, 1, [&](int64_t begin, int64_t) {
+      ++calls;
+      if (begin == 10) throw std::runtime_error("chunk failed");
+    });
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  ENSURE2(thrown);
+  ENSURE2(calls <= 100);
+  // the pool is still usable
+  std::atomic<int> n = 0;
+  pool.ParallelFor(0, 100, 1, [&](int64_t begin, int64_t end) { n += end - begin; });
+  ENSURE2(n == 100);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestParallelFor();
+  yang::TestNested();
+  yang::TestReduce();
+  yang::TestReduceChunks();
+  yang::TestError();
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <thread>
+
+#include <yaml-cpp/yaml.h>
+
+#include "yang/util/fs.h"
+#include "yang/util/logging.h"
+#include "yang/util/trace.h"
+
+namespace yang {
+namespace {
+
+void TestSave() {
+  // the saved trace parses as JSON (a subset of YAML) with every event and its escaped strings
+  auto path = (fs::temp_directory_path() / "trace_test.json").string();
+  std::string name = "load \"a\\b\"\n\x01";
+  auto &tracer = Tracer::Get();
+  tracer.Instant("before", "test");
+  tracer.Start();
+  {
+    TraceScope scope(name, "module");
+    ENSURE2(scope.enabled());
+    scope.AddArg("rows", 3);
+    scope.AddArg("path", "x\ty");
+    std::thread thread([] {
+      TRACE_SCOPE("inner", "task");
+      Tracer::Get().Instant("ready", "scheduler", {{"task", "b"}});
+    });
+    thread.join();
+  }
+  tracer.Stop();
+  tracer.Instant("after", "test");
+  ENSURE2(!TraceScope("stopped", "test").enabled());
+  tracer.Save(path);
+
+  auto trace = YAML::LoadFile(path);
+  ENSURE2(trace["displayTimeUnit"].as<std::string>() == "ms");
+  auto events = trace["traceEvents"];
+  ENSURE2(events.size() == 3);
+  // spans are recorded when they end
+  auto instant = events[0];
+  auto inner = events[1];
+  auto outer = events[2];
+  ENSURE2(instant["name"].as<std::string>() == "ready");
+  ENSURE2(instant["ph"].as<std::string>() == "i" && instant["s"].as<std::string>() == "t");
+  ENSURE2(instant["args"]["task"].as<std::string>() == "b");
+  ENSURE2(inner["name"].as<std::string>() == "inner");
+  ENSURE2(inner["cat"].as<std::string>() == "task");
+  ENSURE2(outer["name"].as<std::string>() == name);
+  ENSURE2(outer["ph"].as<std::string>() == "X");
+  ENSURE2(outer["args"]["rows"].as<std::string>() == "3");
+  ENSURE2(outer["args"]["path"].as<std::string>() == "x\ty");
+  ENSURE2(inner["tid"].as<int>() == instant["tid"].as<int>());
+  ENSURE2(inner["tid"].as<int>() != outer["tid"].as<int>());
+  ENSURE2(inner["pid"].as<int>() == outer["pid"].as<int>());
+  // the inner span lies within the outer one
+  auto start = outer["ts"].as<int64_t>();
+  auto end = start + outer["dur"].as<int64_t>();
+  ENSURE2(inner["ts"].as<int64_t>() >= start);
+  ENSURE2(inner["ts"].as<int64_t>() + inner["dur"].as<int64_t>() <= end);
+  fs::remove(path);
+}
+
+void TestRestart() {
+  // Start drops the events of the previous trace
+  auto path = (fs::temp_directory_path() / "trace_test_restart.json").string();
+  auto &tracer = Tracer::Get();
+  tracer.Start();
+  tracer.Instant("first", "test");
+  tracer.Start();
+  tracer.Instant("second", "test");
+  tracer.Stop();
+  tracer.Save(path);
+  auto events = YAML::LoadFile(path)["traceEvents"];
+  ENSURE2(events.size() == 1);
+  ENSURE2(events[0]["name"].as<std::string>() == "second");
+  fs::remove(path);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::TestSave();
+  yang::TestRestart();
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "yang/util/control_socket.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "yang/util/logging.h"
+
+namespace yang {
+
+static constexpr int MAX_COMMAND_SIZE = 4096;
+// how often a server waiting for connections checks for Stop
+static constexpr int ACCEPT_POLL_MS = 200;
+
+ControlSocket::ControlSocket(std::string path, int io_timeout_ms)
+    : path_(std::move(path)), io_timeout_ms_(io_timeout_ms) {
+  sockaddr_un addr{};
+  ENSURE(path_.size() < sizeof(addr.sun_path), "Socket path too long: {}", path_);
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path_.c_str());
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) throw MakeExcept<IoError>("Failed to create socket: {}", std::strerror(errno));
+  // a stale socket of a previous process
+  unlink(path_.c_str());
+  if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd_, 8) != 0) {
+    int err = errno;
+    close(fd_);
+    throw MakeExcept<IoError>("Failed to listen on {}: {}", path_, std::strerror(err));
+  }
+  LOG_INFO("Listening on {}", path_);
+}
+
+ControlSocket::~ControlSocket() {
+  if (fd_ >= 0) {
+    close(fd_);
+    unlink(path_.c_str());
+  }
+}
+
+void ControlSocket::Serve(const Handler &handler) {
+  while (!stop_) {
+    pollfd pfd{fd_, POLLIN, 0};
+    int ready = poll(&pfd, 1, ACCEPT_POLL_MS);
+    if (ready < 0 && errno != EINTR) {
+      throw MakeExcept<IoError>("Failed to poll {}: {}", path_, std::strerror(errno));
+    }
+    if (ready <= 0) continue;
+    int conn = accept(fd_, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) continue;
+      throw MakeExcept<IoError>("Failed to accept on {}: {}", path_, std::strerror(errno));
+    }
+    timeval timeout{io_timeout_ms_ / 1000, io_timeout_ms_ % 1000 * 1000};
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string command;
+    char buf[256];
+    bool timed_out = false;
+    while (command.find('\n') == std::string::npos && command.size() < MAX_COMMAND_SIZE) {
+      auto n = read(conn, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) timed_out = true;
+      if (n <= 0) break;
+      command.append(buf, n);
+    }
+    if (timed_out) {
+      LOG_WARN("Dropped a client of {} without a command in {}ms", path_, io_timeout_ms_);
+      close(conn);
+      continue;
+    }
+    auto end = command.find_first_of("\r\n");
+    if (end != std::string::npos) command.resize(end);
+
+    std::string reply;
+    try {
+      reply = handler(command);
+    } catch (const std::exception &e) {
+      reply = fmt::format("error: {}", e.what());
+    }
+    reply += '\n';
+    for (size_t written = 0; written < reply.size();) {
+      auto n = write(conn, reply.data() + written, reply.size() - written);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        LOG_WARN("Failed to reply to {}", command);
+        break;
+      }
+      written += n;
+    }
+    close(conn);
+  }
+}
+
+}  // namespace yang
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace yang {
+
+// A local control channel of a resident process over a Unix domain socket.
+//
+// Clients send one command line per connection and read one reply line, e.g.
+//   echo "run intraday" | socat - UNIX-CONNECT:/tmp/runner.sock
+// Commands are handled one at a time on the thread calling Serve. A client that does not send its
+// command or read the reply within the io timeout is dropped, so it cannot block the server.
+class ControlSocket {
+ public:
+  // Returns the reply to a command
+  using Handler = std::function<std::string(std::string_view command)>;
+
+  explicit ControlSocket(std::string path, int io_timeout_ms = 5000);
+
+  ~ControlSocket();
+
+  ControlSocket(const ControlSocket &) = delete;
+  ControlSocket &operator=(const ControlSocket &) = delete;
+
+  const std::string &path() const {
+    return path_;
+  }
+
+  // Handle commands until Stop is called, e.g. by the handler or another thread
+  void Serve(const Handler &handler);
+
+  void Stop() {
+    stop_ = true;
+  }
+
+ private:
+  std::string path_;
+  int io_timeout_ms_;
+  int fd_ = -1;
+  std::atomic<bool> stop_ = false;
+};
+
+}  // namespace yang
@@ -0,0 +1,26 @@
+#include "yang/util/dir_lock.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "yang/base/exception.h"
+
+namespace yang {
+
+DirLock::DirLock(fs::path dir) {
+  if (dir.empty()) dir = ".";
+  fs::create_directories(dir);
+  fd_ = open(dir.c_str(), O_RDONLY);
+  if (fd_ < 0) throw MakeExcept<IoError>("Failed to open {}", dir.string());
+  if (flock(fd_, LOCK_EX) != 0) {
+    close(fd_);
+    throw MakeExcept<IoError>("Failed to lock {}", dir.string());
+  }
+}
+
+DirLock::~DirLock() {
+  close(fd_);
+}
+
+}  // namespace yang
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "yang/util/fs.h"
+
+namespace yang {
+
+// Exclusive lock on a directory across processes, e.g. held while an array in it is created or
+// resized, as date shards of a module in several processes write the same arrays
+class DirLock {
+ public:
+  explicit DirLock(fs::path dir);
+
+  ~DirLock();
+
+  DirLock(const DirLock &) = delete;
+  DirLock &operator=(const DirLock &) = delete;
+
+ private:
+  int fd_;
+};
+
+}  // namespace yang
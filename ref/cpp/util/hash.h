@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace yang {
+
+// Hash of a byte range that is stable across processes and builds, unlike absl::Hash and
+// std::hash, so that it can be persisted
+inline uint64_t HashBytes(const void *data, size_t size) {
+  constexpr uint64_t MUL = 0x9e3779b97f4a7c15;
+  auto ptr = reinterpret_cast<const uint8_t *>(data);
+  uint64_t h = size * MUL;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, ptr + i, sizeof(word));
+    h = (h ^ word) * MUL;
+    h ^= h >> 32;
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, ptr + i, size - i);
+    h = (h ^ word) * MUL;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+inline uint64_t HashBytes(std::string_view str) {
+  return HashBytes(str.data(), str.size());
+}
+
+}  // namespace yang
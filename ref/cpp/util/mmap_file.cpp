@@ -4,12 +4,25 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 
 #include "yang/util/logging.h"
 
 namespace yang {
 
+static size_t RoundUpToPage(size_t size) {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+static void *ReserveAddress(void *addr, size_t size) {
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  if (addr) flags |= MAP_FIXED;
+  return mmap(addr, size, PROT_NONE, flags, -1, 0);
+}
+
 MMapFile::~MMapFile() {
   Reset();
 }
@@ -18,7 +31,10 @@ MMapFile &MMapFile::operator=(MMapFile &&other) {
   Reset();
   addr_ = other.addr_;
   size_ = other.size_;
+  reserved_size_ = other.reserved_size_;
+  options_ = std::move(other.options_);
   other.addr_ = nullptr;
+  other.reserved_size_ = 0;
   return *this;
 }
 
@@ -29,6 +45,8 @@ void MMapFile::Initialize(const Options &options) {
 
 void MMapFile::Initialize(const Options &options, bool &truncated) {
   ENSURE(addr_ == nullptr, "MMapFile already initialized");
+  options_ = options;
+  reserved_size_ = 0;
 
   int prot = PROT_READ;
   if (options.writable) {
@@ -37,12 +55,14 @@ void MMapFile::Initialize(const Options &options, bool &truncated) {
 
   if (options.filename.empty()) {
     int map_flags = MAP_ANONYMOUS | MAP_SHARED;
+    if (options.hints.populate) map_flags |= MAP_POPULATE;
     size_ = options.size;
     addr_ = reinterpret_cast<uint8_t *>(mmap(nullptr, size_, prot, map_flags, 0, 0));
     if (addr_ == MAP_FAILED) LOG_FATAL("Failed to mmap: {}", GetErrorString());
     truncated = true;
   } else {
     int map_flags = MAP_SHARED;
+    if (options.hints.populate) map_flags |= MAP_POPULATE;
     int file_flags = 0;
     if (options.writable) {
       file_flags = O_RDWR;
@@ -71,18 +91,155 @@ void MMapFile::Initialize(const Options &options, bool &truncated) {
       size_ = st.st_size;
       truncated = false;
     }
-    addr_ = reinterpret_cast<uint8_t *>(mmap(nullptr, size_, prot, map_flags, fd, 0));
-    if (addr_ == MAP_FAILED) LOG_FATAL("Failed to mmap: {}", GetErrorString());
+    if (options.reserve_size > size_) {
+      reserved_size_ = RoundUpToPage(options.reserve_size);
+      auto base = ReserveAddress(nullptr, reserved_size_);
+      if (base == MAP_FAILED) LOG_FATAL("Failed to reserve address: {}", GetErrorString());
+      if (size_ > 0 && mmap(base, size_, prot, map_flags | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, reserved_size_);
+        reserved_size_ = 0;
+        LOG_FATAL("Failed to mmap: {}", GetErrorString());
+      }
+      addr_ = reinterpret_cast<uint8_t *>(base);
+    } else {
+      addr_ = reinterpret_cast<uint8_t *>(mmap(nullptr, size_, prot, map_flags, fd, 0));
+      if (addr_ == MAP_FAILED) LOG_FATAL("Failed to mmap: {}", GetErrorString());
+    }
     close(fd);
   }
   if (options.lock && mlock(addr_, size_))
     LOG_FATAL("Failed to mlock (size: {}): {}", size_, GetErrorString());
+  if (size_ > 0) ApplyHints(options.hints, 0);
+}
+
+void MMapFile::Resize(size_t new_size) {
+  ENSURE(addr_ != nullptr && !options_.filename.empty(), "Resize requires a file mapping");
+  ENSURE(options_.writable, "Resize requires a writable mapping");
+  if (new_size == size_) return;
+
+  int fd = open(options_.filename.c_str(), O_RDWR);
+  if (fd == -1) LOG_FATAL("Failed to open file {}: {}", options_.filename, GetErrorString());
+  if (ftruncate(fd, new_size))
+    LOG_FATAL("Failed to ftruncate {} (size: {}): {}", options_.filename, new_size,
+              GetErrorString());
+
+  size_t old_end = RoundUpToPage(size_);
+  size_t new_end = RoundUpToPage(new_size);
+  if (new_end < old_end) {
+    // give the tail back to the reservation
+    if (reserved_size_ > 0) {
+      if (ReserveAddress(addr_ + new_end, old_end - new_end) == MAP_FAILED)
+        LOG_FATAL("Failed to reserve address: {}", GetErrorString());
+    } else {
+      munmap(addr_ + new_end, old_end - new_end);
+    }
+    size_ = new_size;
+  } else if (new_end > old_end) {
+    Grow(fd, new_size);
+  } else {
+    size_ = new_size;
+  }
+  close(fd);
+}
+
+void MMapFile::Grow(int fd, size_t new_size) {
+  int prot = PROT_READ | PROT_WRITE;
+  int map_flags = MAP_SHARED;
+  if (options_.hints.populate) map_flags |= MAP_POPULATE;
+  size_t old_size = size_;
+  size_t old_end = RoundUpToPage(size_);
+  size_t new_end = RoundUpToPage(new_size);
+
+  if (new_end <= reserved_size_) {
+    // map the new pages into the reservation, the address stays the same
+    if (mmap(addr_ + old_end, new_end - old_end, prot, map_flags | MAP_FIXED, fd, old_end) ==
+        MAP_FAILED)
+      LOG_FATAL("Failed to mmap: {}", GetErrorString());
+  } else {
+    size_t new_reserved = std::max(new_end, RoundUpToPage(reserved_size_ * 2));
+#ifdef __linux__
+    if (old_end > 0) {
+      // out of reserved space, remap without touching the page cache, the kernel moves the
+      // mapping if it cannot grow in place. mremap fails with EFAULT if the mapping spans
+      // several VMAs, e.g. after parts of it were mapped into the reservation or advised
+      // separately, then the file is mapped again below.
+      if (reserved_size_ > old_end) munmap(addr_ + old_end, reserved_size_ - old_end);
+      if (reserved_size_ > 0) reserved_size_ = old_end;
+      auto new_addr = mremap(addr_, old_end, new_reserved, MREMAP_MAYMOVE);
+      if (new_addr != MAP_FAILED) {
+        addr_ = reinterpret_cast<uint8_t *>(new_addr);
+        if (new_reserved > new_end &&
+            ReserveAddress(addr_ + new_end, new_reserved - new_end) == MAP_FAILED)
+          LOG_FATAL("Failed to reserve address: {}", GetErrorString());
+        reserved_size_ = new_reserved;
+        size_ = new_size;
+        if (options_.lock && mlock(addr_ + old_end, size_ - old_end))
+          LOG_FATAL("Failed to mlock (size: {}): {}", size_, GetErrorString());
+        ApplyHints(options_.hints, old_size);
+        return;
+      }
+      if (errno != EFAULT) LOG_FATAL("Failed to mremap: {}", GetErrorString());
+      LOG_DEBUG("Mapping of {} spans several VMAs, mapping it again", options_.filename);
+    }
+#endif
+    auto options = options_;
+    options.create = false;
+    options.size = new_size;
+    options.reserve_size = new_reserved;
+    Reset();
+    Initialize(options);
+    return;
+  }
+  size_ = new_size;
+  if (options_.lock && mlock(addr_ + old_end, new_end - old_end))
+    LOG_FATAL("Failed to mlock (size: {}): {}", size_, GetErrorString());
+  ApplyHints(options_.hints, old_size);
+}
+
+void MMapFile::ApplyHints(const MMapHints &hints, size_t offset) {
+  // hints are best effort, e.g. huge pages are not supported by every file system
+#ifdef MADV_HUGEPAGE
+  if (hints.huge_pages) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset / page_size * page_size;
+    if (madvise(addr_ + aligned_offset, size_ - aligned_offset, MADV_HUGEPAGE))
+      LOG_DEBUG("Failed to madvise MADV_HUGEPAGE: {}", GetErrorString());
+  }
+#endif
+  if (hints.advice != MMapAdvice::NORMAL) Advise(hints.advice, offset);
+}
+
+void MMapFile::Advise(MMapAdvice advice, size_t offset, size_t len) {
+  if (!addr_ || offset >= size_) return;
+  if (len == 0 || offset + len > size_) len = size_ - offset;
+  // madvise requires a page aligned address
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t aligned_offset = offset / page_size * page_size;
+  len += offset - aligned_offset;
+
+  int flag = MADV_NORMAL;
+  switch (advice) {
+    case MMapAdvice::SEQUENTIAL:
+      flag = MADV_SEQUENTIAL;
+      break;
+    case MMapAdvice::RANDOM:
+      flag = MADV_RANDOM;
+      break;
+    case MMapAdvice::WILLNEED:
+      flag = MADV_WILLNEED;
+      break;
+    default:
+      break;
+  }
+  if (madvise(addr_ + aligned_offset, len, flag))
+    LOG_DEBUG("Failed to madvise {}: {}", flag, GetErrorString());
 }
 
 void MMapFile::Reset() {
   if (addr_) {
-    munmap(addr_, size_);
+    munmap(addr_, reserved_size_ > 0 ? reserved_size_ : size_);
     addr_ = nullptr;
+    reserved_size_ = 0;
   }
 }
 
@@ -5,9 +5,41 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace yang {
 
+enum class MMapAdvice {
+  NORMAL = 0,
+  SEQUENTIAL,
+  RANDOM,
+  WILLNEED,
+};
+
+constexpr bool ParseMMapAdvice(std::string_view s, MMapAdvice &advice) {
+  if (s == "normal") {
+    advice = MMapAdvice::NORMAL;
+  } else if (s == "sequential") {
+    advice = MMapAdvice::SEQUENTIAL;
+  } else if (s == "random") {
+    advice = MMapAdvice::RANDOM;
+  } else if (s == "willneed") {
+    advice = MMapAdvice::WILLNEED;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Kernel hints applied to a mapping, none of them changes the content
+struct MMapHints {
+  bool populate = false;    // prefault the whole mapping (MAP_POPULATE)
+  bool huge_pages = false;  // back the mapping with transparent huge pages if possible
+  MMapAdvice advice = MMapAdvice::NORMAL;
+
+  bool operator==(const MMapHints &) const = default;
+};
+
 class MMapFile {
  public:
   struct Options {
@@ -17,6 +49,10 @@ class MMapFile {
     bool create = true;  // create if the file does not exist
     mode_t mode = 0644;  // access mode
     size_t size = 0;     // use a non-zero value to truncate the file
+    // Reserve address space for a file mapping so that it can grow in place with Resize. The
+    // reservation is PROT_NONE and does not consume memory.
+    size_t reserve_size = 0;
+    MMapHints hints;
   };
 
   MMapFile() {}
@@ -40,11 +76,28 @@ class MMapFile {
     return size_;
   }
 
+  size_t reserved_size() const {
+    return reserved_size_;
+  }
+
+  // Truncate the file to new_size and update the mapping. The address does not change as long as
+  // new_size fits into the reservation.
+  void Resize(size_t new_size);
+
+  // Advise the access pattern of [offset, offset + len), len = 0 means till the end
+  void Advise(MMapAdvice advice, size_t offset = 0, size_t len = 0);
+
   void Reset();
 
  private:
   uint8_t *addr_ = nullptr;
   size_t size_;
+  size_t reserved_size_ = 0;
+  Options options_;
+
+  void ApplyHints(const MMapHints &hints, size_t offset);
+
+  void Grow(int fd, size_t new_size);
 };
 
 }  // namespace yang
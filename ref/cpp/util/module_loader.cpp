@@ -1,17 +1,33 @@
 #include "yang/util/module_loader.h"
 
 #include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
 
+#include <cstring>
 #include <filesystem>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "yang/util/factory_registry.h"
+#include "yang/util/fmt.h"
 #include "yang/util/logging.h"
 
 namespace yang {
 
 static std::mutex loaded_mutex;
 static std::unordered_map<std::string, void *> loaded_paths;
+// library of each factory by "type/name", for the ones registered while a library was loaded
+static std::unordered_map<std::string, void *> factory_libraries;
+
+static std::unordered_set<std::string> GetFactories() {
+  std::unordered_set<std::string> ret;
+  for (auto &[type, registry] : *detail::GetFactoryStorage()) {
+    for (auto &[name, _] : registry) ret.insert(type + "/" + name);
+  }
+  return ret;
+}
 
 void *ModuleLoader::Load(const std::string &path) {
   {
@@ -19,11 +35,20 @@ void *ModuleLoader::Load(const std::string &path) {
     auto it = loaded_paths.find(path);
     if (it != loaded_paths.end()) return it->second;
   }
+  // libraries are loaded one at a time, the factories they register tell which library a module
+  // was built in
+  static std::mutex load_mutex;
+  std::lock_guard load_guard(load_mutex);
   void *handle = nullptr;
+  std::unordered_map<std::string, void *> registered;
   if (std::filesystem::exists(path)) {
+    auto before = GetFactories();
     handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
     if (handle) {
       LOG_INFO("Loaded {}", path);
+      for (auto &factory : GetFactories()) {
+        if (!before.count(factory)) registered[factory] = handle;
+      }
     } else {
       LOG_ERROR("Failed to load {}: {}", path, dlerror());
     }
@@ -33,10 +58,17 @@ void *ModuleLoader::Load(const std::string &path) {
   {
     std::lock_guard guard(loaded_mutex);
     loaded_paths[path] = handle;
+    factory_libraries.merge(registered);
   }
   return handle;
 }
 
+void *ModuleLoader::GetFactoryLibrary(const std::string &type, const std::string &name) {
+  std::lock_guard guard(loaded_mutex);
+  auto it = factory_libraries.find(type + "/" + name);
+  return it == factory_libraries.end() ? nullptr : it->second;
+}
+
 void ModuleLoader::Unload(void *handle) {
   auto ret = dlclose(handle);
   if (ret != 0) {
@@ -44,4 +76,53 @@ void ModuleLoader::Unload(void *handle) {
   }
 }
 
+namespace {
+
+struct BuildIdSearch {
+  const struct link_map *map;
+  std::string build_id;
+};
+
+int FindBuildId(struct dl_phdr_info *info, size_t, void *data) {
+  auto search = static_cast<BuildIdSearch *>(data);
+  if (info->dlpi_addr != search->map->l_addr ||
+      std::strcmp(info->dlpi_name, search->map->l_name) != 0) {
+    return 0;
+  }
+
+  auto align = [](size_t n) { return (n + 3) & ~size_t(3); };
+  for (int i = 0; i < info->dlpi_phnum; ++i) {
+    auto &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE) continue;
+    auto ptr = reinterpret_cast<const char *>(info->dlpi_addr + phdr.p_vaddr);
+    auto end = ptr + phdr.p_memsz;
+    while (ptr + sizeof(ElfW(Nhdr)) <= end) {
+      auto note = reinterpret_cast<const ElfW(Nhdr) *>(ptr);
+      auto name = ptr + sizeof(ElfW(Nhdr));
+      auto desc = reinterpret_cast<const uint8_t *>(name + align(note->n_namesz));
+      if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+          std::memcmp(name, "GNU", 4) == 0) {
+        for (size_t j = 0; j < note->n_descsz; ++j) {
+          search->build_id += fmt::format("{:02x}", desc[j]);
+        }
+        return 1;
+      }
+      ptr = reinterpret_cast<const char *>(desc) + align(note->n_descsz);
+    }
+  }
+  return 1;
+}
+
+}  // namespace
+
+std::string ModuleLoader::GetBuildId(void *handle) {
+  void *program = handle ? nullptr : dlopen(nullptr, RTLD_NOW);
+  BuildIdSearch search{nullptr, {}};
+  if (dlinfo(handle ? handle : program, RTLD_DI_LINKMAP, &search.map) == 0) {
+    dl_iterate_phdr(FindBuildId, &search);
+  }
+  if (program) dlclose(program);
+  return search.build_id;
+}
+
 }  // namespace yang
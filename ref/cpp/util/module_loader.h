@@ -7,6 +7,14 @@ namespace yang {
 struct ModuleLoader {
   static void *Load(const std::string &path);
   static void Unload(void *handle);
+
+  // Handle of the library that registered the factory of name for type when it was loaded, nullptr
+  // if the factory is linked into the program
+  static void *GetFactoryLibrary(const std::string &type, const std::string &name);
+
+  // GNU build id (hex) of the library of handle, or of the program if nullptr, empty if not
+  // available
+  static std::string GetBuildId(void *handle);
 };
 
 }  // namespace yang
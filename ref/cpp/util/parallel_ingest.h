@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "yang/util/task_pool.h"
+
+namespace yang {
+
+// Ingests the dates [start_di, end_di) in two stages: parse(di) returns a Result for each date
+// and runs on the workers of pool, e.g. reading one file per date and writing its own rows, and
+// merge(di, result) runs on the calling thread in date order, e.g. for inserts into shared indices
+// or checks against the previous date.
+//
+// Dates are parsed in windows of a few per thread, so at most a window of results is held and a
+// merge never waits for dates far ahead. Without a pool each date is parsed and merged in turn.
+template <class Result, class Parse, class Merge>
+void ParallelIngest(TaskPool *pool, int start_di, int end_di, const Parse &parse,
+                    const Merge &merge) {
+  int window = pool ? 4 * (pool->num_threads() + 1) : 1;
+  std::vector<std::optional<Result>> results(window);
+  for (int window_di = start_di; window_di < end_di; window_di += window) {
+    int window_end_di = std::min(end_di, window_di + window);
+    TaskPool::ParallelFor(pool, window_di, window_end_di, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t di = begin; di < end; ++di) results[di - window_di].emplace(parse(di));
+    });
+    for (int di = window_di; di < window_end_di; ++di) {
+      merge(di, std::move(*results[di - window_di]));
+      results[di - window_di].reset();
+    }
+  }
+}
+
+}  // namespace yang
@@ -1,5 +1,7 @@
 #include "yang/util/simple_csv.h"
 
+#include <cstring>
+
 namespace yang {
 
 unordered_map<std::string, int> SimpleCsvReader::ParseHeader(const std::string &line, char delim) {
@@ -23,8 +25,16 @@ SimpleCsvReader::SimpleCsvReader(const std::string &line) {
 SimpleCsvReader::SimpleCsvReader(const std::string &line, char delim)
     : delim_(delim), header_(ParseHeader(line, delim)) {}
 
-void SimpleCsvReader::ReadNext(const std::string &line) {
-  row_ = yang::StrSplit(line, delim_);
+void SimpleCsvReader::ReadNext(std::string_view line) {
+  // reuse the fields of the previous row, and memchr scans many bytes at a time for delimiters
+  row_.clear();
+  const char *begin = line.data();
+  const char *end = begin + line.size();
+  while (auto *pos = static_cast<const char *>(std::memchr(begin, delim_, end - begin))) {
+    row_.emplace_back(begin, pos - begin);
+    begin = pos + 1;
+  }
+  row_.emplace_back(begin, end - begin);
 }
 
 }  // namespace yang
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "yang/base/exception.h"
@@ -18,18 +22,30 @@ class SimpleCsvReader {
 
   SimpleCsvReader(const std::string &line, char delim);
 
-  void ReadNext(const std::string &line);
+  // Splits line into the fields of row(), which refer to line
+  void ReadNext(std::string_view line);
+
+  // Index of the column name, to look up before reading rows rather than by name on every row
+  int Column(std::string_view name) const {
+    auto it = header_.find(name);
+    if (it == header_.end()) {
+      throw MakeExcept<OutOfRange>("Missing csv column {}", name);
+    }
+    return it->second;
+  }
+
+  // Index of the column name, or -1 if missing
+  int FindColumn(std::string_view name) const {
+    auto it = header_.find(name);
+    return it == header_.end() ? -1 : it->second;
+  }
 
   std::string_view operator[](int i) const {
     return row_[i];
   }
 
   std::string_view operator[](std::string_view name) const {
-    auto it = header_.find(name);
-    if (it == header_.end()) {
-      throw MakeExcept<OutOfRange>("Missing csv column {}", name);
-    }
-    return row_[it->second];
+    return row_[Column(name)];
   }
 
   template <class T, class K>
@@ -44,6 +60,54 @@ class SimpleCsvReader {
     return StrConv<T>(col, fallback);
   }
 
+  // Reads the remaining lines of file, e.g. a BufferedFile, parsing the fields of cols with
+  // std::from_chars into the buffer of the same index in columns, and fallback where a field is
+  // not a whole number. The buffers keep their capacity, so buffers reserved or reused from a
+  // previous file are written in place, and grow geometrically all at once otherwise. Returns the
+  // number of rows read.
+  template <class T, class File>
+  int64_t ReadColumns(File &file, const std::vector<int> &cols,
+                      std::vector<std::vector<T>> &columns,
+                      T fallback = std::is_floating_point_v<T> ? T(NAN) : T()) {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>);
+    columns.resize(cols.size());
+    size_t capacity = SIZE_MAX;
+    for (auto &column : columns) {
+      column.resize(column.capacity());
+      capacity = std::min(capacity, column.size());
+    }
+    int min_fields = 0;
+    for (int col : cols) min_fields = std::max(min_fields, col + 1);
+    std::string line;
+    size_t rows = 0;
+    while (file.ReadLine(line)) {
+      ReadNext(line);
+      if (static_cast<int>(row_.size()) < min_fields) {
+        throw MakeExcept<OutOfRange>("Csv row {} has {} fields, expected {}", rows, row_.size(),
+                                     min_fields);
+      }
+      if (rows == capacity) {
+        capacity = std::max<size_t>(1024, 2 * capacity);
+        for (auto &column : columns) column.resize(capacity);
+      }
+      for (size_t k = 0; k < cols.size(); ++k) {
+        if (!FromChars(row_[cols[k]], columns[k][rows])) columns[k][rows] = fallback;
+      }
+      ++rows;
+    }
+    for (auto &column : columns) column.resize(rows);
+    return rows;
+  }
+
+  template <class T, class File>
+  int64_t ReadColumns(File &file, const std::vector<std::string_view> &names,
+                      std::vector<std::vector<T>> &columns,
+                      T fallback = std::is_floating_point_v<T> ? T(NAN) : T()) {
+    std::vector<int> cols;
+    for (auto name : names) cols.push_back(Column(name));
+    return ReadColumns(file, cols, columns, fallback);
+  }
+
   const unordered_map<std::string, int> &header() const {
     return header_;
   }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <charconv>
 #include <cmath>
 #include <string_view>
 #include <type_traits>
@@ -16,16 +17,32 @@ auto StrSplit(Args &&...args) {
   return absl::StrSplit(std::forward<Args>(args)...);
 }
 
+// std::from_chars of the whole of str, which is fast on plain numbers. The Safe* functions fall
+// back to absl for the rest, e.g. surrounding spaces, a leading '+' or out of range values, so
+// they accept the same strings either way.
+template <class T>
+bool FromChars(std::string_view str, T &out) {
+  auto end = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), end, out);
+  return ec == std::errc() && ptr == end;
+}
+
 template <class Int>
 bool SafeAtoi(std::string_view str, Int &out) {
-  return absl::SimpleAtoi(str, &out);
+  return FromChars(str, out) || absl::SimpleAtoi(str, &out);
 }
 
 inline bool SafeAtof(std::string_view str, float &out) {
+#ifdef __cpp_lib_to_chars
+  if (FromChars(str, out)) return true;
+#endif
   return absl::SimpleAtof(str, &out);
 }
 
 inline bool SafeAtod(std::string_view str, double &out) {
+#ifdef __cpp_lib_to_chars
+  if (FromChars(str, out)) return true;
+#endif
   return absl::SimpleAtod(str, &out);
 }
 
@@ -0,0 +1,131 @@
+#include "yang/util/task_pool.h"
+
+#include <algorithm>
+
+#include "yang/util/logging.h"
+
+namespace yang {
+
+TaskPool::TaskPool(int num_threads) {
+  for (int i = 0; i < num_threads; ++i) threads_.emplace_back([this]() { WorkerLoop(); });
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard guard(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &t : threads_) t.join();
+}
+
+void TaskPool::Submit(std::function<void()> fn) {
+  {
+    std::lock_guard guard(mutex_);
+    tasks_.push_back(std::move(fn));
+  }
+  cv_.notify_one();
+}
+
+TaskPool::Index TaskPool::GetGrain(Index begin, Index end, Index grain) const {
+  if (grain > 0) return grain;
+  constexpr int CHUNKS_PER_THREAD = 4;
+  return std::max<Index>(1, (end - begin) / (std::max(num_threads(), 1) * CHUNKS_PER_THREAD));
+}
+
+void TaskPool::ParallelFor(Index begin, Index end, Index grain, const RangeFunc &fn) {
+  if (begin >= end) return;
+  grain = GetGrain(begin, end, grain);
+  if (threads_.empty() || end - begin <= grain) {
+    fn(begin, end);
+    return;
+  }
+
+  auto job = std::make_shared<Job>();
+  job->fn = &fn;
+  job->begin = begin;
+  job->end = end;
+  job->grain = grain;
+  job->next = begin;
+  job->num_chunks = (end - begin + grain - 1) / grain;
+  {
+    std::lock_guard guard(mutex_);
+    jobs_.push_back(job);
+  }
+  cv_.notify_all();
+
+  while (RunChunk(*job)) {
+  }
+  {
+    std::lock_guard guard(mutex_);
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) jobs_.erase(it);
+  }
+  // wait for the chunks taken by the workers
+  std::unique_lock lock(job->mutex);
+  job->done_cv.wait(lock, [&]() { return job->done_chunks.load() == job->num_chunks; });
+  if (job->error) std::rethrow_exception(job->error);
+}
+
+bool TaskPool::RunChunk(Job &job) {
+  Index chunk_begin = job.next.fetch_add(job.grain);
+  if (chunk_begin >= job.end) return false;
+
+  bool failed;
+  {
+    std::lock_guard guard(job.mutex);
+    failed = job.error != nullptr;
+  }
+  if (!failed) {
+    try {
+      (*job.fn)(chunk_begin, std::min(job.end, chunk_begin + job.grain));
+    } catch (...) {
+      std::lock_guard guard(job.mutex);
+      if (!job.error) job.error = std::current_exception();
+    }
+  }
+  if (job.done_chunks.fetch_add(1) + 1 == job.num_chunks) {
+    std::lock_guard guard(job.mutex);
+    job.done_cv.notify_all();
+  }
+  return true;
+}
+
+namespace {
+
+thread_local TaskPool *current_pool = nullptr;
+
+}  // namespace
+
+TaskPool *TaskPool::Current() {
+  return current_pool;
+}
+
+void TaskPool::WorkerLoop() {
+  current_pool = this;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return stop_ || !jobs_.empty() || !tasks_.empty(); });
+    if (!jobs_.empty()) {
+      auto job = jobs_.front();
+      lock.unlock();
+      bool more = RunChunk(*job);
+      lock.lock();
+      if (!more && !jobs_.empty() && jobs_.front() == job) jobs_.pop_front();
+    } else if (!tasks_.empty()) {
+      auto task = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+      try {
+        task();
+      } catch (const std::exception &e) {
+        LOG_ERROR("Unhandled exception in task: {}", e.what());
+      }
+      lock.lock();
+    } else if (stop_) {
+      break;
+    }
+  }
+}
+
+}  // namespace yang
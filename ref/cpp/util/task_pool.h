@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace yang {
+
+// A fixed set of worker threads shared by the runner and the modules it runs.
+//
+// Tasks submitted with Submit (e.g. modules) occupy a worker each. ParallelFor splits a range into
+// chunks that idle workers pick up, and the calling thread works on its own chunks too, so it
+// never waits on busy workers and nested calls cannot deadlock. Chunks are preferred over new
+// tasks so that running tasks finish first.
+class TaskPool {
+ public:
+  using Index = int64_t;
+  using RangeFunc = std::function<void(Index, Index)>;
+
+  explicit TaskPool(int num_threads);
+
+  ~TaskPool();
+
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+
+  int num_threads() const {
+    return threads_.size();
+  }
+
+  // The pool whose worker runs the calling thread, nullptr outside of workers. Lets low level code,
+  // e.g. array copies, split work over the pool it already runs in instead of starting threads.
+  static TaskPool *Current();
+
+  // Run fn on a worker
+  void Submit(std::function<void()> fn);
+
+  // Call fn(chunk_begin, chunk_end) over [begin, end) in chunks of grain, 0 picks a grain that
+  // gives each thread a few chunks. The first exception is rethrown after all chunks finished.
+  void ParallelFor(Index begin, Index end, Index grain, const RangeFunc &fn);
+
+  static constexpr Index REDUCE_CHUNKS = 64;
+
+  // Reduce fn(chunk_begin, chunk_end) of all chunks with reduce, in the order of the chunks. 0
+  // picks a grain that splits the range into REDUCE_CHUNKS chunks, unlike ParallelFor regardless of
+  // the number of threads, so that with a fixed grain the result does not depend on the pool.
+  template <class T, class Fn, class Reduce>
+  T ParallelReduce(Index begin, Index end, Index grain, const T &init, const Fn &fn,
+                   const Reduce &reduce) {
+    if (begin >= end) return init;
+    grain = GetReduceGrain(begin, end, grain);
+    Index num_chunks = (end - begin + grain - 1) / grain;
+    std::vector<T> partials(num_chunks, init);
+    ParallelFor(0, num_chunks, 1, [&](Index chunk_begin, Index chunk_end) {
+      for (Index c = chunk_begin; c < chunk_end; ++c) {
+        partials[c] = fn(begin + c * grain, std::min(end, begin + (c + 1) * grain));
+      }
+    });
+    T ret = init;
+    for (auto &v : partials) ret = reduce(ret, v);
+    return ret;
+  }
+
+  // Serial fallbacks when there is no pool
+  static void ParallelFor(TaskPool *pool, Index begin, Index end, Index grain,
+                          const RangeFunc &fn) {
+    if (pool) {
+      pool->ParallelFor(begin, end, grain, fn);
+    } else if (begin < end) {
+      fn(begin, end);
+    }
+  }
+
+  template <class T, class Fn, class Reduce>
+  static T ParallelReduce(TaskPool *pool, Index begin, Index end, Index grain, const T &init,
+                          const Fn &fn, const Reduce &reduce) {
+    if (pool) return pool->ParallelReduce(begin, end, grain, init, fn, reduce);
+    // the same chunks as on a pool
+    grain = GetReduceGrain(begin, end, grain);
+    T ret = init;
+    for (Index b = begin; b < end; b += grain) ret = reduce(ret, fn(b, std::min(end, b + grain)));
+    return ret;
+  }
+
+ private:
+  struct Job {
+    const RangeFunc *fn;
+    Index begin;
+    Index end;
+    Index grain;
+    std::atomic<Index> next;
+    std::atomic<Index> done_chunks{0};
+    Index num_chunks;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done_cv;
+  };
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::deque<std::function<void()>> tasks_;
+  bool stop_ = false;
+
+  Index GetGrain(Index begin, Index end, Index grain) const;
+
+  static Index GetReduceGrain(Index begin, Index end, Index grain) {
+    if (grain > 0) return grain;
+    return std::max<Index>(1, (end - begin + REDUCE_CHUNKS - 1) / REDUCE_CHUNKS);
+  }
+
+  void WorkerLoop();
+
+  // Run one chunk of job, false if all chunks are taken
+  bool RunChunk(Job &job);
+};
+
+}  // namespace yang
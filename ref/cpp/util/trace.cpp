@@ -0,0 +1,122 @@
+#include "yang/util/trace.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include "yang/util/logging.h"
+
+namespace yang {
+
+static void WriteJsonString(std::ostream &os, std::string_view s) {
+  os << '"';
+  for (char c : s) {
+    switch (c) {
+      case '"':
+        os << "\\\"";
+        break;
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      case '\t':
+        os << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          os << fmt::format("\\u{:04x}", static_cast<int>(c));
+        } else {
+          os << c;
+        }
+    }
+  }
+  os << '"';
+}
+
+Tracer &Tracer::Get() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::Start() {
+  std::lock_guard guard(mutex_);
+  events_.clear();
+  origin_ = std::chrono::steady_clock::now();
+  enabled_ = true;
+}
+
+void Tracer::Stop() {
+  enabled_ = false;
+}
+
+int64_t Tracer::Now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                               origin_)
+      .count();
+}
+
+int Tracer::GetThreadId() {
+  static std::atomic<int> next_id{0};
+  thread_local int id = next_id++;
+  return id;
+}
+
+void Tracer::Complete(std::string_view name, std::string_view category, int64_t start_us,
+                      int64_t end_us, Args args) {
+  if (!enabled()) return;
+  Event event{std::string(name), std::string(category), 'X', start_us, end_us - start_us,
+              GetThreadId(), std::move(args)};
+  std::lock_guard guard(mutex_);
+  events_.push_back(std::move(event));
+}
+
+void Tracer::Instant(std::string_view name, std::string_view category, Args args) {
+  if (!enabled()) return;
+  Event event{std::string(name), std::string(category), 'i', Now(), 0, GetThreadId(),
+              std::move(args)};
+  std::lock_guard guard(mutex_);
+  events_.push_back(std::move(event));
+}
+
+void Tracer::Save(const std::string &path) const {
+  std::ofstream ofs(path);
+  if (!ofs) throw MakeExcept<IoError>("Failed to open trace file {}", path);
+
+  int pid = getpid();
+  std::lock_guard guard(mutex_);
+  ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < events_.size(); ++i) {
+    auto &event = events_[i];
+    if (i > 0) ofs << ',';
+    ofs << "\n{\"name\":";
+    WriteJsonString(ofs, event.name);
+    ofs << ",\"cat\":";
+    WriteJsonString(ofs, event.category);
+    ofs << ",\"ph\":\"" << event.phase << "\",\"ts\":" << event.ts;
+    if (event.phase == 'X') {
+      ofs << ",\"dur\":" << event.dur;
+    } else {
+      // thread scoped instant
+      ofs << ",\"s\":\"t\"";
+    }
+    ofs << ",\"pid\":" << pid << ",\"tid\":" << event.tid;
+    if (!event.args.empty()) {
+      ofs << ",\"args\":{";
+      for (size_t j = 0; j < event.args.size(); ++j) {
+        if (j > 0) ofs << ',';
+        WriteJsonString(ofs, event.args[j].first);
+        ofs << ':';
+        WriteJsonString(ofs, event.args[j].second);
+      }
+      ofs << '}';
+    }
+    ofs << '}';
+  }
+  ofs << "\n]}\n";
+  ENSURE(ofs.good(), "Failed to write trace file {}", path);
+  LOG_INFO("Saved {} trace events to {}", events_.size(), path);
+}
+
+}  // namespace yang
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace yang {
+
+// Records a timeline of spans and instant events of the current process, saved as Chrome trace
+// JSON which chrome://tracing and Perfetto open. Recording is off until Start, and costs a single
+// atomic load per event otherwise.
+class Tracer {
+ public:
+  using Args = std::vector<std::pair<std::string, std::string>>;
+
+  static Tracer &Get();
+
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void Start();
+
+  void Stop();
+
+  // Microseconds since Start
+  int64_t Now() const;
+
+  // A span of [start_us, end_us) on the calling thread
+  void Complete(std::string_view name, std::string_view category, int64_t start_us,
+                int64_t end_us, Args args = {});
+
+  // A point event on the calling thread
+  void Instant(std::string_view name, std::string_view category, Args args = {});
+
+  void Save(const std::string &path) const;
+
+ private:
+  struct Event {
+    std::string name;
+    std::string category;
+    char phase;
+    int64_t ts;
+    int64_t dur;
+    int tid;
+    Args args;
+  };
+
+  std::atomic<bool> enabled_{false};
+  std::chrono::steady_clock::time_point origin_;
+  mutable std::mutex mutex_;
+  std::vector<Event> events_;
+
+  // Small sequential ids, stable per thread, read better than native thread ids
+  static int GetThreadId();
+};
+
+// Records a span from construction to destruction when tracing is enabled
+class TraceScope {
+ public:
+  TraceScope(std::string_view name, std::string_view category) {
+    auto &tracer = Tracer::Get();
+    if (tracer.enabled()) {
+      name_ = name;
+      category_ = category;
+      start_us_ = tracer.Now();
+    }
+  }
+
+  ~TraceScope() {
+    if (start_us_ >= 0) {
+      auto &tracer = Tracer::Get();
+      tracer.Complete(name_, category_, start_us_, tracer.Now(), std::move(args_));
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  bool enabled() const {
+    return start_us_ >= 0;
+  }
+
+  template <class T>
+  void AddArg(std::string key, const T &value) {
+    if (start_us_ < 0) return;
+    if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      args_.emplace_back(std::move(key), std::string(std::string_view(value)));
+    } else {
+      args_.emplace_back(std::move(key), std::to_string(value));
+    }
+  }
+
+ private:
+  std::string name_;
+  std::string category_;
+  int64_t start_us_ = -1;
+  Tracer::Args args_;
+};
+
+}  // namespace yang
+
+#define YANG_TRACE_CONCAT_IMPL(a, b) a##b
+#define YANG_TRACE_CONCAT(a, b) YANG_TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name, category) \
+  ::yang::TraceScope YANG_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
@@ -4,6 +4,8 @@
 #include <string_view>
 #include <type_traits>
 
+#include "yang/base/float16.h"
+
 namespace yang {
 
 template <class T>
@@ -18,6 +20,8 @@ consteval std::string_view GetTypeName() {
   if constexpr (std::is_same_v<T, uint64_t>) return "uint64";
   if constexpr (std::is_same_v<T, float>) return "float";
   if constexpr (std::is_same_v<T, double>) return "double";
+  if constexpr (std::is_same_v<T, float16>) return "float16";
+  if constexpr (std::is_same_v<T, bfloat16>) return "bfloat16";
 
   std::string_view full = __PRETTY_FUNCTION__;
 #ifdef __clang__
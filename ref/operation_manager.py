@@ -51,3 +51,22 @@ class OperationManager(object):
             sig_out = sig_out.data
         ops = self.parse_ops(ops)
         self.op_manager.apply(sig_in, sig_out, start_di, end_di, ops)
+
+    def apply_batch(
+        self,
+        sigs_in: list[Array | np.array] | np.array,
+        sigs_out: list[Array | np.array] | np.array,
+        start_di: int,
+        end_di: int,
+        ops: str | list[dict],
+        num_threads: int = 8,
+    ) -> None:
+        """
+        Applies the same ops to each signal, given as lists or 3-D arrays of (dates, univ) signals.
+        The operations are set up once and the GIL is released for the whole batch, which runs on
+        num_threads threads if all operations are row independent.
+        """
+        sigs_in = [sig.data if isinstance(sig, Array) else sig for sig in sigs_in]
+        sigs_out = [sig.data if isinstance(sig, Array) else sig for sig in sigs_out]
+        ops = self.parse_ops(ops)
+        self.op_manager.apply_batch(sigs_in, sigs_out, start_di, end_di, ops, num_threads)
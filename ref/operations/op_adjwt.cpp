@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 #include "yang/sim/operation.h"
@@ -13,6 +16,49 @@ struct OpAdjWtBase : yang::Operation {
 
   using yang::Operation::Apply;
 
+  // the cap at which a short weight becomes limited by its quota
+  struct Break {
+    double cap;
+    double weight;
+    double quota;
+
+    bool operator<(const Break &other) const {
+      return cap < other.cap;
+    }
+  };
+
+  // The supremum of the caps c with sum(min(c * w, quota)) > similarity * c over the short weights
+  // -w with quota. The ratio sum(min(w, quota / c)) decreases in c and is
+  // A + Q / c between breaks, where A sums the weights not limited by quota yet and Q sums the
+  // quotas of the others, so the crossing is solved exactly in one pass over the sorted breaks.
+  static double FindMaxCap(MatView<float> sig, yang::math::MatView<const float> quota,
+                           int univ_size, int di, double similarity, std::vector<Break> &breaks) {
+    breaks.clear();
+    double a = 0;
+    for (int ii = 0; ii < univ_size; ++ii) {
+      if (sig(di, ii) < 0 && quota(di, ii) > 0) {
+        double w = -sig(di, ii);
+        breaks.push_back({quota(di, ii) / w, w, quota(di, ii)});
+        a += w;
+      }
+    }
+    std::sort(breaks.begin(), breaks.end());
+
+    double q = 0;
+    double prev = 0;
+    for (auto &b : breaks) {
+      if (a + q / b.cap <= similarity) {
+        return similarity > a ? std::max(prev, q / (similarity - a)) : prev;
+      }
+      a -= b.weight;
+      q += b.quota;
+      prev = b.cap;
+    }
+    // all weights limited by quota
+    if (similarity <= 0) return std::numeric_limits<double>::infinity();
+    return std::max(prev, q / similarity);
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
     Apply(sig, env, start_di, end_di, args.at(0), yang::CheckAtod(args.at(1)),
@@ -29,6 +75,7 @@ struct OpAdjWtBase : yang::Operation {
     auto quota = env.ReadData<yang::Array<float>>("sup_univ", index + "_member")->mat_view();
 
     std::vector<bool> fixed(env.univ_size());
+    std::vector<Break> breaks;
     for (int di = start_di; di < end_di; ++di) {
       for (int ii = 0; ii < env.univ_size(); ++ii) {
         fixed[ii] = halt(di, ii);
@@ -37,25 +84,8 @@ struct OpAdjWtBase : yang::Operation {
                       (close(di - 1, ii) < limit_down(di - 1, ii) * 1.001);
         }
       }
-      double target_cap = 0;
-      double cap_max = cap_upper;
-      double cap_min = cap_lower;
-      while (cap_max - cap_min >= step) {
-        double cap = (cap_max + cap_min) / 2;
-        double sum = 0;
-        for (int ii = 0; ii < env.univ_size(); ++ii) {
-          if (sig(di, ii) < 0 && quota(di, ii) > 0) {
-            sum += std::min<double>(cap * -sig(di, ii), quota(di, ii));
-          }
-        }
-        // assuming the sum of neg weight equals -1
-        if (sum > similarity * cap * 1.0) {
-          cap_min = cap;
-          target_cap = cap;
-        } else {
-          cap_max = cap;
-        }
-      }
+      double cap = FindMaxCap(sig, quota, env.univ_size(), di, similarity, breaks);
+      double target_cap = cap > cap_lower ? std::min(cap, cap_upper) : 0;
       if (target_cap == 0) {
         double usable_quota = 0;
         for (int ii = 0; ii < env.univ_size(); ++ii) {
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cmath>
+#include <functional>
 
 #include "yang/math/mat_ops.h"
 #include "yang/sim/operation.h"
@@ -9,50 +11,46 @@ namespace {
 struct OpBoundSize : yang::Operation {
   using yang::Operation::Apply;
 
+  bool row_independent() const final {
+    return true;
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
     Apply(sig, env, start_di, end_di, std::stof(args[0]));
   }
 
+  // Caps the long weights at bound times their sum and rescales the others to keep the sum, i.e.
+  // w = min(cap, r * sig) with r solving sum(w) = sum(sig). The weights are sorted once, the
+  // largest k are capped where k is the smallest count for which no rescaled weight exceeds the
+  // cap.
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di, float bound_) {
+    std::vector<std::pair<float, int>> pos;
     for (int di = start_di; di < end_di; di++) {
-      float sum_tt = 0.;
-      std::vector<int> iis = {};
+      double sum_tt = 0.;
+      pos.clear();
       for (int ii = 0; ii < env.univ_size(); ii++) {
         if (sig(di, ii) > 0.) {
           sum_tt += sig(di, ii);
-          iis.push_back(ii);
+          pos.emplace_back(sig(di, ii), ii);
         }
       }
-      float bound = std::max(1 / float(iis.size()), bound_);
-      float sum_ = sum_tt;
-      float bound_x = bound * sum_tt;
-      bool flag_run = true;
-      while (flag_run) {
-        flag_run = false;
-        float sum_var = 0.;
-        std::vector<int> iis_tmp = {};
-        for (int ii : iis) {
-          if (sig(di, ii) > bound_x) {
-            sum_ -= bound_x;
-            sig(di, ii) = bound_x;
-          } else if (sig(di, ii) > 0.) {
-            sum_var += sig(di, ii);
-            iis_tmp.push_back(ii);
-          }
-        }
-        iis = iis_tmp;
-        float r = sum_ / sum_var;
-        for (auto ii : iis) {
-          sig(di, ii) *= r;
-          if (sig(di, ii) > bound_x) {
-            flag_run = true;
-          }
-        }
+      int n = pos.size();
+      if (n == 0) continue;
+      // at least 1/n so that the capped weights can still add up to the sum
+      double bound_x = std::max(1 / double(n), double(bound_)) * sum_tt;
+      std::sort(pos.begin(), pos.end(), std::greater<>());
+
+      int k = 0;
+      double rest = sum_tt;  // sum of the uncapped weights
+      double r = 1.;
+      for (; k < n; ++k) {
+        r = (sum_tt - k * bound_x) / rest;
+        if (pos[k].first * r <= bound_x) break;
+        rest -= pos[k].first;
       }
-      for (int ii = 0; ii < env.univ_size(); ii++) {
-        if (sig(di, ii) > bound_x)
-          LOG_INFO("({}, {}), {} :{}, {} : {}", di, ii, bound, sum_tt, sum_, sig(di, ii));
+      for (int j = 0; j < n; ++j) {
+        sig(di, pos[j].second) = j < k ? bound_x : pos[j].first * r;
       }
     }
   }
@@ -61,6 +59,10 @@ struct OpBoundSize : yang::Operation {
 struct OpBoundDvol : yang::Operation {
   using yang::Operation::Apply;
 
+  bool row_independent() const final {
+    return true;
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
     Apply(sig, env, start_di, end_di, args[0], std::stof(args[1]), std::stof(args[2]));
@@ -3,7 +3,6 @@
 #include <cmath>
 
 #include "yang/math/mat_ops.h"
-#include "yang/math/ops.h"
 #include "yang/util/strings.h"
 
 namespace yao {
@@ -24,15 +23,8 @@ void OpLimitRounding::ApplyImpl(MatView<float> sig, const yang::Env &env, int st
   auto limit_down = env.ReadData<yang::Array<float>>("base", "limit_down")->mat_view();
   auto halt = env.ReadData<yang::Array<bool>>("base", "halt")->mat_view();
 
-  auto i_close_ = env.ReadData<yang::Array<float>>("ibase", "i_close");
-
-  yang::Array<float> i_close(i_close_->shape());
-  int fill_lookback = 1000;
-  int offset = std::max(0, start_di - fill_lookback);
-  for (int ii = 0; ii < (int)env.univ_size(); ii++) {
-    yang::math::ops::ffill(i_close_->col_vec(ii).begin() + offset, i_close_->col_vec(ii).end(),
-                           i_close.col_vec(ii).begin() + offset, fill_lookback);
-  }
+  // shared by all limit operations of the run
+  auto &i_close = *env.GetFilledArray("ibase/i_close", 1000);
 
   for (int di = start_di; di < end_di; di++) {
     std::vector<int64_t> iis_pos = {};
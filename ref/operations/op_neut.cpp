@@ -5,23 +5,23 @@
 
 namespace {
 
-struct OpNeut : yang::Operation {
-  using yang::Operation::Apply;
+struct OpNeut : yang::RowOperation {
+  const yang::Array<int> *group_arr = nullptr;
 
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
-             const std::vector<std::string> &args) final {
-    Apply(sig, env, start_di, end_di, std::string(args.at(0)));
-  }
-
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
-             const std::string &group) {
+  void Prepare(const yang::Env &env, const std::vector<std::string> &args) final {
+    auto &group = args.at(0);
     if (group != "cty" && group != "sector" && group != "industry" && group != "subindustry") {
       throw yang::InvalidArgument("Invalid OpNeut group " + group);
     }
-    auto *group_arr = env.ReadData<yang::Array<int>>("base", group);
-    auto mat = sig.block(start_di, 0, end_di - start_di, env.univ_size());
-    auto g_mat = group_arr->mat_view().block(start_di, 0, end_di - start_di, env.univ_size());
-    yang::math::ops::group_demean(mat, g_mat);
+    group_arr = env.ReadData<yang::Array<int>>("base", group);
+  }
+
+  void ApplyRow(MatView<float> sig, const yang::Env &env, int di) final {
+    auto row = sig.block(di, 0, 1, env.univ_size());
+    auto g_row = group_arr->mat_view().block(di, 0, 1, env.univ_size());
+    // rows may run on several workers
+    thread_local yang::math::ops::GroupAggregator<float> agg;
+    yang::math::ops::group_demean(row, g_row, row, agg);
   }
 };
 
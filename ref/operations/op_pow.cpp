@@ -4,17 +4,15 @@
 
 namespace {
 
-struct OpPow : yang::Operation {
-  using yang::Operation::Apply;
+struct OpPow : yang::RowOperation {
+  float exp = 1;
 
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
-             const std::vector<std::string> &args) final {
-    Apply(sig, env, start_di, end_di, yang::CheckAtof(args.at(0)));
+  void Prepare(const yang::Env &env, const std::vector<std::string> &args) final {
+    exp = yang::CheckAtof(args.at(0));
   }
 
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di, float exp) {
-    auto mat = sig.block(start_di, 0, end_di - start_di, env.univ_size());
-    yang::math::ops::spow(mat, exp);
+  void ApplyRow(MatView<float> sig, const yang::Env &env, int di) final {
+    yang::math::ops::spow(sig.block(di, 0, 1, env.univ_size()), exp);
   }
 };
 
@@ -4,11 +4,15 @@
 namespace {
 
 struct OpRank : yang::Operation {
+  bool row_independent() const final {
+    return true;
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di) final {
+    auto listing = env.ReadData<yang::Array<bool>>("env", "listing")->mat_view();
+    // rows are ranked independently, the OperationManager splits them over the workers
     auto mat = sig.block(start_di, 0, end_di - start_di, env.univ_size());
-    auto listing = yang::Array<bool>::MMap(env.cache_dir().GetPath("env", "listing"));
-    yang::math::ops::filter(
-        mat, listing.mat_view().block(start_di, 0, end_di - start_di, env.univ_size()));
+    yang::math::ops::filter(mat, listing.block(start_di, 0, end_di - start_di, env.univ_size()));
     yang::math::ops::rank(mat, 1e-6);
   }
 };
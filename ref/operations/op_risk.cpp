@@ -1,14 +1,61 @@
+#include <algorithm>
 #include <cmath>
 
+#include "yang/math/eigen.h"
 #include "yang/math/mat_ops.h"
 #include "yang/sim/operation.h"
 #include "yang/util/strings.h"
 
 namespace {
 
+// Matches the risk factor exposures of the long signal to those of the csi500 index.
+//
+// The weights w of each day are the projection of the normalized signal w0 onto
+//   {w >= 0, sum(w) = 1, Z' w = target}
+// i.e. the closest weights to the signal with the index exposures. With A = [Z, 1] and b the
+// targets, the KKT conditions give w = max(0, w0 + A lambda) for multipliers lambda maximizing the
+// concave dual
+//   b' lambda - |max(0, w0 + A lambda)|^2 / 2
+// whose gradient is the exposure residual b - A' w. It is solved with damped Newton steps on the
+// active set {w0 + A lambda > 0}: a stock dropped at 0 enters again as soon as its bound
+// multiplier -(w0 + A lambda) turns negative. Infeasible targets, e.g. fewer long stocks than
+// factors or targets out of their range, leave the dual unbounded, such days keep the normalized
+// signal and are reported.
 struct OpRisk : yang::Operation {
   using yang::Operation::Apply;
 
+  static constexpr int MAX_ITERS = 100;
+  static constexpr int MAX_HALVINGS = 60;
+  static constexpr double TOLERANCE = 1e-6;
+  // keeps the Newton system solvable when there are fewer active stocks than constraints
+  static constexpr double RIDGE = 1e-10;
+
+  using RowMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+  struct Workspace {
+    std::vector<int> iis;
+    RowMatrix a;  // rows of the constraint matrix [Z, 1] of the long stocks
+    Eigen::VectorXd w0;
+    Eigen::VectorXd w;
+    Eigen::VectorXd b;
+    Eigen::VectorXd lambda;
+    Eigen::VectorXd next_lambda;
+    Eigen::VectorXd step;
+    Eigen::MatrixXd normal;
+    Eigen::VectorXd rhs;
+  };
+
+  struct Stats {
+    int days = 0;
+    int iters = 0;
+    int infeasible = 0;
+    double max_residual = 0;
+  };
+
+  bool row_independent() const final {
+    return true;
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
     std::map<std::string, std::string> mp = {{"carra", "B_risk_carra_cne5"},
@@ -21,112 +68,156 @@ struct OpRisk : yang::Operation {
     std::vector<std::string> names(args.begin() + 1, args.end());
     auto member = env.ReadData<yang::Array<float>>("sup_univ/csi500_member")->mat_view();
 
-    int rsize = names.size();
-
     std::vector<yang::math::MatView<const float>> rf = {};
-
     for (const std::string &rfactor : names) {
       rf.push_back(
           env.ReadData<yang::Array<float>>(fmt::format("{0}/{1}", mp.at(rdata_name), rfactor))
               ->mat_view());
     }
 
-    auto univ_size = env.univ_size();
+    Workspace ws;
+    ws.a.resize(env.univ_size(), rf.size() + 1);
+    Stats stats;
     for (int di = start_di; di < end_di; di++) {
-      std::vector<std::vector<float>> val_norm =
-          std::vector<std::vector<float>>(rsize, std::vector<float>(univ_size, NAN));
+      SolveDay(sig, env.univ_size(), di, member, rf, ws, stats);
+    }
+    if (stats.days > 0) {
+      LOG_DEBUG("OpRisk {} - {}: {} iterations per day, max residual {}", start_di, end_di,
+                static_cast<double>(stats.iters) / stats.days, stats.max_residual);
+    }
+    if (stats.infeasible > 0) {
+      LOG_WARN("OpRisk {} - {}: {} of {} days can not meet the exposure targets, kept the signal",
+               start_di, end_di, stats.infeasible, stats.days);
+    }
+  }
 
-      float sum_sig = 0.;
-      for (int ii = 0; ii < univ_size; ii++) {
-        if (sig(di, ii) > 0.) sum_sig += sig(di, ii);
+  static void SolveDay(MatView<float> sig, int univ_size, int di,
+                       yang::math::MatView<const float> member,
+                       const std::vector<yang::math::MatView<const float>> &rf, Workspace &ws,
+                       Stats &stats) {
+    int rsize = rf.size();
+    int m = rsize + 1;
+
+    // normalized long signal
+    double sum_sig = 0;
+    ws.iis.clear();
+    for (int ii = 0; ii < univ_size; ii++) {
+      if (sig(di, ii) > 0.) {
+        sum_sig += sig(di, ii);
+        ws.iis.push_back(ii);
+      } else {
+        sig(di, ii) = NAN;
       }
+    }
+    int n = ws.iis.size();
+    if (n == 0) return;
+    ws.w0.resize(n);
+    for (int j = 0; j < n; ++j) ws.w0[j] = sig(di, ws.iis[j]) / sum_sig;
+
+    // normalized factors of the long stocks and the index exposures, stocks without a factor value
+    // have no exposure to it
+    ws.b.resize(m);
+    for (int ri = 0; ri < rsize; ri++) {
+      auto &rdata = rf[ri];
+      int cnt = 0;
+      double mean = 0.;
+      double sq = 0.;
       for (int ii = 0; ii < univ_size; ii++) {
-        if (sig(di, ii) > 0.) {
-          sig(di, ii) /= sum_sig;
-        } else {
-          sig(di, ii) = 0.;
+        auto val = rdata(di, ii);
+        if (std::isfinite(val)) {
+          cnt++;
+          mean += val;
+          sq += val * val;
         }
       }
-      for (int ri = 0; ri < rsize; ri++) {
-        auto rdata = rf[ri];
-        int cnt = 0;
-        float mean = 0.;
-        float std = 0.;
-        for (int ii = 0; ii < univ_size; ii++) {
-          auto val = rdata(di, ii);
-          if (std::isfinite(val)) {
-            cnt++;
-            mean += val;
-            std += val * val;
-          }
-        }
-        mean /= cnt;
-        std = pow(std / cnt, 0.5);
-        if (!std::isfinite(std) && di > 300) {
-          LOG_ERROR("Invalid std: {} {}", di, std);
-        }
-        for (int ii = 0; ii < univ_size; ii++) {
-          auto val = rdata(di, ii);
-          if (std::isfinite(val)) {
-            val_norm[ri][ii] = (val - mean) / std;
-          }
-        }
+      mean /= cnt;
+      double stdev = std::sqrt(sq / cnt);
+      if (!std::isfinite(stdev) && di > 300) {
+        LOG_ERROR("Invalid std: {} {}", di, stdev);
       }
 
-      std::vector<float> target = std::vector<float>(names.size(), 0.);
-      for (int ri = 0; ri < (int)names.size(); ri++) {
-        float idx_expo = 0.;
-        float idx_wt = 0.;
-        for (int ii = 0; ii < univ_size; ii++) {
-          if (std::isfinite(member(di, ii)) && std::isfinite(val_norm[ri][ii])) {
-            idx_wt += member(di, ii);
-            idx_expo += member(di, ii) * val_norm[ri][ii];
-          }
+      double idx_expo = 0.;
+      double idx_wt = 0.;
+      for (int ii = 0; ii < univ_size; ii++) {
+        auto val = rdata(di, ii);
+        if (std::isfinite(member(di, ii)) && std::isfinite(val)) {
+          idx_wt += member(di, ii);
+          idx_expo += member(di, ii) * (val - mean) / stdev;
         }
-        target[ri] = idx_expo / idx_wt;
       }
+      ws.b[ri] = idx_expo / idx_wt;
+      for (int j = 0; j < n; ++j) {
+        auto val = rdata(di, ws.iis[j]);
+        ws.a(j, ri) = std::isfinite(val) ? (val - mean) / stdev : 0.;
+      }
+    }
+    for (int j = 0; j < n; ++j) ws.a(j, rsize) = 1.;
+    ws.b[rsize] = 1.;
 
-      int iters = 200;
-      // int iters = 1;
-      int iter = 0;
-      while (iter < iters) {
-        iter++;
-        std::vector<float> delta = std::vector<float>(univ_size, 0.);
-        for (int ri = 0; ri < (int)names.size(); ri++) {
-          std::vector<int> index;
-          std::vector<float> alpha_value;
-          float alphas_sum = 0.0;
-          float size_sum = 0.0;
-          float size_size_sum = 0.0;
-          float size_alpha_sum = 0.0;
-          for (int ii = 0; ii < univ_size; ++ii) {
-            if (sig(di, ii) > 0. && std::isfinite(val_norm[ri][ii])) {
-              index.push_back(ii);
-              alpha_value.push_back(sig(di, ii));
-              alphas_sum += sig(di, ii);
-              size_sum += val_norm[ri][ii];
-              size_size_sum += val_norm[ri][ii] * val_norm[ri][ii];
-              size_alpha_sum += sig(di, ii) * val_norm[ri][ii];
-            }
-          }
-
-          float lambda = (size_alpha_sum / alphas_sum - target[ri]) /
-                         (target[ri] * size_sum - size_size_sum) / 2.0 / 20.;
-          float times = 1 / (1 + lambda * size_sum);
-          for (int l = 0; l < (int)index.size(); l++) {
-            delta[index[l]] += -sig(di, index[l]) + times * (alpha_value[l] / alphas_sum +
-                                                             lambda * val_norm[ri][index[l]]);
-          }
-        }
-        for (int ii = 0; ii < univ_size; ++ii) {
-          if (sig(di, ii) > 0.) sig(di, ii) += delta[ii] / names.size();
-          if (sig(di, ii) <= 0) {
-            sig(di, ii) = NAN;
-          }
+    auto a = ws.a.topRows(n);
+    if (!ws.b.allFinite() || !a.allFinite()) {
+      // no targets, e.g. missing index weights, keep the normalized signal
+      for (int j = 0; j < n; ++j) sig(di, ws.iis[j]) = ws.w0[j];
+      return;
+    }
+
+    stats.days++;
+    ws.lambda.setZero(m);
+    double value = Dual(a, ws.lambda, ws);
+    // the gradient of the dual into rhs, returns the largest exposure residual
+    auto gradient = [&]() {
+      ws.rhs.noalias() = ws.b - a.transpose() * ws.w;
+      return ws.rhs.cwiseAbs().maxCoeff();
+    };
+    double residual = gradient();
+    int iter = 0;
+    for (; iter < MAX_ITERS && residual > TOLERANCE; ++iter) {
+      // Newton step on the active stocks, rhs holds the gradient
+      ws.normal.setZero(m, m);
+      for (int j = 0; j < n; ++j) {
+        if (ws.w[j] > 0.) {
+          ws.normal.selfadjointView<Eigen::Lower>().rankUpdate(a.row(j).transpose());
         }
       }
+      ws.normal.diagonal().array() += RIDGE;
+      ws.step = ws.normal.selfadjointView<Eigen::Lower>().ldlt().solve(ws.rhs);
+
+      // backtrack until the dual increases enough
+      double slope = ws.rhs.dot(ws.step);
+      double t = 1.;
+      double next_value = 0.;
+      int halvings = 0;
+      for (; halvings < MAX_HALVINGS; ++halvings, t /= 2) {
+        ws.next_lambda = ws.lambda + t * ws.step;
+        next_value = Dual(a, ws.next_lambda, ws);
+        if (next_value >= value + 1e-4 * t * slope) break;
+      }
+      if (halvings == MAX_HALVINGS) break;
+      ws.lambda.swap(ws.next_lambda);
+      value = next_value;
+      residual = gradient();
+    }
+    stats.iters += iter;
+    stats.max_residual = std::max(stats.max_residual, residual);
+
+    if (residual > TOLERANCE) {
+      // the targets can not be met, keep the normalized signal
+      stats.infeasible++;
+      for (int j = 0; j < n; ++j) sig(di, ws.iis[j]) = ws.w0[j];
+      return;
+    }
+    for (int j = 0; j < n; ++j) {
+      sig(di, ws.iis[j]) = ws.w[j] > 0. ? ws.w[j] : NAN;
     }
   }
+
+  // The dual objective at lambda, with the weights max(0, w0 + A lambda) in ws.w
+  template <class A>
+  static double Dual(const A &a, const Eigen::VectorXd &lambda, Workspace &ws) {
+    ws.w.noalias() = ws.w0 + a * lambda;
+    ws.w = ws.w.cwiseMax(0.);
+    return ws.b.dot(lambda) - ws.w.squaredNorm() / 2;
+  }
 };
 
 REGISTER_OPERATION("risk", OpRisk);
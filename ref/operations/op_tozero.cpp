@@ -4,25 +4,24 @@
 
 namespace {
 
-struct OpTozero : yang::Operation {
-  using yang::Operation::Apply;
+struct OpTozero : yang::RowOperation {
+  float lower = 0;
+  float upper = 0;
 
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
-             const std::vector<std::string> &args) final {
+  void Prepare(const yang::Env &env, const std::vector<std::string> &args) final {
     if (args.size() == 1) {
-      Apply(sig, env, start_di, end_di, -yang::CheckAtof(args.at(0)), yang::CheckAtof(args.at(0)));
+      lower = -yang::CheckAtof(args.at(0));
+      upper = yang::CheckAtof(args.at(0));
     } else {
-      Apply(sig, env, start_di, end_di, yang::CheckAtof(args.at(0)), yang::CheckAtof(args.at(1)));
+      lower = yang::CheckAtof(args.at(0));
+      upper = yang::CheckAtof(args.at(1));
     }
   }
 
-  void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di, float lower,
-             float upper) {
-    for (int di = start_di; di < end_di; di++) {
-      for (int ii = 0; ii < env.univ_size(); ii++) {
-        if (sig(di, ii) > lower && sig(di, ii) < upper) {
-          sig(di, ii) = 0.;
-        }
+  void ApplyRow(MatView<float> sig, const yang::Env &env, int di) final {
+    for (int ii = 0; ii < env.univ_size(); ii++) {
+      if (sig(di, ii) > lower && sig(di, ii) < upper) {
+        sig(di, ii) = 0.;
       }
     }
   }
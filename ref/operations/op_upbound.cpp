@@ -7,6 +7,10 @@ namespace {
 struct OpUpbound : yang::Operation {
   using yang::Operation::Apply;
 
+  bool row_independent() const final {
+    return true;
+  }
+
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
     Apply(sig, env, start_di, end_di, yang::CheckAtoi(args.at(0)));
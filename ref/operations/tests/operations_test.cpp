@@ -0,0 +1,219 @@
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "yang/sim/operation_manager.h"
+#include "yang/util/logging.h"
+
+namespace yang {
+namespace {
+
+constexpr int NUM_STOCKS = 40;
+constexpr int CHUNK_ROWS = 7;
+// the weights are written as floats
+constexpr double RISK_TOLERANCE = 1e-5;
+
+fs::path GetTestDir() {
+  return fs::temp_directory_path() / "operations_test";
+}
+
+Config MakeConfig() {
+  return Config::Load(fmt::format(
+      "cache: {}\nuniv_start_date: 20200101\nuniv_end_date: 20200304\ntrade_dates: {}\n"
+      "sec_master: {}\nmax_univ_size: 64\nuniv_indices_id_start: 60\n",
+      (GetTestDir() / "cache").native(), (GetTestDir() / "trade_dates.csv").native(),
+      (GetTestDir() / "sec_master.csv").native()));
+}
+
+// A deterministic value in [-1, 1)
+float GetValue(int di, int ii, int seed) {
+  return static_cast<float>((di * 131 + ii * 71 + seed * 37) % 97) / 48.5f - 1;
+}
+
+template <class T>
+Array<T> MakeArray(const Env &env, std::string_view mod, std::string_view data) {
+  auto path = env.cache_dir().GetPath(mod, data);
+  fs::create_directories(fs::path(path).parent_path());
+  return Array<T>::MMap(path, {env.max_datetimes_size(), env.max_univ_size()});
+}
+
+// 60 dates, stocks listed from the start and some delisted on the way, the csi500 members and
+// industries, and two barra factors
+void BuildEnv() {
+  fs::create_directories(GetTestDir());
+  std::ofstream dates(GetTestDir() / "trade_dates.csv");
+  for (int month = 1; month <= 6; ++month) {
+    for (int day = 1; day <= 28; ++day) dates << 20200000 + month * 100 + day << "\n";
+  }
+  dates.close();
+  std::ofstream sec_master(GetTestDir() / "sec_master.csv");
+  sec_master << "sid|list|delist\n";
+  for (int k = 0; k < NUM_STOCKS; ++k) {
+    sec_master << fmt::format("S{:02}|20200101|{}\n", k, k % 9 == 4 ? "20200210" : "");
+  }
+  sec_master.close();
+
+  Env env;
+  env.Initialize(MakeConfig());
+  env.Build();
+  auto member = MakeArray<float>(env, "sup_univ", "csi500_member");
+  auto industry = MakeArray<int32_t>(env, "base", "industry");
+  auto size = MakeArray<float>(env, "R_barra_cne5", "size");
+  auto beta = MakeArray<float>(env, "R_barra_cne5", "beta");
+  for (int di = 0; di < env.dates_size(); ++di) {
+    for (int ii = 0; ii < env.univ_size(); ++ii) {
+      member(di, ii) = ii % 3 == 0 ? NAN : 1 + GetValue(di, ii, 1);
+      industry(di, ii) = ii % 11 == 7 ? -1 : ii % 5;
+      size(di, ii) = ii % 13 == 2 ? NAN : GetValue(di, ii, 2);
+      beta(di, ii) = GetValue(di, ii, 3) + 0.5f * GetValue(di, ii, 4);
+    }
+  }
+}
+
+std::vector<float> MakeSignal(const Env &env) {
+  std::vector<float> sig(env.dates_size() * env.univ_size());
+  for (int di = 0; di < env.dates_size(); ++di) {
+    for (int ii = 0; ii < env.univ_size(); ++ii) {
+      float value = GetValue(di, ii, 5) + 0.3f;
+      sig[di * env.univ_size() + ii] = (di + ii) % 17 == 0 ? NAN : value;
+    }
+  }
+  return sig;
+}
+
+bool IsEqual(const std::vector<float> &a, const std::vector<float> &b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i] && !(std::isnan(a[i]) && std::isnan(b[i]))) return false;
+  }
+  return true;
+}
+
+// Row independent operations give the same rows when applied to the whole range at once, to
+// chunks of it, or by an OperationManager splitting the rows over a TaskPool
+void TestRowIndependent(Env &env, const OperationDesc &desc) {
+  auto &[name, args, kwargs] = desc;
+  int rows = env.dates_size();
+  int cols = env.univ_size();
+  std::unique_ptr<Operation> op(FactoryRegistry::Make<Operation>("operation", name));
+  ENSURE2(op->row_independent());
+
+  auto expected = MakeSignal(env);
+  op->Apply(math::MatView<float>(expected.data(), rows, cols), env, 0, rows, args, kwargs);
+  ENSURE2(!IsEqual(expected, MakeSignal(env)));
+
+  auto chunked = MakeSignal(env);
+  for (int begin = 0; begin < rows; begin += CHUNK_ROWS) {
+    std::unique_ptr<Operation> chunk_op(FactoryRegistry::Make<Operation>("operation", name));
+    chunk_op->Apply(math::MatView<float>(chunked.data(), rows, cols), env, begin,
+                    std::min(begin + CHUNK_ROWS, rows), args, kwargs);
+  }
+  ENSURE2(IsEqual(chunked, expected));
+
+  TaskPool pool(4);
+  env.set_task_pool(&pool);
+  OperationManager manager;
+  manager.Initialize(&env);
+  auto sig = MakeSignal(env);
+  std::vector<float> output(sig.size());
+  manager.Apply(math::MatView<const float>(sig.data(), rows, cols),
+                math::MatView<float>(output.data(), rows, cols), 0, rows, {desc});
+  env.set_task_pool(nullptr);
+  ENSURE2(IsEqual(output, expected));
+}
+
+// The exposures of the long stocks to the factor, normalized as in OpRisk, and the index target
+std::pair<std::vector<double>, double> GetExposures(const Env &env, std::string_view factor,
+                                                    int di) {
+  auto rdata = env.ReadData<Array<float>>(factor)->mat_view();
+  auto member = env.ReadData<Array<float>>("sup_univ/csi500_member")->mat_view();
+  int cnt = 0;
+  double mean = 0;
+  double sq = 0;
+  for (int ii = 0; ii < env.univ_size(); ++ii) {
+    if (std::isfinite(rdata(di, ii))) {
+      cnt++;
+      mean += rdata(di, ii);
+      sq += rdata(di, ii) * rdata(di, ii);
+    }
+  }
+  mean /= cnt;
+  double stdev = std::sqrt(sq / cnt);
+  std::vector<double> expo(env.univ_size());
+  double idx_expo = 0;
+  double idx_wt = 0;
+  for (int ii = 0; ii < env.univ_size(); ++ii) {
+    auto val = rdata(di, ii);
+    expo[ii] = std::isfinite(val) ? (val - mean) / stdev : 0;
+    if (std::isfinite(member(di, ii)) && std::isfinite(val)) {
+      idx_wt += member(di, ii);
+      idx_expo += member(di, ii) * expo[ii];
+    }
+  }
+  return {expo, idx_expo / idx_wt};
+}
+
+void TestRiskExposures(const Env &env) {
+  // the weights of each day are long only, sum to 1 and have the index exposures
+  int rows = env.dates_size();
+  int cols = env.univ_size();
+  auto sig = MakeSignal(env);
+  // one long stock can not match two factors
+  constexpr int INFEASIBLE_DI = 10;
+  for (int ii = 1; ii < cols; ++ii) sig[INFEASIBLE_DI * cols + ii] = -1;
+  sig[INFEASIBLE_DI * cols] = 0.5;
+  std::unique_ptr<Operation> op(FactoryRegistry::Make<Operation>("operation", "risk"));
+  op->Apply(math::MatView<float>(sig.data(), rows, cols), env, 0, rows,
+            {"barra", "size", "beta"}, {});
+
+  for (int di = 0; di < rows; ++di) {
+    auto weights = &sig[di * cols];
+    if (di == INFEASIBLE_DI) {
+      // the normalized signal is kept
+      ENSURE2(weights[0] == 1);
+      for (int ii = 1; ii < cols; ++ii) ENSURE2(std::isnan(weights[ii]));
+      continue;
+    }
+    double sum = 0;
+    for (int ii = 0; ii < cols; ++ii) {
+      ENSURE2(std::isnan(weights[ii]) || weights[ii] > 0);
+      if (weights[ii] > 0) sum += weights[ii];
+    }
+    ENSURE2(std::abs(sum - 1) <= RISK_TOLERANCE);
+    for (auto factor : {"R_barra_cne5/size", "R_barra_cne5/beta"}) {
+      auto [expo, target] = GetExposures(env, factor, di);
+      double value = 0;
+      for (int ii = 0; ii < cols; ++ii) {
+        if (weights[ii] > 0) value += weights[ii] * expo[ii];
+      }
+      ENSURE(std::abs(value - target) <= RISK_TOLERANCE, "{} exposure {} of {} on {}", factor,
+             value, target, di);
+    }
+  }
+}
+
+void TestOperations() {
+  Env env;
+  env.Initialize(MakeConfig());
+  env.Load();
+  ENSURE2(env.dates_size() == 60 && env.univ_size() == NUM_STOCKS);
+  using Args = std::vector<std::string>;
+  TestRowIndependent(env, {"boundsize", Args{"0.05"}, {}});
+  TestRowIndependent(env, {"neutidx", Args{"csi500", "industry"}, {}});
+  TestRowIndependent(env, {"rank", Args{}, {}});
+  TestRowIndependent(env, {"risk", Args{"barra", "size", "beta"}, {}});
+  TestRowIndependent(env, {"upbound", Args{"3"}, {}});
+  TestRiskExposures(env);
+}
+
+}  // namespace
+}  // namespace yang
+
+int main() {
+  yang::fs::remove_all(yang::GetTestDir());
+  yang::BuildEnv();
+  yang::TestOperations();
+  yang::fs::remove_all(yang::GetTestDir());
+  return 0;
+}
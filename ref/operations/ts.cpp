@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "yang/data/array.h"
@@ -15,39 +17,200 @@ static void FillInvalid(yang::math::VecView<float> range, int ts_len) {
   ops::linear_fill(range.begin(), range.end(), TS_FILL_LEN);
 }
 
+// Fills col with column ii of sig and next_valid with the first valid day at or after each day
+static void LoadColumn(yang::math::MatView<float> sig, int ii, int ts_len, std::vector<float> &col,
+                       std::vector<int> &next_valid) {
+  col.resize(sig.rows());
+  for (int di = 0; di < sig.rows(); ++di) col[di] = sig(di, ii);
+  FillInvalid(col, ts_len);
+
+  next_valid.resize(col.size());
+  for (int di = col.size() - 1; di >= 0; --di) {
+    if (std::isfinite(col[di])) {
+      next_valid[di] = di;
+    } else if (di < static_cast<int>(col.size()) - 1) {
+      next_valid[di] = next_valid[di + 1];
+    } else {
+      next_valid[di] = di + 1;
+    }
+  }
+}
+
+// Calls func(range) for each valid value, where range holds the filled column from the first
+// valid value of the ts_len window to the day. The columns are split over the runner's workers.
 template <bool COPY_RANGE = false>
-void ApplyTsRange(yang::math::MatView<float> sig, int ts_len, auto &&func) {
-  std::vector<float> col;
-  std::vector<int> next_valid;
-  std::vector<float> range_copy;
-  for (int ii = 0; ii < sig.cols(); ++ii) {
-    col.resize(sig.rows());
-    for (int di = 0; di < sig.rows(); ++di) col[di] = sig(di, ii);
-    FillInvalid(col, ts_len);
-
-    next_valid.resize(col.size());
-    for (int di = col.size() - 1; di >= 0; --di) {
-      if (std::isfinite(col[di])) {
-        next_valid[di] = di;
-      } else if (di < static_cast<int>(col.size()) - 1) {
-        next_valid[di] = next_valid[di + 1];
-      } else {
-        next_valid[di] = di + 1;
+void ApplyTsRange(yang::math::MatView<float> sig, const yang::Env &env, int ts_len, auto &&func) {
+  yang::Operation::parallel_for(env, 0, sig.cols(), 0, [&](int64_t begin, int64_t end) {
+    std::vector<float> col;
+    std::vector<int> next_valid;
+    std::vector<float> range_copy;
+    for (int ii = begin; ii < end; ++ii) {
+      LoadColumn(sig, ii, ts_len, col, next_valid);
+      for (int di = 0; di < sig.rows(); ++di) {
+        if (!std::isfinite(sig(di, ii))) continue;
+        int range_di_start = next_valid[std::max(0, di - ts_len + 1)];
+        yang::math::VecView<float> range(col.data() + range_di_start, di - range_di_start + 1);
+        if constexpr (COPY_RANGE) {
+          range_copy.assign(range.begin(), range.end());
+          sig(di, ii) = func(range_copy);
+        } else {
+          sig(di, ii) = func(range);
+        }
       }
     }
+  });
+}
+
+// Sums of the valid values in the window, relative to a value of the column so that the squares
+// stay small
+struct TsMoments {
+  double shift = 0;
+  int n = 0;
+  double sum = 0;
+  double sum_sq = 0;
+
+  void Reset(const std::vector<float> &col) {
+    auto it = std::find_if(col.begin(), col.end(), [](float v) { return std::isfinite(v); });
+    shift = it == col.end() ? 0 : *it;
+    n = 0;
+    sum = 0;
+    sum_sq = 0;
+  }
+
+  void Push(float v) {
+    if (!std::isfinite(v)) return;
+    double x = v - shift;
+    ++n;
+    sum += x;
+    sum_sq += x * x;
+  }
+
+  void Pop(float v) {
+    if (!std::isfinite(v)) return;
+    double x = v - shift;
+    --n;
+    sum -= x;
+    sum_sq -= x * x;
+  }
+
+  double Sum() const {
+    return sum + n * shift;
+  }
+
+  double Mean() const {
+    return n > 0 ? shift + sum / n : NAN;
+  }
+
+  double Variance() const {
+    if (n == 0) return NAN;
+    double mean = sum / n;
+    return std::max(0., sum_sq / n - mean * mean);
+  }
+};
+
+// Non-zero values in the window, invalid ones included as in ops::count<ops::CheckBool>
+struct TsNonZeroCount {
+  int n = 0;
+
+  void Reset(const std::vector<float> &) {
+    n = 0;
+  }
+
+  void Push(float v) {
+    n += v != 0;
+  }
+
+  void Pop(float v) {
+    n -= v != 0;
+  }
+};
+
+// Reduces the valid values in the window with an associative Combine, e.g. min, with two stacks:
+// the values pushed since the last flip with their running reduction, and the older values with
+// the reductions of their suffixes, so that each value is combined a constant number of times.
+template <class Combine>
+struct TsWindowReduce {
+  std::vector<double> front;  // reductions from each older value to the newest older value
+  std::vector<double> back;
+  double back_value = Combine::IDENTITY;
+
+  void Reset(const std::vector<float> &) {
+    front.clear();
+    back.clear();
+    back_value = Combine::IDENTITY;
+  }
 
-    for (int di = 0; di < sig.rows(); ++di) {
-      if (!std::isfinite(sig(di, ii))) continue;
-      int range_di_start = next_valid[std::max(0, di - ts_len + 1)];
-      yang::math::VecView<float> range(col.data() + range_di_start, di - range_di_start + 1);
-      if constexpr (COPY_RANGE) {
-        range_copy.assign(range.begin(), range.end());
-        sig(di, ii) = func(range_copy);
-      } else {
-        sig(di, ii) = func(range);
+  void Push(float v) {
+    double x = std::isfinite(v) ? v : Combine::IDENTITY;
+    back.push_back(x);
+    back_value = Combine()(back_value, x);
+  }
+
+  void Pop(float) {
+    if (front.empty()) {
+      double value = Combine::IDENTITY;
+      for (auto it = back.rbegin(); it != back.rend(); ++it) {
+        value = Combine()(*it, value);
+        front.push_back(value);
       }
+      back.clear();
+      back_value = Combine::IDENTITY;
     }
+    front.pop_back();
+  }
+
+  double Value() const {
+    return front.empty() ? back_value : Combine()(front.back(), back_value);
   }
+};
+
+struct MinCombine {
+  static constexpr double IDENTITY = INFINITY;
+
+  double operator()(double a, double b) const {
+    return std::min(a, b);
+  }
+};
+
+struct MaxCombine {
+  static constexpr double IDENTITY = -INFINITY;
+
+  double operator()(double a, double b) const {
+    return std::max(a, b);
+  }
+};
+
+struct ProdCombine {
+  static constexpr double IDENTITY = 1;
+
+  double operator()(double a, double b) const {
+    return a * b;
+  }
+};
+
+// ApplyTsRange for reductions which can be updated as the window moves. Calls
+// func(acc, value, skipped) for each valid value, where acc holds the filled column over the
+// ts_len window and skipped is the number of invalid values at the start of the window, which
+// ApplyTsRange leaves out of the range. O(1) per value instead of O(ts_len).
+template <class Acc>
+void ApplyTsRolling(yang::math::MatView<float> sig, const yang::Env &env, int ts_len,
+                    auto &&func) {
+  yang::Operation::parallel_for(env, 0, sig.cols(), 0, [&](int64_t begin, int64_t end) {
+    std::vector<float> col;
+    std::vector<int> next_valid;
+    Acc acc;
+    for (int ii = begin; ii < end; ++ii) {
+      LoadColumn(sig, ii, ts_len, col, next_valid);
+      acc.Reset(col);
+      for (int di = 0; di < sig.rows(); ++di) {
+        if (di >= ts_len) acc.Pop(col[di - ts_len]);
+        acc.Push(col[di]);
+        if (!std::isfinite(sig(di, ii))) continue;
+        int window_start = std::max(0, di - ts_len + 1);
+        sig(di, ii) = func(acc, col[di], next_valid[window_start] - window_start);
+      }
+    }
+  });
 }
 
 struct OpTs : yang::Operation {
@@ -59,99 +222,104 @@ struct OpTs : yang::Operation {
 
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
-    Apply(sig.block(0, 0, end_di, env.univ_size()), yang::CheckAtoi(args.at(0)));
+    Apply(sig.block(0, 0, end_di, env.univ_size()), env, yang::CheckAtoi(args.at(0)));
   }
 
-  virtual void Apply(MatView<float> sig, int ts_len) = 0;
+  virtual void Apply(MatView<float> sig, const yang::Env &env, int ts_len) = 0;
 };
 
 struct OpTsMin : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::min(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsWindowReduce<MinCombine>>(
+        sig, env, ts_len, [](auto &acc, float, int) { return acc.Value(); });
   }
 };
 REGISTER_OPERATION("tsmin", OpTsMin);
 
 struct OpTsMax : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::max(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsWindowReduce<MaxCombine>>(
+        sig, env, ts_len, [](auto &acc, float, int) { return acc.Value(); });
   }
 };
 REGISTER_OPERATION("tsmax", OpTsMax);
 
 struct OpTsSum : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::sum(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsMoments>(sig, env, ts_len, [](auto &acc, float, int) { return acc.Sum(); });
   }
 };
 REGISTER_OPERATION("tssum", OpTsSum);
 
 struct OpTsCount : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) {
-      return ops::count<ops::CheckBool>(range.begin(), range.end());
-    });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsNonZeroCount>(sig, env, ts_len,
+                                   [](auto &acc, float, int skipped) { return acc.n - skipped; });
   }
 };
 REGISTER_OPERATION("tscount", OpTsCount);
 
 struct OpTsProd : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::prod(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsWindowReduce<ProdCombine>>(
+        sig, env, ts_len, [](auto &acc, float, int) { return acc.Value(); });
   }
 };
 REGISTER_OPERATION("tsprod", OpTsProd);
 
 struct OpTsMean : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::mean(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsMoments>(sig, env, ts_len, [](auto &acc, float, int) { return acc.Mean(); });
   }
 };
 REGISTER_OPERATION("tsmean", OpTsMean);
 
 struct OpTsDemean : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) {
-      return range[range.size() - 1] - ops::mean(range.begin(), range.end());
-    });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsMoments>(sig, env, ts_len,
+                              [](auto &acc, float value, int) { return value - acc.Mean(); });
   }
 };
 REGISTER_OPERATION("tsdemean", OpTsDemean);
 
 struct OpTsDemean2 : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) {
-      return range[range.size() - 1] - ops::mean(range.begin(), range.end() - 1);
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsMoments>(sig, env, ts_len, [](auto &acc, float value, int) {
+      // mean of the window before the day
+      if (acc.n < 2) return NAN;
+      return static_cast<float>(value - (acc.Sum() - value) / (acc.n - 1));
     });
   }
 };
 REGISTER_OPERATION("tsdemean2", OpTsDemean2);
 
 struct OpTsRMean : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::rmean(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
+                 [](auto &range) { return ops::rmean(range.begin(), range.end()); });
   }
 };
 REGISTER_OPERATION("tsrmean", OpTsRMean);
 
 struct OpTsStd : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::stdev(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRolling<TsMoments>(sig, env, ts_len,
+                              [](auto &acc, float, int) { return std::sqrt(acc.Variance()); });
   }
 };
 REGISTER_OPERATION("tsstd", OpTsStd);
 
 struct OpTsMeanDev : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len,
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
                  [](auto &range) { return ops::mean_dev(range.begin(), range.end()); });
   }
 };
 REGISTER_OPERATION("tsmeandev", OpTsMeanDev);
 
 struct OpTsZScore : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange<true>(sig, ts_len, [](auto &range) {
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange<true>(sig, env, ts_len, [](auto &range) {
       ops::zscore(range.begin(), range.end());
       return range[range.size() - 1];
     });
@@ -160,30 +328,32 @@ struct OpTsZScore : OpTs {
 REGISTER_OPERATION("tszscore", OpTsZScore);
 
 struct OpTsCorrStep : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len,
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
                  [](auto &range) { return ops::corr_step(range.begin(), range.end()); });
   }
 };
 REGISTER_OPERATION("tscorrstep", OpTsCorrStep);
 
 struct OpTsArgmin : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::argmin(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
+                 [](auto &range) { return ops::argmin(range.begin(), range.end()); });
   }
 };
 REGISTER_OPERATION("tsargmin", OpTsArgmin);
 
 struct OpTsArgmax : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len, [](auto &range) { return ops::argmax(range.begin(), range.end()); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
+                 [](auto &range) { return ops::argmax(range.begin(), range.end()); });
   }
 };
 REGISTER_OPERATION("tsargmax", OpTsArgmax);
 
 struct OpTsRank : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange<true>(sig, ts_len, [](auto &range) {
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange<true>(sig, env, ts_len, [](auto &range) {
       ops::rank(range.begin(), range.end());
       return range.back();
     });
@@ -192,15 +362,15 @@ struct OpTsRank : OpTs {
 REGISTER_OPERATION("tsrank", OpTsRank);
 
 struct OpTsDelta : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len + 1, [](auto &range) { return range.back() - range.front(); });
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len + 1, [](auto &range) { return range.back() - range.front(); });
   }
 };
 REGISTER_OPERATION("tsdelta", OpTsDelta);
 
 struct OpTsDecayLinear : OpTs {
-  void Apply(MatView<float> sig, int ts_len) final {
-    ApplyTsRange(sig, ts_len,
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len) final {
+    ApplyTsRange(sig, env, ts_len,
                  [](auto &range) { return ops::decay_linear(range.begin(), range.end()); });
   }
 };
@@ -215,12 +385,12 @@ struct OpTsEma : yang::Operation {
 
   void Apply(MatView<float> sig, const yang::Env &env, int start_di, int end_di,
              const std::vector<std::string> &args) final {
-    Apply(sig.block(0, 0, end_di, env.univ_size()), yang::CheckAtoi(args.at(0)),
+    Apply(sig.block(0, 0, end_di, env.univ_size()), env, yang::CheckAtoi(args.at(0)),
           yang::CheckAtof(args.at(1)));
   }
 
-  void Apply(MatView<float> sig, int ts_len, float ratio) {
-    ApplyTsRange(sig, ts_len, [ratio](auto &range) {
+  void Apply(MatView<float> sig, const yang::Env &env, int ts_len, float ratio) {
+    ApplyTsRange(sig, env, ts_len, [ratio](auto &range) {
       return ops::ema<float>(range.begin(), range.end(), ratio);
     });
   }
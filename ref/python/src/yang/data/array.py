@@ -1,16 +1,31 @@
 from __future__ import annotations
 
+import fcntl
 import logging
 import os
-from typing import Any, Optional
+from contextlib import contextmanager
+from typing import Any, Iterator, Optional
 
 import numpy as np
 import yaml
 
 from yang.data.null import get_null_value
 
+
+@contextmanager
+def _dir_lock(dir_path: str) -> Iterator[None]:
+    """Exclusive lock on a directory across processes"""
+    fd = os.open(dir_path, os.O_RDONLY)
+    try:
+        fcntl.flock(fd, fcntl.LOCK_EX)
+        yield
+    finally:
+        os.close(fd)
+
+
 dtype_map = {
     "float": np.dtype(np.float32),
+    "float16": np.dtype(np.float16),
     "double": np.dtype(np.float64),
     "bool": np.dtype(np.bool8),
     "int16": np.dtype(np.int16),
@@ -22,13 +37,34 @@ dtype_map = {
     "int": np.dtype(np.int32),
 }
 meta_type_map = {np.dtype(v).name: k for k, v in dtype_map.items()}
+# numpy has no bfloat16, its items are read as the upper halves of float32
+BFLOAT16 = "bfloat16"
 
 
 class ArrayMeta(object):
-    def __init__(self, item_type: np.dtype, item_size: int, shape: tuple):
+    def __init__(
+        self,
+        item_type: np.dtype,
+        item_size: int,
+        shape: tuple,
+        scale: float = 0,
+        bfloat16: bool = False,
+        compression: str = "",
+    ):
         self.item_type = item_type
         self.item_size = item_size
         self.shape = shape
+        # fixed point scale of integer items, 0 means unscaled
+        self.scale = scale
+        # item_type is uint16 for the bits of bfloat16 items
+        self.bfloat16 = bfloat16
+        # zstd row blocks written by the C++ ArrayBase::Compress, empty means uncompressed
+        self.compression = compression
+
+    @property
+    def widened(self) -> bool:
+        """Whether items are stored narrow and read widened to float32"""
+        return self.bfloat16 or self.scale != 0
 
     def save(self, path: str) -> None:
         data = {
@@ -36,6 +72,8 @@ class ArrayMeta(object):
             "item_size": self.item_size,
             "shape": list(self.shape),
         }
+        if self.scale:
+            data["scale"] = self.scale
         with open(path, "w") as f:
             yaml.safe_dump(data, f)
 
@@ -44,13 +82,41 @@ class ArrayMeta(object):
         with open(path) as f:
             raw_meta = yaml.safe_load(f)
         cpp_type = raw_meta["item_type"]
-        if cpp_type.startswith("std::array"):
+        if cpp_type == BFLOAT16:
+            dtype = np.dtype(np.uint16)
+        elif cpp_type.startswith("std::array"):
             # std::array<T, N>
             etype, n = cpp_type[11:-1].split(", ")
             dtype = np.dtype(f"{n}{dtype_map[etype]}")
         else:
             dtype = dtype_map[cpp_type]
-        return ArrayMeta(dtype, raw_meta["item_size"], tuple(raw_meta["shape"]))
+        return ArrayMeta(
+            dtype,
+            raw_meta["item_size"],
+            tuple(raw_meta["shape"]),
+            scale=raw_meta.get("scale", 0),
+            bfloat16=cpp_type == BFLOAT16,
+            compression=raw_meta.get("compression", ""),
+        )
+
+
+def _widen(data: np.ndarray, meta: ArrayMeta) -> np.ndarray:
+    """Widens bfloat16 or scaled int16 items to float32 like the C++ FloatMat"""
+    if meta.bfloat16:
+        return (data.astype(np.uint32) << 16).view(np.float32)
+    if meta.scale:
+        null = data == np.iinfo(np.int16).min
+        return np.where(null, np.float32(np.nan), data * np.float32(meta.scale))
+    return data
+
+
+def _read_compressed(path: str, meta: ArrayMeta) -> np.ndarray:
+    from yang.util.ext import read_compressed_array
+
+    data = np.empty(meta.shape, dtype=meta.item_type)
+    read_compressed_array(path, data)
+    logging.debug(f"Loaded {path} {data.shape} (compressed)")
+    return data
 
 
 # TODO: resize, clone
@@ -100,64 +166,86 @@ class Array(object):
         dtype: Optional[np.dtype] = None,
         null_value: Any = None,
     ) -> Array:
-        meta_path = path + ".meta"
         if writable:
-            if dtype is not None:
-                dtype = np.dtype(dtype)
-            if os.path.exists(meta_path):
-                # update existing
-                old_meta = ArrayMeta.load(meta_path)
-                if dtype is None:
-                    dtype = old_meta.item_type
-                else:
-                    assert (
-                        dtype == old_meta.item_type
-                    ), f"array dtype mismatch, new:{dtype} old:{old_meta.item_type}"
-                if shape is None:
-                    shape = old_meta.shape
-                else:
-                    assert len(shape) == len(old_meta.shape)
+            # shards of a module in other processes may create or resize the same array
+            dir_path = os.path.dirname(path)
+            if dir_path != "":
+                os.makedirs(dir_path, exist_ok=True)
+            with _dir_lock(dir_path or "."):
+                return Array._mmap_writable(path, shape, dtype, null_value)
+
+        meta_path = path + ".meta"
+        meta = ArrayMeta.load(meta_path)
+        if meta.compression:
+            # compressed blocks cannot be mapped, the array is decompressed into memory
+            return Array(_widen(_read_compressed(path, meta), meta), path, null_value)
+        data = np.memmap(path, dtype=meta.item_type, mode="r", shape=meta.shape)
+        logging.debug(f"Loaded {path} {data.shape}")
+        if meta.widened:
+            # numpy cannot view these items as floats, so they are widened into memory
+            return Array(_widen(data, meta), path, null_value)
+        return Array(data, path, null_value)
+
+    @staticmethod
+    def _mmap_writable(
+        path: str,
+        shape: Optional[list[int]],
+        dtype: Optional[np.dtype],
+        null_value: Any,
+    ) -> Array:
+        meta_path = path + ".meta"
+        if dtype is not None:
+            dtype = np.dtype(dtype)
+        if os.path.exists(meta_path):
+            # update existing
+            old_meta = ArrayMeta.load(meta_path)
+            if old_meta.widened or old_meta.compression:
+                raise ValueError(f"Reduced precision or compressed array is read-only: {path}")
+            if dtype is None:
+                dtype = old_meta.item_type
             else:
-                dir_path = os.path.dirname(path)
-                if dir_path != "":
-                    os.makedirs(dir_path, exist_ok=True)
-                old_meta = None
-            if null_value is None:
-                null_value = get_null_value(dtype)
-            if old_meta is None:
-                data = np.memmap(path, dtype=dtype, mode="w+", shape=shape)
-                data.fill(null_value)
-                logging.debug(f"Created {path} {data.shape}")
-            elif shape is None or old_meta.shape == shape:
-                data = np.memmap(path, dtype=dtype, mode="r+", shape=shape)
-                logging.debug(f"Loaded {path} {data.shape}")
-            elif old_meta.shape[1:] == shape[1:]:
-                if old_meta.shape[0] > shape[0]:
-                    os.truncate(path, dtype.itemsize * np.product(shape))
-                data = np.memmap(path, dtype=dtype, mode="r+", shape=shape)
-                data[old_meta.shape[0] :, ...].fill(null_value)
-                logging.debug(f"Resized {path} {old_meta.shape} -> {data.shape}")
+                assert (
+                    dtype == old_meta.item_type
+                ), f"array dtype mismatch, new:{dtype} old:{old_meta.item_type}"
+            if shape is None:
+                shape = old_meta.shape
             else:
-                old_data = np.fromfile(path, dtype=dtype).reshape(old_meta.shape)
-                data = np.memmap(path, dtype=dtype, mode="w+", shape=shape)
-                data.fill(null_value)
-                slices = tuple(slice(0, min(n1, n2)) for n1, n2 in zip(old_data.shape, shape))
-                data[slices] = old_data[slices]
-                logging.debug(f"Resized {path} {old_data.shape} -> {data.shape}")
-            if not old_meta or old_meta.shape != shape:
-                meta = ArrayMeta(dtype, dtype.itemsize, shape)
-                meta.save(meta_path)
+                assert len(shape) == len(old_meta.shape)
         else:
-            # read
-            mode = "r"
-            meta = ArrayMeta.load(meta_path)
-            data = np.memmap(path, dtype=meta.item_type, mode=mode, shape=meta.shape)
+            old_meta = None
+        if null_value is None:
+            null_value = get_null_value(dtype)
+        if old_meta is None:
+            data = np.memmap(path, dtype=dtype, mode="w+", shape=shape)
+            data.fill(null_value)
+            logging.debug(f"Created {path} {data.shape}")
+        elif shape is None or old_meta.shape == shape:
+            data = np.memmap(path, dtype=dtype, mode="r+", shape=shape)
             logging.debug(f"Loaded {path} {data.shape}")
+        elif old_meta.shape[1:] == shape[1:]:
+            if old_meta.shape[0] > shape[0]:
+                os.truncate(path, dtype.itemsize * np.product(shape))
+            data = np.memmap(path, dtype=dtype, mode="r+", shape=shape)
+            data[old_meta.shape[0] :, ...].fill(null_value)
+            logging.debug(f"Resized {path} {old_meta.shape} -> {data.shape}")
+        else:
+            old_data = np.fromfile(path, dtype=dtype).reshape(old_meta.shape)
+            data = np.memmap(path, dtype=dtype, mode="w+", shape=shape)
+            data.fill(null_value)
+            slices = tuple(slice(0, min(n1, n2)) for n1, n2 in zip(old_data.shape, shape))
+            data[slices] = old_data[slices]
+            logging.debug(f"Resized {path} {old_data.shape} -> {data.shape}")
+        if not old_meta or old_meta.shape != shape:
+            meta = ArrayMeta(dtype, dtype.itemsize, shape)
+            meta.save(meta_path)
         return Array(data, path, null_value)
 
     @staticmethod
     def load(path: str) -> Array:
         meta_path = path + ".meta"
         meta = ArrayMeta.load(meta_path)
-        data = np.fromfile(path, dtype=meta.item_type).reshape(meta.shape)
-        return Array(data, path)
+        if meta.compression:
+            data = _read_compressed(path, meta)
+        else:
+            data = np.fromfile(path, dtype=meta.item_type).reshape(meta.shape)
+        return Array(_widen(data, meta), path)
@@ -59,6 +59,25 @@ class ExprRunner(object):
         self.cpp_runner.run(expr, univ or "", output_mat, mode, dates_size, start_di, end_di)
         return output
 
+    def run_changed(
+        self,
+        expr: str,
+        output: Union[np.array, Array],
+        since_version: int,
+        univ: Optional[str] = None,
+        mode: str = "mixed",
+        dates_size: int = -1,
+        start_di: int = -1,
+        end_di: int = -1,
+    ) -> tuple[int, int]:
+        """Recomputes only the dates of output whose inputs changed after since_version, e.g. the
+        timestamp of the run that computed output, according to their row versions. Returns the
+        recomputed date range, (0, 0) if nothing changed."""
+        output_mat = output.data if isinstance(output, Array) else output
+        return self.cpp_runner.run_changed(
+            expr, univ or "", output_mat, mode, dates_size, start_di, end_di, since_version
+        )
+
     @staticmethod
     def default_groups():
         return CppExprRunner.default_groups()
@@ -1,13 +1,17 @@
+#include <pybind11/eigen.h>
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include <optional>
 
 #include "python/src/yang/math/convert.h"
+#include "yang/sim/corr_pool.h"
 #include "yang/sim/env.h"
 #include "yang/sim/expr_runner.h"
 #include "yang/sim/operation_manager.h"
+#include "yang/sim/pnl_engine.h"
 #include "yang/util/logging.h"
 #include "yang/util/module_loader.h"
 
@@ -56,6 +60,18 @@ class PyOperationManager {
     underlying_.Apply(mat_in, mat_out, start_di, end_di, ops);
   }
 
+  void ApplyBatch(const std::vector<py::buffer> &sigs_in, const std::vector<py::buffer> &sigs_out,
+                  int start_di, int end_di, const std::vector<OperationDesc> &ops,
+                  int num_threads) {
+    std::vector<math::MatView<const float>> mats_in;
+    std::vector<math::MatView<float>> mats_out;
+    for (auto &sig : sigs_in) mats_in.push_back(math::py_buffer_to_mat<const float>(sig, "f"));
+    for (auto &sig : sigs_out) mats_out.push_back(math::py_buffer_to_mat<float>(sig, "f"));
+    py::gil_scoped_release release;
+    TaskPool pool(num_threads);
+    underlying_.ApplyBatch(mats_in, mats_out, start_di, end_di, ops, &pool);
+  }
+
  private:
   OperationManager underlying_;
 };
@@ -81,8 +97,40 @@ class PyExprRunner : public ExprRunner {
     return ExprRunner::Run(expr_str, univ, output_mat, ExprRunner::ParseMode(mode), dates_size,
                            start_di, end_di);
   }
+
+  std::pair<int, int> RunChanged(std::string_view expr_str, std::string_view univ,
+                                 py::buffer output, std::string_view mode, int dates_size,
+                                 int start_di, int end_di, uint64_t since_version) {
+    auto info = output.request();
+    auto output_mat = info.format == "f"
+                          ? expr::OutFloatMat(math::py_buffer_to_mat<float>(output, "f"))
+                          : expr::OutFloatMat(math::py_buffer_to_mat<double>(output, "d"));
+    if (dates_size < 0) dates_size = env_->dates_size();
+    if (start_di < 0) start_di = env_->start_di();
+    if (end_di < 0) end_di = env_->end_di();
+    py::gil_scoped_release release;
+    return ExprRunner::RunChanged(expr_str, univ, output_mat, ExprRunner::ParseMode(mode),
+                                  dates_size, start_di, end_di, since_version);
+  }
 };
 
+// A numpy view of a vector of PnlStats, which keeps the stats alive
+template <class T, std::vector<T> PnlStats::*field>
+py::array_t<T> PnlStatsArray(py::object self) {
+  auto &v = self.cast<PnlStats &>().*field;
+  return py::array_t<T>(v.size(), v.data(), self);
+}
+
+PnlStats PyComputePnlStats(py::buffer sig, py::buffer ret, std::optional<py::buffer> prc,
+                           PnlOptions options) {
+  auto sig_mat = math::py_buffer_to_mat<const float>(sig, "f");
+  auto ret_mat = math::py_buffer_to_mat<const float>(ret, "f");
+  math::MatView<const float> prc_mat;
+  if (prc) prc_mat = math::py_buffer_to_mat<const float>(*prc, "f");
+  py::gil_scoped_release release;
+  return PnlEngine(options).Compute(sig_mat, ret_mat, prc_mat);
+}
+
 }  // namespace yang
 
 PYBIND11_MODULE(ext, m) {
@@ -98,11 +146,13 @@ PYBIND11_MODULE(ext, m) {
       .def("can_skip_run", &RerunManager::CanSkipRun, py::call_guard<py::gil_scoped_release>())
       .def("record_before_run", &RerunManager::RecordBeforeRun,
            py::call_guard<py::gil_scoped_release>())
-      .def("record_run", &RerunManager::RecordRun, py::call_guard<py::gil_scoped_release>());
+      .def("record_run", py::overload_cast<std::string_view>(&RerunManager::RecordRun),
+           py::call_guard<py::gil_scoped_release>());
 
   py::class_<Env>(m, "Env")
       .def(py::init())
       .def("initialize", &Env::Initialize)
+      .def("build", &Env::Build)
       .def("load", &Env::Load)
       .def_property_readonly("data_cache", &Env::data_cache)
       .def_property_readonly("rerun_manager", &Env::rerun_manager)
@@ -130,7 +180,136 @@ PYBIND11_MODULE(ext, m) {
   py::class_<PyOperationManager>(m, "OperationManager")
       .def(py::init())
       .def("initialize", &PyOperationManager::Initialize, "env"_a)
-      .def("apply", &PyOperationManager::Apply);
+      .def("apply", &PyOperationManager::Apply)
+      .def("apply_batch", &PyOperationManager::ApplyBatch, "sigs_in"_a, "sigs_out"_a, "start_di"_a,
+           "end_di"_a, "ops"_a, "num_threads"_a = 8);
+
+  py::class_<PnlStats>(m, "PnlStats")
+      .def_property_readonly("long_count", &PnlStatsArray<int, &PnlStats::long_count>)
+      .def_property_readonly("short_count", &PnlStatsArray<int, &PnlStats::short_count>)
+      .def_property_readonly("long_pnl", &PnlStatsArray<double, &PnlStats::long_pnl>)
+      .def_property_readonly("short_pnl", &PnlStatsArray<double, &PnlStats::short_pnl>)
+      .def_property_readonly("long_val", &PnlStatsArray<double, &PnlStats::long_val>)
+      .def_property_readonly("short_val", &PnlStatsArray<double, &PnlStats::short_val>)
+      .def_property_readonly("trade_val", &PnlStatsArray<double, &PnlStats::trade_val>)
+      .def_property_readonly("trade_cost", &PnlStatsArray<double, &PnlStats::trade_cost>)
+      .def_property_readonly("pnl", &PnlStatsArray<double, &PnlStats::pnl>)
+      .def_property_readonly("ret", &PnlStatsArray<double, &PnlStats::ret>)
+      .def_property_readonly("long_ret", &PnlStatsArray<double, &PnlStats::long_ret>)
+      .def_property_readonly("short_ret", &PnlStatsArray<double, &PnlStats::short_ret>)
+      .def_property_readonly("hedge_ret", &PnlStatsArray<double, &PnlStats::hedge_ret>)
+      .def_property_readonly("ic", &PnlStatsArray<double, &PnlStats::ic>)
+      .def("__len__", &PnlStats::size);
+
+  py::class_<PnlSummary>(m, "PnlSummary")
+      .def_readonly("start", &PnlSummary::start)
+      .def_readonly("end", &PnlSummary::end)
+      .def_readonly("count", &PnlSummary::count)
+      .def_readonly("long_count", &PnlSummary::long_count)
+      .def_readonly("short_count", &PnlSummary::short_count)
+      .def_readonly("long_pnl", &PnlSummary::long_pnl)
+      .def_readonly("short_pnl", &PnlSummary::short_pnl)
+      .def_readonly("long_val", &PnlSummary::long_val)
+      .def_readonly("short_val", &PnlSummary::short_val)
+      .def_readonly("trade_val", &PnlSummary::trade_val)
+      .def_readonly("trade_cost", &PnlSummary::trade_cost)
+      .def_readonly("pnl", &PnlSummary::pnl)
+      .def_readonly("ret", &PnlSummary::ret)
+      .def_readonly("long_ret", &PnlSummary::long_ret)
+      .def_readonly("short_ret", &PnlSummary::short_ret)
+      .def_readonly("hedge_ret", &PnlSummary::hedge_ret)
+      .def_readonly("tvr", &PnlSummary::tvr)
+      .def_readonly("std", &PnlSummary::std)
+      .def_readonly("ir", &PnlSummary::ir)
+      .def_readonly("ic", &PnlSummary::ic)
+      .def_readonly("up_days", &PnlSummary::up_days)
+      .def_readonly("down_days", &PnlSummary::down_days)
+      .def_readonly("max_dd", &PnlSummary::max_dd)
+      .def_readonly("max_dd_start", &PnlSummary::max_dd_start)
+      .def_readonly("max_dd_end", &PnlSummary::max_dd_end);
+
+  m.def(
+      "compute_pnl_stats",
+      [](py::buffer sig, py::buffer ret, int univ_size, double book_size, int hedge_ii) {
+        return PyComputePnlStats(sig, ret, std::nullopt,
+                                 {.univ_size = univ_size, .book_size = book_size,
+                                  .hedge_ii = hedge_ii});
+      },
+      "sig"_a, "ret"_a, "univ_size"_a, "book_size"_a, "hedge_ii"_a = -1);
+  m.def(
+      "compute_tpnl_stats",
+      [](py::buffer sig, py::buffer ret, py::buffer prc, int univ_size, double book_size,
+         double buy_fee, double sell_fee, int hedge_ii) {
+        return PyComputePnlStats(sig, ret, prc,
+                                 {.univ_size = univ_size, .book_size = book_size,
+                                  .hedge_ii = hedge_ii, .buy_fee = buy_fee,
+                                  .sell_fee = sell_fee});
+      },
+      "sig"_a, "ret"_a, "prc"_a, "univ_size"_a, "book_size"_a, "buy_fee"_a, "sell_fee"_a,
+      "hedge_ii"_a = -1);
+  m.def(
+      "compute_pnl_stats_batch",
+      [](const std::vector<py::buffer> &sigs, py::buffer ret, int univ_size, double book_size,
+         int hedge_ii, int num_threads) {
+        std::vector<math::MatView<const float>> sig_mats;
+        for (auto &sig : sigs) sig_mats.push_back(math::py_buffer_to_mat<const float>(sig, "f"));
+        auto ret_mat = math::py_buffer_to_mat<const float>(ret, "f");
+        py::gil_scoped_release release;
+        TaskPool pool(num_threads);
+        PnlEngine engine({.univ_size = univ_size, .book_size = book_size, .hedge_ii = hedge_ii});
+        return engine.Compute(sig_mats, ret_mat, {}, &pool);
+      },
+      "sigs"_a, "ret"_a, "univ_size"_a, "book_size"_a, "hedge_ii"_a = -1, "num_threads"_a = 8);
+  m.def(
+      "compute_yearly_pnl_stats",
+      [](const PnlStats &stats, std::vector<int64_t> dates, double book_size, bool include_total,
+         int days_per_year, int intervals_per_day) {
+        PnlEngine engine({.book_size = book_size,
+                          .days_per_year = days_per_year,
+                          .intervals_per_day = intervals_per_day});
+        return engine.SummarizeYearly(stats, dates, include_total);
+      },
+      "stats"_a, "dates"_a, "book_size"_a, "include_total"_a = true, "days_per_year"_a = 250,
+      "intervals_per_day"_a = 1);
+
+  py::class_<CorrPool>(m, "CorrPool")
+      .def(py::init<int, int>(), "size"_a, "min_count"_a = 2)
+      .def_property_readonly("size", &CorrPool::size)
+      .def_property_readonly("count", &CorrPool::count)
+      .def(
+          "corr",
+          [](const CorrPool &self, py::buffer x) {
+            auto x_vec = math::py_buffer_to_vec<const double>(x, "d");
+            py::gil_scoped_release release;
+            return self.Corr(x_vec);
+          },
+          "x"_a)
+      .def(
+          "add",
+          [](CorrPool &self, py::buffer x) {
+            return self.Add(math::py_buffer_to_vec<const double>(x, "d"));
+          },
+          "x"_a)
+      .def(
+          "matrix",
+          [](const CorrPool &self, int num_threads) {
+            py::gil_scoped_release release;
+            if (num_threads <= 1) return self.Matrix();
+            TaskPool pool(num_threads);
+            return self.Matrix(&pool);
+          },
+          "num_threads"_a = 8);
+  m.def(
+      "signal_corr",
+      [](const std::vector<py::buffer> &sigs, int num_threads, int min_count) {
+        std::vector<math::MatView<const float>> sig_mats;
+        for (auto &sig : sigs) sig_mats.push_back(math::py_buffer_to_mat<const float>(sig, "f"));
+        py::gil_scoped_release release;
+        if (num_threads <= 1) return CorrPool::SignalCorr(sig_mats, nullptr, min_count);
+        TaskPool pool(num_threads);
+        return CorrPool::SignalCorr(sig_mats, &pool, min_count);
+      },
+      "sigs"_a, "num_threads"_a = 8, "min_count"_a = 2);
 
   py::class_<PyExprRunner>(m, "ExprRunner")
       .def(py::init<const Env *>())
@@ -141,6 +320,9 @@ PYBIND11_MODULE(ext, m) {
       .def("add_extra_data", &PyExprRunner::AddExtraData)
       .def("run", &PyExprRunner::Run, "expr_str"_a, "univ"_a, "output"_a, "mode"_a = "mixed",
            "dates_size"_a = -1, "start_di"_a = -1, "end_di"_a = -1)
+      .def("run_changed", &PyExprRunner::RunChanged, "expr_str"_a, "univ"_a, "output"_a,
+           "mode"_a = "mixed", "dates_size"_a = -1, "start_di"_a = -1, "end_di"_a = -1,
+           "since_version"_a = 0)
       .def_static("default_base_data", &PyExprRunner::default_base_data)
       .def_static("default_groups", &PyExprRunner::default_groups);
 }
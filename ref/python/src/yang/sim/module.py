@@ -59,6 +59,12 @@ class Module(object):
     def end_di(self) -> int:
         return self.env.end_di
 
+    @property
+    def hist_start_di(self) -> int:
+        """First date index needed to warm up state, the start date minus the configured lookback,
+        so that a date shard of the module computes the same rows as a full run"""
+        return max(0, self.start_di - self.config.get("lookback", 0))
+
     @property
     def univ_size(self) -> int:
         return self.env.univ_size
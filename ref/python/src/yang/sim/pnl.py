@@ -84,6 +84,23 @@ def compute_pnl_stats(
     return pd.DataFrame({f: getattr(stats, f) for f in PNL_STATS_FIELDS})
 
 
+def compute_pnl_stats_batch(
+    sigs: list,
+    ret: Union[np.array, Array],
+    univ_size: int,
+    book_size: int,
+    hedge_ii: int = -1,
+    num_threads: int = 8,
+) -> list:
+    sigs = [sig.data if isinstance(sig, Array) else sig for sig in sigs]
+    if isinstance(ret, Array):
+        ret = ret.data
+    stats = yang.sim.ext.compute_pnl_stats_batch(
+        sigs, ret, univ_size, book_size, hedge_ii, num_threads
+    )
+    return [pd.DataFrame({f: getattr(s, f) for f in PNL_STATS_FIELDS}) for s in stats]
+
+
 def compute_yearly_pnl_stats(
     dates: Union[np.array, DateIndex],
     sig: Union[np.array, Array],
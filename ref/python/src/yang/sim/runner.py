@@ -20,6 +20,7 @@ class Runner(object):
     ) -> None:
         mods = []
         mod_deps = {}
+        mod_shards = {}
         run_set = set(config.get("run_modules", []))
         for mod_config in config["modules"]:
             if mod_config["lang"] != "py":
@@ -30,10 +31,14 @@ class Runner(object):
 
             mods.append(name)
             mod_deps[name] = list(set(mod_config.get("deps", []) + ["base"]))
+            # row independent modules may split their date range across workers
+            num_shards = mod_config.get("shards", 1)
+            if num_shards > 1:
+                mod_shards[name] = num_shards
 
         scheduler = Scheduler(mods, mod_deps)
         loop = asyncio.get_event_loop()
-        num_workers = min(num_workers, len(mods))
+        num_workers = min(num_workers, sum(mod_shards.get(mod, 1) for mod in mods))
         workers = [SubprocessWorker(f"worker_{i}", loop) for i in range(num_workers)]
         for i in range(num_workers):
             workers[i].start(config, run_options, mod_deps, config_path=config_path)
@@ -41,24 +46,59 @@ class Runner(object):
         idle_workers = deque(workers)
         logging.info(f"Running ({num_workers} threads)")
 
-        def on_mod_done(worker, mod_name, fut):
+        # tasks of sharded modules: prepare, run the shards, then commit
+        jobs = deque()
+        pending_shards = {}
+        failed_mods = set()
+
+        def on_task_done(worker, kind, mod_name, fut):
             try:
-                fut.result()
-                scheduler.on_task_finished(mod_name)
+                result = fut.result()
+                if kind == "prepare":
+                    if result:
+                        num_shards = mod_shards[mod_name]
+                        pending_shards[mod_name] = num_shards
+                        jobs.extend(("shard", mod_name, k, num_shards) for k in range(num_shards))
+                    else:
+                        scheduler.on_task_finished(mod_name)
+                elif kind == "shard" and mod_name in failed_mods:
+                    pass
+                elif kind == "shard":
+                    pending_shards[mod_name] -= 1
+                    if pending_shards[mod_name] == 0:
+                        del pending_shards[mod_name]
+                        jobs.append(("commit", mod_name))
+                else:
+                    scheduler.on_task_finished(mod_name)
                 idle_workers.append(worker)
             except Exception as e:
-                logging.exception("Failed to run %s", mod_name)
-                scheduler.on_task_error(mod_name)
+                logging.exception("Failed to %s %s", kind, mod_name)
+                # other shards of the module may fail too, report the module once
+                if mod_name not in failed_mods:
+                    failed_mods.add(mod_name)
+                    scheduler.on_task_error(mod_name)
+                    pending_shards.pop(mod_name, None)
+                    remaining = [job for job in jobs if job[1] != mod_name]
+                    jobs.clear()
+                    jobs.extend(remaining)
                 worker.stop()
 
+        def next_job():
+            if len(jobs) > 0:
+                return jobs.popleft()
+            mod_name = scheduler.next_ready_task()
+            if mod_name in mod_shards and num_workers > 1:
+                return ("prepare", mod_name)
+            return ("run", mod_name)
+
         async def run():
             while True:
                 idle = True
-                if len(idle_workers) > 0 and scheduler.has_ready_tasks:
-                    mod_name = scheduler.next_ready_task()
+                if len(idle_workers) > 0 and (len(jobs) > 0 or scheduler.has_ready_tasks):
+                    job = next_job()
                     worker = idle_workers.popleft()
-                    fut = worker.run_module(mod_name)
-                    fut.add_done_callback(functools.partial(on_mod_done, worker, mod_name))
+                    fut = worker.run_task(*job)
+                    fut.add_done_callback(functools.partial(on_task_done, worker, *job[:2]))
                     idle = False
 
                 for worker in workers:
@@ -71,7 +111,7 @@ class Runner(object):
                     break
                 if len(idle_workers) < len(workers):
                     continue
-                if not scheduler.has_ready_tasks:
+                if len(jobs) == 0 and not scheduler.has_ready_tasks:
                     break
 
             while True:
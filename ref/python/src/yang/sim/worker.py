@@ -62,48 +62,80 @@ def run_worker_process(
 
     always_run_mods = set(config.get("always_run_modules", []))
 
-    def run_mod(mod_name: str) -> None:
-        use_rerun_manager = env.rerun_manager is not None and not run_options["post"]
+    use_rerun_manager = env.rerun_manager is not None and not run_options["post"]
+
+    def get_stages_to_run(mod_config: dict) -> list[RunStage]:
+        stages_to_run = []
+        for s in mod_config.get("stages", ["intraday"]):
+            stage_val = RunStage.parse(s)
+            if stage_val in run_options["stages"]:
+                stages_to_run.append(stage_val)
+        return stages_to_run
+
+    def prepare_mod(mod_name: str) -> bool:
+        """Whether the module has to run, recorded as running if so"""
+        mod_config = mod_configs[mod_name]
+        # check sys/user mod
+        if env.user_mode and mod_config.get("sys", False):
+            return False
+        if len(get_stages_to_run(mod_config)) == 0:
+            return False
+
+        if use_rerun_manager:
+            if mod_name not in always_run_mods and env.rerun_manager.can_skip_run(
+                mod_name, mod_deps[mod_name]
+            ):
+                logging.debug(f"Skip module {mod_name}: already built")
+                return False
+            env.rerun_manager.record_before_run(mod_name)
+        return True
+
+    def commit_mod(mod_name: str) -> None:
+        if use_rerun_manager:
+            env.rerun_manager.record_run(mod_name)
+
+    def execute_mod(mod_name: str, shard: int = 0, num_shards: int = 1) -> None:
+        mod_config = mod_configs[mod_name]
+        logging.debug(f"Making module {mod_name} on {worker_name}")
+        mod_cls = import_attr(mod_config["class"])
+        mod = mod_cls(mod_name, mod_config, env)
+
+        start_di, end_di = env.start_di, env.end_di
+        if num_shards > 1:
+            # contiguous date shards, the module writes rows of its own shard only
+            env.start_di = start_di + (end_di - start_di) * shard // num_shards
+            env.end_di = start_di + (end_di - start_di) * (shard + 1) // num_shards
         try:
-            mod_config = mod_configs[mod_name]
-            # check sys/user mod
-            if env.user_mode and mod_config.get("sys", False):
-                return
-
-            stages = mod_config.get("stages", ["intraday"])
-            stages_to_run = []
-            for s in stages:
-                stage_val = RunStage.parse(s)
-                if stage_val in run_options["stages"]:
-                    stages_to_run.append(stage_val)
-            if len(stages_to_run) == 0:
-                return
-
-            if use_rerun_manager:
-                if mod_name not in always_run_mods and env.rerun_manager.can_skip_run(
-                    mod_name, mod_deps[mod_name]
-                ):
-                    logging.debug(f"Skip module {mod_name}: already built")
-                    return
-
-            logging.debug(f"Running module {mod_name} on {worker_name}")
-            logging.debug(f"Making module {mod_name} on {worker_name}")
-            mod_cls = import_attr(mod_config["class"])
-            mod = mod_cls(mod_name, mod_config, env)
-            if use_rerun_manager:
-                env.rerun_manager.record_before_run(mod_name)
-
-            for stage in stages_to_run:
-                logging.info(f"Running module {mod_name} - {stage} on {worker_name}")
+            for stage in get_stages_to_run(mod_config):
+                logging.info(
+                    f"Running module {mod_name} - {stage} ({env.start_di} - {env.end_di}) "
+                    f"on {worker_name}"
+                )
                 mod.stage = stage
                 with np.errstate(divide="ignore", invalid="ignore"):
                     mod.run()
-            logging.info(f"Finished module {mod_name} on {worker_name}")
+        finally:
+            env.start_di, env.end_di = start_di, end_di
 
-            if use_rerun_manager:
-                env.rerun_manager.record_run(mod_name)
+    def run_task(kind: str, mod_name: str, *args) -> Any:
+        try:
+            if kind == "run":
+                logging.debug(f"Running module {mod_name} on {worker_name}")
+                if prepare_mod(mod_name):
+                    execute_mod(mod_name)
+                    logging.info(f"Finished module {mod_name} on {worker_name}")
+                    commit_mod(mod_name)
+            elif kind == "prepare":
+                return prepare_mod(mod_name)
+            elif kind == "shard":
+                execute_mod(mod_name, *args)
+                logging.info(f"Finished module {mod_name} shard {args[0]} on {worker_name}")
+            elif kind == "commit":
+                commit_mod(mod_name)
+            else:
+                raise WorkerError(f"Unknown task: {kind}")
         except Exception:
-            logging.exception(f"Failed to run {mod_name} on {worker_name}")
+            logging.exception(f"Failed to {kind} {mod_name} on {worker_name}")
             raise
 
     logging.debug(f"Worker process {worker_name} started")
@@ -117,10 +149,10 @@ def run_worker_process(
             last_poll_tm = datetime.now().timestamp()
             if conn.poll():
                 msg = conn.recv()
-                if msg[0] == "run":
+                if msg[0] in ("run", "prepare", "shard", "commit"):
                     assert fut is None
                     mod_name = msg[1]
-                    fut = executor.submit(run_mod, mod_name)
+                    fut = executor.submit(run_task, *msg)
                 elif msg[0] == "stop":
                     break
                 elif msg[0] == "hb":
@@ -132,8 +164,8 @@ def run_worker_process(
             if fut is not None:
                 done = True
                 try:
-                    fut.result(timeout=TASK_POLL_SECS)
-                    conn.send(("done", mod_name))
+                    result = fut.result(timeout=TASK_POLL_SECS)
+                    conn.send(("done", mod_name, result))
                 except TimeoutError:
                     done = False
                 except Exception as e:
@@ -194,7 +226,7 @@ class SubprocessWorker(object):
                 msg = self.conn.recv()
                 if msg[0] == "done":
                     if self.run_fut:
-                        self.run_fut.set_result(self.active_mod)
+                        self.run_fut.set_result(msg[2])
                 elif msg[0] == "error":
                     if self.run_fut:
                         self.run_fut.set_exception(WorkerError(msg[2]))
@@ -211,9 +243,15 @@ class SubprocessWorker(object):
         return False
 
     def run_module(self, mod: str) -> asyncio.Future:
+        return self.run_task("run", mod)
+
+    def run_task(self, kind: str, mod: str, *args) -> asyncio.Future:
+        """Run a task on the module in the worker process: "run" a module entirely, or
+        "prepare", run a "shard" (shard, num_shards) and "commit" a sharded module.
+        The future holds the return value of the task."""
         assert self.run_fut is None
         assert not self.error
-        self.conn.send(("run", mod))
+        self.conn.send((kind, mod, *args))
         self.active_mod = mod
         self.run_fut = self.loop.create_future()
         self.run_fut.add_done_callback(self._on_run_done)
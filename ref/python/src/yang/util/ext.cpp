@@ -1,7 +1,9 @@
 #include <pybind11/pybind11.h>
 
+#include "yang/data/compressed_array.h"
 #include "yang/util/config.h"
 #include "yang/util/logging.h"
+#include "yang/util/task_pool.h"
 
 namespace py = pybind11;
 
@@ -16,4 +18,27 @@ PYBIND11_MODULE(ext, m) {
 
   m.def("configure_cpp_logging", &yang::ConfigureLogging, py::arg("pattern"),
         py::arg("level") = "info", py::arg("log_stderr") = false, py::arg("log_file") = "");
+
+  m.def(
+      "compress_array",
+      [](const std::string &path, int block_rows, int num_threads) {
+        py::gil_scoped_release release;
+        yang::TaskPool pool(num_threads);
+        yang::ArrayBase::Compress(path, block_rows, &pool);
+      },
+      py::arg("path"), py::arg("block_rows") = 64, py::arg("num_threads") = 8);
+
+  m.def(
+      "read_compressed_array",
+      [](const std::string &path, py::buffer out, int num_threads) {
+        auto info = out.request(true);
+        yang::CompressedArrayReader reader(path);
+        ENSURE(info.size * info.itemsize == reader.rows() * reader.row_bytes(),
+               "Buffer of {} bytes for {} ({} bytes)", info.size * info.itemsize, path,
+               reader.rows() * reader.row_bytes());
+        py::gil_scoped_release release;
+        yang::TaskPool pool(num_threads);
+        reader.ReadAll(info.ptr, &pool);
+      },
+      py::arg("path"), py::arg("out"), py::arg("num_threads") = 8);
 }
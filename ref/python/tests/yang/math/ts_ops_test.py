@@ -0,0 +1,141 @@
+import datetime
+import os
+
+import numpy as np
+import pytest
+import yaml
+
+# the ts operations are built into the operations lib of the deployment
+OPERATIONS_LIB = os.environ.get("YANG_OPERATIONS_LIB")
+pytestmark = pytest.mark.skipif(not OPERATIONS_LIB, reason="YANG_OPERATIONS_LIB is not set")
+
+NUM_DATES = 400
+NUM_INSTS = 12
+FILL_HORIZON = 60  # of the linear fill in ts.cpp
+
+
+def make_signal(seed: int = 3) -> np.array:
+    """Values around 100 with zeros and NaN gaps both shorter and longer than the fill horizon"""
+    rng = np.random.default_rng(seed)
+    sig = (100 + (rng.random((NUM_DATES, NUM_INSTS)) - 0.5) * 20).astype("float32")
+    sig[rng.random(sig.shape) < 0.05] = 0
+    for ii in range(NUM_INSTS):
+        di = 0
+        while di < NUM_DATES:
+            if rng.random() < 0.1:
+                gap = int(rng.integers(1, 100))
+                sig[di:di + gap, ii] = np.nan
+                di += gap
+            di += 1
+    return sig
+
+
+def linear_fill(col: np.array, horizon: int) -> np.array:
+    out = col.copy()
+    valid = np.isfinite(col)
+    n = len(col)
+    i = 0
+    while i < n and not valid[i]:
+        i += 1
+    while i < n:
+        if valid[i]:
+            i += 1
+            continue
+        j = i + 1
+        while j < n and not valid[j]:
+            j += 1
+        if j < n and j - i <= horizon:
+            step = (col[j] - col[i - 1]) / (j - i + 1)
+            for k in range(i, j):
+                out[k] = out[i - 1] + step * (k - i + 1)
+        i = j
+    return out
+
+
+def ts_range_reference(sig: np.array, ts_len: int, func) -> np.array:
+    """func over the filled window from its first valid value to the day, for each valid value"""
+    out = sig.copy()
+    for ii in range(sig.shape[1]):
+        col = linear_fill(sig[:, ii], FILL_HORIZON)
+        for di in range(sig.shape[0]):
+            if not np.isfinite(sig[di, ii]):
+                continue
+            start = max(0, di - ts_len + 1)
+            while not np.isfinite(col[start]):
+                start += 1
+            out[di, ii] = func(col[start:di + 1].astype("float64"))
+    return out
+
+
+def demean2(r: np.array) -> float:
+    rest = r[:-1][np.isfinite(r[:-1])]
+    return r[-1] - rest.mean() if len(rest) > 0 else np.nan
+
+
+REDUCTIONS = {
+    "tsmin": (np.nanmin, 1e-6),
+    "tsmax": (np.nanmax, 1e-6),
+    "tssum": (np.nansum, 1e-5),
+    "tscount": (lambda r: np.count_nonzero(r != 0), 0),
+    "tsprod": (np.nanprod, 1e-5),
+    "tsmean": (np.nanmean, 1e-5),
+    "tsdemean": (lambda r: r[-1] - np.nanmean(r), 2e-3),
+    "tsdemean2": (demean2, 2e-3),
+    "tsstd": (np.nanstd, 2e-3),
+}
+
+
+@pytest.fixture(scope="module")
+def env(tmp_path_factory):
+    import yang.sim.ext
+    from yang.util.ext import Config
+
+    root = tmp_path_factory.mktemp("env")
+    dates = []
+    day = datetime.date(2020, 1, 1)
+    while len(dates) < NUM_DATES:
+        if day.weekday() < 5:
+            dates.append(int(day.strftime("%Y%m%d")))
+        day += datetime.timedelta(days=1)
+    (root / "trade_dates.csv").write_text("".join(f"{d}\n" for d in dates))
+    (root / "sec_master.csv").write_text(
+        "sid|list|delist\n" + "".join(f"S{ii:02d}|{dates[0]}|\n" for ii in range(NUM_INSTS))
+    )
+    (root / "cache").mkdir()
+    config = {
+        "cache": str(root / "cache"),
+        "daily": True,
+        "univ_start_date": dates[0],
+        "univ_end_date": dates[-1],
+        "trade_dates": str(root / "trade_dates.csv"),
+        "sec_master": str(root / "sec_master.csv"),
+        "max_univ_size": 64,
+    }
+    env = yang.sim.ext.Env()
+    env.initialize(Config.load(yaml.dump(config)))
+    env.build()
+    return env
+
+
+@pytest.fixture(scope="module")
+def manager(env):
+    import yang.sim.ext
+
+    yang.sim.ext.load_shared_lib(OPERATIONS_LIB)
+    manager = yang.sim.ext.OperationManager()
+    manager.initialize(env)
+    return manager
+
+
+@pytest.mark.parametrize("name", REDUCTIONS.keys())
+@pytest.mark.parametrize("ts_len", [1, 2, 5, 60, 250, 1000])
+def test_ts_rolling(manager, name, ts_len):
+    """The rolling window accumulators match the reduction over each window"""
+    if name == "tsprod" and ts_len > 5:
+        pytest.skip("products of long windows overflow")
+    func, tol = REDUCTIONS[name]
+    sig = make_signal()
+    out = np.full_like(sig, np.nan)
+    manager.apply(sig, out, 0, NUM_DATES, [(name, [str(ts_len)], {})])
+    expected = ts_range_reference(sig, ts_len, func)
+    np.testing.assert_allclose(out, expected, rtol=tol, atol=tol, equal_nan=True)
@@ -0,0 +1,99 @@
+import numpy as np
+import pytest
+
+NUM_DAYS = 500
+NUM_SERIES = 40
+
+
+def make_series(missing: float, seed: int = 5) -> np.array:
+    """Correlated series, each around its own level, with missing days"""
+    rng = np.random.default_rng(seed)
+    xs = np.empty((NUM_SERIES, NUM_DAYS))
+    xs[0] = rng.standard_normal(NUM_DAYS)
+    for k in range(1, NUM_SERIES):
+        xs[k] = 0.5 * xs[k - 1] + rng.standard_normal(NUM_DAYS)
+    xs += rng.uniform(-100, 100, (NUM_SERIES, 1))
+    xs[rng.random(xs.shape) < missing] = np.nan
+    return xs
+
+
+def pairwise_corr(x: np.array, y: np.array, min_count: int = 2) -> float:
+    valid = np.isfinite(x) & np.isfinite(y)
+    if np.count_nonzero(valid) < min_count:
+        return np.nan
+    return np.corrcoef(x[valid], y[valid])[0, 1]
+
+
+def reference_matrix(xs: list[np.array]) -> np.array:
+    return np.array([[pairwise_corr(x, y) for y in xs] for x in xs])
+
+
+@pytest.mark.parametrize("missing", [0, 0.1])
+def test_corr(missing):
+    """Each series against the pool of the ones before it"""
+    from yang.sim.ext import CorrPool
+
+    xs = make_series(missing)
+    pool = CorrPool(NUM_DAYS)
+    for k, x in enumerate(xs):
+        expected = [pairwise_corr(x, y) for y in xs[:k]]
+        np.testing.assert_allclose(pool.corr(x), expected, rtol=1e-9, atol=1e-9)
+        assert pool.add(x) == k
+    assert pool.count == NUM_SERIES
+
+
+@pytest.mark.parametrize("missing", [0, 0.1])
+@pytest.mark.parametrize("num_threads", [1, 4])
+def test_matrix(missing, num_threads):
+    from yang.sim.ext import CorrPool
+
+    xs = make_series(missing)
+    pool = CorrPool(NUM_DAYS)
+    for x in xs:
+        pool.add(x)
+    expected = reference_matrix(xs)
+    np.testing.assert_allclose(pool.matrix(num_threads), expected, rtol=1e-9, atol=1e-9)
+
+
+def test_min_count():
+    """Pairs with too few common valid days are NaN"""
+    from yang.sim.ext import CorrPool
+
+    x = np.arange(10, dtype="float64")
+    y = x**2
+    y[3:] = np.nan
+    pool = CorrPool(10, min_count=4)
+    pool.add(x)
+    assert np.isnan(pool.corr(y)[0])
+    y[3] = 9
+    assert pool.corr(y)[0] == pytest.approx(pairwise_corr(x, y))
+
+
+@pytest.mark.parametrize("num_threads", [1, 4])
+def test_signal_corr(num_threads):
+    """Signals correlate as vectors of positions over all days and instruments"""
+    import yang.sim.ext
+
+    rng = np.random.default_rng(7)
+    sigs = [rng.standard_normal((120, 300)).astype("float32")]
+    for _ in range(3):
+        sigs.append((0.5 * sigs[-1] + rng.standard_normal(sigs[-1].shape)).astype("float32"))
+    for sig in sigs:
+        sig[rng.random(sig.shape) < 0.1] = np.nan
+        sig[:, 200:] = np.nan  # instruments outside of the universe
+    corr = yang.sim.ext.signal_corr(sigs, num_threads)
+    expected = reference_matrix([sig.ravel().astype("float64") for sig in sigs])
+    np.testing.assert_allclose(corr, expected, rtol=1e-6, atol=1e-6)
+
+
+def test_signal_corr_threads():
+    """The days are summed in the same groups and order on any number of threads"""
+    import yang.sim.ext
+
+    rng = np.random.default_rng(11)
+    sigs = [rng.standard_normal((2000, 2000)).astype("float32") for _ in range(3)]
+    sigs[1] += sigs[0]
+    sigs[2][rng.random(sigs[2].shape) < 0.2] = np.nan
+    corr = yang.sim.ext.signal_corr(sigs, 1)
+    for num_threads in [3, 8]:
+        np.testing.assert_array_equal(yang.sim.ext.signal_corr(sigs, num_threads), corr)
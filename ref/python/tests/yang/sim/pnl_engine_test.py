@@ -0,0 +1,180 @@
+import datetime
+
+import numpy as np
+import pytest
+
+NUM_DATES = 300
+NUM_INSTS = 16
+BOOK_SIZE = 1e6
+HEDGE_II = 0
+
+
+def make_inputs(seed: int) -> tuple[np.array, np.array]:
+    """Signals with zeros and NaNs, returns with NaNs"""
+    rng = np.random.default_rng(seed)
+    sig = (rng.standard_normal((NUM_DATES, NUM_INSTS)) * 1e4).astype("float32")
+    sig[rng.random(sig.shape) < 0.1] = 0
+    sig[rng.random(sig.shape) < 0.05] = np.nan
+    ret = (rng.standard_normal((NUM_DATES, NUM_INSTS)) * 0.02).astype("float32")
+    ret[rng.random(ret.shape) < 0.02] = np.nan
+    return sig, ret
+
+
+def make_dates() -> list[int]:
+    dates = []
+    day = datetime.date(2020, 6, 1)
+    while len(dates) < NUM_DATES:
+        if day.weekday() < 5:
+            dates.append(int(day.strftime("%Y%m%d")))
+        day += datetime.timedelta(days=1)
+    return dates
+
+
+# The reference follows the base, ic, hedge and ir modules of pnl_metrics, with numpy in place of
+# numba and pandas
+
+
+def reference_daily(sig: np.array, ret: np.array) -> dict[str, np.array]:
+    x = np.where(np.isfinite(sig), sig, 0).astype("float64")
+    prev = np.zeros_like(x)
+    prev[1:] = x[:-1]
+    raw_pnl = prev * ret
+    raw_pnl[~np.isfinite(raw_pnl)] = 0
+    long_pnl = np.where(prev > 0, raw_pnl, 0).sum(axis=1)
+    short_pnl = np.where(prev < 0, raw_pnl, 0).sum(axis=1)
+    stats = {
+        "long_count": (x > 0).sum(axis=1),
+        "short_count": (x < 0).sum(axis=1),
+        "long_val": np.where(x > 0, x, 0).sum(axis=1),
+        "short_val": np.where(x < 0, x, 0).sum(axis=1),
+        "trade_val": np.abs(x - prev).sum(axis=1),
+        "long_pnl": long_pnl,
+        "short_pnl": short_pnl,
+        "pnl": long_pnl + short_pnl,
+        "long_ret": long_pnl / BOOK_SIZE,
+        "short_ret": short_pnl / BOOK_SIZE,
+        "ret": (long_pnl + short_pnl) / BOOK_SIZE,
+    }
+
+    ic = np.zeros(len(sig))
+    for di in range(1, len(sig)):
+        a = sig[di - 1].astype("float64")
+        b = ret[di].astype("float64")
+        valid = np.isfinite(a) & np.isfinite(b)
+        x2 = np.sum(a[valid] ** 2)
+        y2 = np.sum(b[valid] ** 2)
+        ic[di] = np.nan if x2 == 0 or y2 == 0 else np.sum(a[valid] * b[valid]) / np.sqrt(x2 * y2)
+    stats["ic"] = ic
+
+    hedge_ret = stats["long_ret"] - ret[:, HEDGE_II]
+    hedge_ret[0] = 0
+    stats["hedge_ret"] = hedge_ret
+    return stats
+
+
+def reference_dd(ret: np.array) -> tuple[float, int, int]:
+    max_dd = 0
+    max_dd_start = 0
+    max_dd_end = 0
+    dd = 0
+    dd_start = 0
+    dd_end = 0
+    for di in range(len(ret)):
+        dd += ret[di]
+        if dd < 0:
+            if dd_end != di - 1:
+                dd_start = di
+            dd_end = di
+            if dd < max_dd:
+                max_dd = dd
+                max_dd_start = dd_start
+                max_dd_end = dd_end
+        else:
+            dd = 0
+    return -max_dd * 100, max_dd_start, max_dd_end
+
+
+def reference_summary(stats: dict[str, np.array], days_per_year: int = 250) -> dict[str, float]:
+    std = np.nanstd(stats["ret"], ddof=1)
+    max_dd, max_dd_start, max_dd_end = reference_dd(stats["ret"])
+    return {
+        "long_count": stats["long_count"].mean(),
+        "short_count": stats["short_count"].mean(),
+        "long_val": stats["long_val"].mean(),
+        "short_val": stats["short_val"].mean(),
+        "trade_val": stats["trade_val"].mean(),
+        "long_pnl": stats["long_pnl"].sum(),
+        "short_pnl": stats["short_pnl"].sum(),
+        "pnl": stats["pnl"].sum(),
+        "long_ret": stats["long_ret"].mean() * days_per_year,
+        "short_ret": stats["short_ret"].mean() * days_per_year,
+        "ret": np.nanmean(stats["ret"]) * days_per_year,
+        "hedge_ret": np.nanmean(stats["hedge_ret"]) * days_per_year,
+        "tvr": stats["trade_val"].mean() / BOOK_SIZE,
+        "ic": np.nanmean(stats["ic"]),
+        "std": std,
+        "ir": np.nanmean(stats["ret"]) / std,
+        "up_days": np.sum(stats["pnl"] > 0),
+        "down_days": np.sum(stats["pnl"] < 0),
+        "max_dd": max_dd,
+        "max_dd_start": max_dd_start,
+        "max_dd_end": max_dd_end,
+    }
+
+
+def check_daily(stats, expected: dict[str, np.array]):
+    for name, values in expected.items():
+        actual = np.asarray(getattr(stats, name))
+        np.testing.assert_allclose(
+            actual, values, rtol=1e-5, atol=1e-6, equal_nan=True, err_msg=name
+        )
+
+
+def test_daily_stats():
+    """The daily stats of the engine match pnl_metrics"""
+    import yang.sim.ext
+
+    sig, ret = make_inputs(1)
+    stats = yang.sim.ext.compute_pnl_stats(sig, ret, NUM_INSTS, BOOK_SIZE, HEDGE_II)
+    assert len(stats) == NUM_DATES
+    check_daily(stats, reference_daily(sig, ret))
+
+
+@pytest.mark.parametrize("num_threads", [1, 4])
+def test_batch(num_threads):
+    """Each signal of a batch gets the same stats as on its own"""
+    import yang.sim.ext
+
+    inputs = [make_inputs(seed) for seed in range(5)]
+    ret = inputs[0][1]
+    sigs = [sig for sig, _ in inputs]
+    batch = yang.sim.ext.compute_pnl_stats_batch(
+        sigs, ret, NUM_INSTS, BOOK_SIZE, HEDGE_II, num_threads
+    )
+    assert len(batch) == len(sigs)
+    for sig, stats in zip(sigs, batch):
+        check_daily(stats, reference_daily(sig, ret))
+
+
+def test_yearly_summary():
+    """The yearly and total summaries match the pnl_metrics summary of their days"""
+    import yang.sim.ext
+
+    sig, ret = make_inputs(2)
+    dates = make_dates()
+    stats = yang.sim.ext.compute_pnl_stats(sig, ret, NUM_INSTS, BOOK_SIZE, HEDGE_II)
+    summaries = yang.sim.ext.compute_yearly_pnl_stats(stats, dates, BOOK_SIZE)
+    years = np.array(dates) // 10000
+    ranges = [np.flatnonzero(years == year) for year in np.unique(years)]
+    ranges.append(np.arange(NUM_DATES))
+    assert len(summaries) == len(ranges)
+
+    daily = reference_daily(sig, ret)
+    for summary, days in zip(summaries, ranges):
+        assert (summary.start, summary.end) == (days[0], days[-1])
+        expected = reference_summary({name: values[days] for name, values in daily.items()})
+        for name, value in expected.items():
+            actual = getattr(summary, name)
+            if name in ("max_dd_start", "max_dd_end"):
+                actual -= days[0]
+            assert actual == pytest.approx(value, rel=1e-5, abs=1e-9, nan_ok=True), name
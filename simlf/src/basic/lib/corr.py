@@ -9,8 +9,12 @@ from tabulate import tabulate
 
 from yang.data import Array
 from yang.sim import Env
+from yang.sim.ext import CorrPool, OperationManager
 from yao.lib.pnl2 import compute_pnls
 
+# alphas whose ops are applied together, bounds the memory of the op outputs
+OPS_BATCH_SIZE = 16
+
 
 def is_pnl_update_required(alpha_path, ops, registry_entry):
     if registry_entry["ops"] != ops:
@@ -21,6 +25,71 @@ def is_pnl_update_required(alpha_path, ops, registry_entry):
     return False
 
 
+def parse_ops(raw_ops):
+    ops = []
+    if isinstance(raw_ops, str):
+        for op_desc in raw_ops.split("|"):
+            args = op_desc.split(":")
+            ops.append((args[0], args[1:], {}))
+    else:
+        for op_desc in raw_ops:
+            ops.append((op_desc["name"], op_desc.get("args", []), op_desc.get("kwargs", {})))
+    return ops
+
+
+def compute_metrics(env, alphas, ops, start_di, end_di, metric):
+    """
+    Yields the name and daily metric of each alpha in alphas, a list of (name, path) sharing ops.
+    The ops are applied by the yang OperationManager in batches of OPS_BATCH_SIZE alphas, so only
+    one batch of outputs is held at a time.
+    """
+    op_manager = None
+    if ops:
+        op_manager = OperationManager()
+        op_manager.initialize(env.cpp_env)
+        ops = parse_ops(ops)
+    for k in range(0, len(alphas), OPS_BATCH_SIZE):
+        batch = alphas[k : k + OPS_BATCH_SIZE]
+        sigs = [Array.mmap(path).data for _, path in batch]
+        if op_manager is not None:
+            sigs_op = [np.empty_like(sig) for sig in sigs]
+            for sig_op in sigs_op:
+                sig_op.fill(np.nan)
+            op_manager.apply_batch(sigs, sigs_op, start_di, end_di, ops)
+            sigs = sigs_op
+        for (name, _), sig in zip(batch, sigs):
+            daily_pnls = compute_pnls(
+                env, Array(sig), start_di=start_di, end_di=end_di, aggregate=False
+            )
+            yield name, daily_pnls[metric].to_numpy().astype(np.float32)
+
+
+def log_pool_corr(corr_dir, registry, updated):
+    """
+    Logs the highest correlation of each updated alpha with the registered alphas before it, each
+    one is checked against the pool and then added to it.
+    """
+    size = len(next(iter(updated.values())))
+    pool = CorrPool(size)
+    names = []
+    for name in registry:
+        path = os.path.join(corr_dir, name)
+        if name in updated or not os.path.exists(path):
+            continue
+        values = Array.mmap(path).data
+        if len(values) == size:
+            pool.add(np.ascontiguousarray(values, dtype=np.float64))
+            names.append(name)
+    for name, values in updated.items():
+        values = np.ascontiguousarray(values, dtype=np.float64)
+        corrs = np.array(pool.corr(values))
+        if np.isfinite(corrs).any():
+            k = np.nanargmax(corrs)
+            logging.info(f"{name}: max corr {corrs[k]:.4f} with {names[k]}")
+        pool.add(values)
+        names.append(name)
+
+
 def register_corr(cache_dir, corr_config):
     env = Env({"cache": cache_dir})
     corr_dir = env.cache_dir.get_path("_" + corr_config.get("corr_dir", "corr"))
@@ -43,6 +112,8 @@ def register_corr(cache_dir, corr_config):
         end_di = env.dates.upper_bound(end_date)
     else:
         end_di = len(env.dates)
+    # alphas to update, grouped by ops so that each group applies its ops in one batch
+    updates = {}
     for name, alpha_config in corr_config.get("alphas", {}).items():
         alpha = env.cache_dir.get_path(alpha_config["alpha"])
         if not os.path.exists(alpha):
@@ -51,16 +122,7 @@ def register_corr(cache_dir, corr_config):
         ops = alpha_config.get("ops", "")
         tags = alpha_config.get("tags", [])
         if name not in registry or is_pnl_update_required(alpha, ops, registry[name]):
-            daily_pnls = compute_pnls(
-                env,
-                Array.mmap(alpha),
-                ops=ops,
-                start_di=start_di,
-                end_di=end_di,
-                aggregate=False,
-            )
-            metric_values = daily_pnls[metric].to_numpy().astype(np.float32)
-            Array(metric_values).save(os.path.join(corr_dir, name))
+            updates.setdefault(str(ops), (ops, []))[1].append((name, alpha))
         registry[name] = {
             "alpha": alpha,
             "ops": ops,
@@ -68,6 +130,14 @@ def register_corr(cache_dir, corr_config):
             "timestamp": int(time.time()),
         }
 
+    updated = {}
+    for ops, alphas in updates.values():
+        for name, metric_values in compute_metrics(env, alphas, ops, start_di, end_di, metric):
+            Array(metric_values).save(os.path.join(corr_dir, name))
+            updated[name] = metric_values
+    if updated:
+        log_pool_corr(corr_dir, registry, updated)
+
     with open(registry_path, "w") as f:
         yaml.dump(registry, f, Dumper=yaml.CDumper)
 
@@ -103,7 +173,9 @@ def corr(cache_dir, alpha, tags, start_date=None, end_date=None, corr_dir="corr"
         )
         x_metric = daily_pnls["ic"].to_numpy().astype(np.float32)[start_di:end_di]
 
-    corrs = []
+    # the matching alphas are added to a pool and x is correlated against all of them at once
+    pool = CorrPool(len(x_metric))
+    labels = []
     missing_alphas = []
     for alpha_name, alpha_config in registry.items():
         if alpha_name == alpha:
@@ -113,15 +185,12 @@ def corr(cache_dir, alpha, tags, start_date=None, end_date=None, corr_dir="corr"
             alpha_path = os.path.join(corr_path, alpha_name)
             if os.path.exists(alpha_path):
                 y_metric = Array.mmap(alpha_path).data[start_di:end_di]
-                corrs.append(
-                    (
-                        np.corrcoef(x_metric, y_metric)[0, 1],
-                        alpha_name + " - " + " - ".join(alpha_tags),
-                    )
-                )
+                pool.add(np.ascontiguousarray(y_metric, dtype=np.float64))
+                labels.append(alpha_name + " - " + " - ".join(alpha_tags))
             else:
                 missing_alphas.append(alpha_name)
-    corrs = list(reversed(sorted(corrs)))
+    x_metric = np.ascontiguousarray(x_metric, dtype=np.float64)
+    corrs = list(reversed(sorted(zip(pool.corr(x_metric), labels))))
     names = [c[1] for c in corrs]
     values = [c[0] for c in corrs]
     table = pd.DataFrame(data={"alpha": names, "corr": values})[:display_num]
@@ -11,8 +11,8 @@ import yaml
 from data import Array, BlockMat, RefStructArray
 from sim import Env#, ExprRunner
 
-# from basic.lib.pnl import OperationManager
 from basic.lib.pycommon.data import format_date
+from basic.operation_manager import OperationManager
 
 
 def mat_diff(a, b):
@@ -339,17 +339,19 @@ class Sim:
         return sig
 
     def apply_ops(self, sig, ops, start_di=-1, end_di=-1):
+        return self.apply_ops_batch([sig], ops, start_di, end_di)[0]
+
+    def apply_ops_batch(self, sigs, ops, start_di=-1, end_di=-1):
         if not hasattr(self.env, "op_manager"):
             self.env.op_manager = OperationManager(self.env)
 
-        sig_op = np.empty_like(sig)
-        sig_op.fill(np.nan)
+        sigs_op = [np.full_like(sig, np.nan) for sig in sigs]
         if start_di == -1:
             start_di = self.env.start_di
         if end_di == -1:
             end_di = self.env.end_di
-        self.env.op_manager.apply(sig, sig_op, start_di, end_di, ops)
-        return sig_op
+        self.env.op_manager.apply_batch(sigs, sigs_op, start_di, end_di, ops)
+        return sigs_op
 
     def apply_ops_inplace(self, sig, sig_op, ops, start_di=-1, end_di=-1):
         if not hasattr(self.env, "op_manager"):
@@ -69,3 +69,16 @@ class OperationManager:
             else:
                 logging.warning(f"Operation {ops_} not supported.")
 
+    def apply_batch(
+        self,
+        sigs_in: list[Array | np.array] | np.array,
+        sigs_out: list[Array | np.array] | np.array,
+        start_di: int,
+        end_di: int,
+        ops: str | list[dict],
+    ) -> None:
+        """
+        Applies the same ops to each signal, given as lists or 3-D arrays of (dates, univ) signals.
+        """
+        for sig_in, sig_out in zip(sigs_in, sigs_out):
+            self.apply(sig_in, sig_out, start_di, end_di, ops)
@@ -92,59 +92,62 @@ class SupCut : public BaseDaily {
 
     LOG_INFO("second stage, cut: {}/{}", tm_cut_, ti_cut_);
 
-    for (int di = start_di; di < end_di; di++) {
-      LOG_INFO("[{}] Update information on date {}. (finished {}/{})", name(), dates()[di], di,
-               date_sz - 1);
-      for (int ii = 0; ii < max_univ_sz; ii++) {
-        float vol_d = 0, dvol_d = 0, vwap_d = NAN;
-        for (int ti = 0; ti <= ti_cut_; ti++) {
-          float cumvol = i_trd_cumvol(di, ti, ii);
-          float cumvwap = i_trd_cumvwap(di, ti, ii);
-          float cumdvol = i_trd_cumdvol(di, ti, ii);
-
-          if (my_valid(cumvol)) {
-            vol_d = cumvol;
-          }
-          if (my_valid(cumdvol)) {
-            dvol_d = cumdvol;
-          }
-          if (my_valid(cumvwap)) {
-            vwap_d = cumvwap;
+    // dates are independent in this stage
+    parallel_for(start_di, end_di, 1, [&](int64_t chunk_begin, int64_t chunk_end) {
+      for (int di = chunk_begin; di < chunk_end; di++) {
+        LOG_DEBUG("[{}] Update information on date {}", name(), dates()[di]);
+        for (int ii = 0; ii < max_univ_sz; ii++) {
+          float vol_d = 0, dvol_d = 0, vwap_d = NAN;
+          for (int ti = 0; ti <= ti_cut_; ti++) {
+            float cumvol = i_trd_cumvol(di, ti, ii);
+            float cumvwap = i_trd_cumvwap(di, ti, ii);
+            float cumdvol = i_trd_cumdvol(di, ti, ii);
+
+            if (my_valid(cumvol)) {
+              vol_d = cumvol;
+            }
+            if (my_valid(cumdvol)) {
+              dvol_d = cumdvol;
+            }
+            if (my_valid(cumvwap)) {
+              vwap_d = cumvwap;
+            }
           }
+          cumdvol_(di, ii) = dvol_d;
+          cumvol_(di, ii) = vol_d;
+          cumvwap_(di, ii) = vwap_d;
         }
-        cumdvol_(di, ii) = dvol_d;
-        cumvol_(di, ii) = vol_d;
-        cumvwap_(di, ii) = vwap_d;
-      }
 
-      for (int ii = 0; ii < max_univ_sz; ii++) {
-        float high_d = NAN, low_d = NAN, last_d = NAN;
-        for (int ti = 0; ti <= ti_cut_; ti++) {
-          float high = i_trd_high(di, ti, ii);
-          float low = i_trd_low(di, ti, ii);
-          float last = i_trd_last(di, ti, ii);
-
-          if (!my_valid(high_d) && my_valid(high)) {
-            high_d = high;
-          }
-          if (!my_valid(low_d) && my_valid(low)) {
-            low_d = low;
-          }
-          if (high_d < high) {
-            high_d = high;
-          }
-          if (low < low_d) {
-            low_d = low;
-          }
-          if (my_valid(last)) {
-            last_d = last;
+        for (int ii = 0; ii < max_univ_sz; ii++) {
+          float high_d = NAN, low_d = NAN, last_d = NAN;
+          for (int ti = 0; ti <= ti_cut_; ti++) {
+            float high = i_trd_high(di, ti, ii);
+            float low = i_trd_low(di, ti, ii);
+            float last = i_trd_last(di, ti, ii);
+
+            if (!my_valid(high_d) && my_valid(high)) {
+              high_d = high;
+            }
+            if (!my_valid(low_d) && my_valid(low)) {
+              low_d = low;
+            }
+            if (high_d < high) {
+              high_d = high;
+            }
+            if (low < low_d) {
+              low_d = low;
+            }
+            if (my_valid(last)) {
+              last_d = last;
+            }
           }
+          high_(di, ii) = high_d;
+          low_(di, ii) = low_d;
+          close_(di, ii) = last_d;
         }
-        high_(di, ii) = high_d;
-        low_(di, ii) = low_d;
-        close_(di, ii) = last_d;
       }
-    }
+    });
+    LOG_INFO("[{}] Updated information on {} dates", name(), end_di - start_di);
   }
 };
 